@@ -12,7 +12,14 @@
 #include <cli/text_io_handler.hpp>
 #include <script/functions/functions.hpp>
 #include <script/profiler.hpp>
+#include <script/register_vm.hpp>
+#include <script/optimizer.hpp>
 #include <data/format/formats.hpp>
+#include <data/format/render_cache.hpp>
+#include <gfx/generated_image_cache.hpp>
+#include <gfx/decoded_image_cache.hpp>
+#include <gfx/font_metrics.hpp>
+#include <render/text/viewer.hpp>
 #include <wx/process.h>
 #include <wx/wfstream.h>
 
@@ -133,9 +140,13 @@ void CLISetInterface::showUsage() {
   cli << _("   :load <setfile>     Load a different set file.\n");
   cli << _("   :quit               Exit the MSE command line interface.\n");
   cli << _("   :reset              Clear all local variable definitions.\n");
+  cli << _("   :info               Show information on the set, and on the cache of rendered cards.\n");
   cli << _("   :pwd                Print the current working directory.\n");
   cli << _("   :cd                 Change the working directory.\n");
   cli << _("   :! <command>        Perform a shell command.\n");
+  cli << _("   :engine [<name>]    Show or change the script engine (stack or register).\n");
+  cli << _("   :dump <expression>  Show the instructions of an expression, before and after optimization.\n");
+  cli << _("   :optimizer [on|off] Show statistics of the script optimizer, or turn it on or off.\n");
   cli << _("\n Commands can be abreviated to their first letter if there is no ambiguity.\n\n");
 }
 
@@ -175,6 +186,22 @@ void CLISetInterface::handleCommand(const String& command) {
         } else {
           cli << _("No set loaded") << ENDL;
         }
+        cli << String::Format(_("render cache: %d hits, %d misses, %d evictions, %.1f MB"),
+                 (int)render_cache.hits, (int)render_cache.misses, (int)render_cache.evictions,
+                 render_cache.size() / (1024.0 * 1024.0)) << ENDL;
+        cli << String::Format(_("image cache:  %d images, %d hits, %d misses, %d evictions, %.1f MB"),
+                 (int)generated_image_cache.count(), (int)generated_image_cache.hits, (int)generated_image_cache.misses,
+                 (int)generated_image_cache.evictions, generated_image_cache.size() / (1024.0 * 1024.0)) << ENDL;
+        DecodedImageCacheInfo images = decoded_image_cache.info();
+        cli << String::Format(_("file images:  %d images, %d hits, %d misses, %d evictions, %.1f MB"),
+                 (int)images.count, (int)images.hits, (int)images.misses,
+                 (int)images.evictions, images.size / (1024.0 * 1024.0)) << ENDL;
+        FontMetricsCacheInfo fonts = font_metrics_cache.info();
+        cli << String::Format(_("font metrics: %d fonts, %d hits, %d misses"),
+                 (int)fonts.count, (int)fonts.hits, (int)fonts.misses) << ENDL;
+        TextLayoutCacheInfo layouts = text_layout_cache_info();
+        cli << String::Format(_("text layouts: %d layouts, %d hits, %d misses"),
+                 (int)layouts.count, (int)layouts.hits, (int)layouts.misses) << ENDL;
       } else if (before == _(":c") || before == _(":cd")) {
         if (arg.empty()) {
           cli.show_message(MESSAGE_ERROR,_("Give a new working directory."));
@@ -185,6 +212,54 @@ void CLISetInterface::handleCommand(const String& command) {
             setExportInfoCwd();
           }
         }
+      } else if (before == _(":e") || before == _(":engine")) {
+        if (!arg.empty() && !parse_script_engine(arg, script_engine)) {
+          cli.show_message(MESSAGE_ERROR,_("Unknown script engine, use 'stack' or 'register'."));
+        } else {
+          cli << _("script engine: ") << script_engine_name(script_engine) << ENDL;
+        }
+      } else if (before == _(":d") || before == _(":dump")) {
+        if (arg.empty()) {
+          cli.show_message(MESSAGE_ERROR,_("Give an expression to dump."));
+        } else {
+          vector<ScriptParseError> errors;
+          ScriptP script;
+          {
+            // parse without optimizing, the optimizer is turned back on even if parsing throws
+            struct RestoreOptimizer {
+              bool optimize;
+              ~RestoreOptimizer() { optimize_scripts = optimize; }
+            } restore = {optimize_scripts.exchange(false)};
+            script = parse(arg,nullptr,false,errors);
+          }
+          if (!errors.empty()) {
+            FOR_EACH(error,errors) cli.show_message(MESSAGE_ERROR,error.what());
+            return;
+          }
+          size_t before_size = script->getInstructions().size();
+          cli << GRAY << String::Format(_("before optimization (%d instructions):"), (int)before_size) << NORMAL << ENDL;
+          cli << script->dumpScript();
+          optimize_script(*script);
+          cli << GRAY << String::Format(_("after optimization (%d instructions):"), (int)script->getInstructions().size()) << NORMAL << ENDL;
+          cli << script->dumpScript();
+        }
+      } else if (before == _(":o") || before == _(":optimizer")) {
+        if (arg == _("on")) {
+          optimize_scripts = true;
+        } else if (arg == _("off")) {
+          optimize_scripts = false;
+        } else if (!arg.empty()) {
+          cli.show_message(MESSAGE_ERROR,_("Use 'on' or 'off'."));
+          return;
+        }
+        size_t instr_before = script_optimizer_stats.instructions_before;
+        size_t instr_after  = script_optimizer_stats.instructions_after;
+        cli << _("optimizer:    ") << (optimize_scripts ? _("on") : _("off")) << ENDL;
+        cli << String::Format(_("scripts:      %d"), (int)script_optimizer_stats.scripts) << ENDL;
+        cli << String::Format(_("instructions: %d -> %d"), (int)instr_before, (int)instr_after) << ENDL;
+        if (instr_before > 0) {
+          cli << String::Format(_("removed:      %.1f%%"), 100.0 * (instr_before - instr_after) / instr_before) << ENDL;
+        }
       } else if (before == _(":pwd") || before == _(":p")) {
         cli << ei.directory_absolute << ENDL;
       } else if (before == _(":!")) {
@@ -243,11 +318,15 @@ void CLISetInterface::handleCommand(const String& command) {
   void CLISetInterface::showProfilingStats(const FunctionProfile& item, int level) {
     // show parent
     if (level == 0) {
-      cli << GRAY << _("Time(s)   Avg (ms)  Calls   Function") << ENDL;
-      cli <<         _("========  ========  ======  ===============================") << NORMAL << ENDL;
+      cli << GRAY << _("Time(s)   Avg (ms)  Calls   Memo    Function") << ENDL;
+      cli <<         _("========  ========  ======  ======  ===============================") << NORMAL << ENDL;
     } else {
       for (int i = 1 ; i < level ; ++i) cli << _("  ");
-      cli << String::Format(_("%8.5f  %8.5f  %6d  %s"), item.total_time(), 1000 * item.avg_time(), item.calls, item.name.c_str()) << ENDL;
+      // hit rate of memoized calls, only for pure functions
+      String memo = item.memo_hits + item.memo_misses > 0
+                  ? String::Format(_("%5.1f%%"), 100 * item.memo_hit_rate())
+                  : String(_("      "));
+      cli << String::Format(_("%8.5f  %8.5f  %6d  %s  %s"), item.total_time(), 1000 * item.avg_time(), item.calls, memo.c_str(), item.name.c_str()) << ENDL;
     }
     // show children
     vector<FunctionProfileP> children;
@@ -14,6 +14,9 @@
 #include <util/error.hpp>
 #include <util/reflect.hpp>
 #include <util/delayed_index_maps.hpp>
+#include <wx/mstream.h>
+
+IMPLEMENT_DYNAMIC_ARG(LazyCards*, lazy_cards_for_reading, nullptr);
 
 // ----------------------------------------------------------------------------- : Card
 
@@ -26,7 +29,9 @@ Card::Card()
   if (!game_for_reading()) {
     throw InternalError(_("game_for_reading not set"));
   }
-  data.init(game_for_reading()->card_fields);
+  if (!lazy_cards_for_reading()) {
+    values.init(game_for_reading()->card_fields);
+  }
 }
 
 Card::Card(const Game& game)
@@ -34,26 +39,36 @@ Card::Card(const Game& game)
   , time_modified(wxDateTime::Now())
   , has_styling(false)
 {
-  data.init(game.card_fields);
+  values.init(game.card_fields);
 }
 
 String Card::identification() const {
+  // only uses fields that are read with the set, so unread cards don't have to be read
   // an identifying field
-  FOR_EACH_CONST(v, data) {
-    if (v->fieldP->identifying) {
+  FOR_EACH_CONST(v, values) {
+    if (v && v->fieldP->identifying) {
       return v->toString();
     }
   }
   // otherwise the first field
-  if (!data.empty()) {
-    return data.at(0)->toString();
+  if (!values.empty() && values.at(0)) {
+    return values.at(0)->toString();
+  } else if (!data().empty()) {
+    return data().at(0)->toString();
   } else {
     return wxEmptyString;
   }
 }
 
+ValueP Card::listValue(const FieldP& field) const {
+  if (unread && field->index < values.size() && values.at(field->index)) {
+    return values.at(field->index);
+  }
+  return data().at(field->index);
+}
+
 bool Card::contains(QuickFilterPart const& query) const {
-  FOR_EACH_CONST(v, data) {
+  FOR_EACH_CONST(v, data()) {
     if (query.match(v->fieldP->name, v->toString())) return true;
   }
   if (query.match(_("notes"), notes)) return true;
@@ -65,13 +80,13 @@ IndexMap<FieldP, ValueP>& Card::extraDataFor(const StyleSheet& stylesheet) {
 }
 
 void mark_dependency_member(const Card& card, const String& name, const Dependency& dep) {
-  mark_dependency_member(card.data, name, dep);
+  mark_dependency_member(card.data(), name, dep);
 }
 
-void reflect_version_check(Reader& handler, const Char* key, intrusive_ptr<Packaged> const& package);
-void reflect_version_check(Writer& handler, const Char* key, intrusive_ptr<Packaged> const& package);
-void reflect_version_check(GetMember& handler, const Char* key, intrusive_ptr<Packaged> const& package);
-void reflect_version_check(GetDefaultMember& handler, const Char* key, intrusive_ptr<Packaged> const& package);
+bool reflect_version_check(Reader& handler, const Char* key, intrusive_ptr<Packaged> const& package);
+bool reflect_version_check(Writer& handler, const Char* key, intrusive_ptr<Packaged> const& package);
+bool reflect_version_check(GetMember& handler, const Char* key, intrusive_ptr<Packaged> const& package);
+bool reflect_version_check(GetDefaultMember& handler, const Char* key, intrusive_ptr<Packaged> const& package);
 
 IMPLEMENT_REFLECTION(Card) {
   REFLECT(stylesheet);
@@ -92,5 +107,112 @@ IMPLEMENT_REFLECTION(Card) {
   REFLECT(time_created);
   REFLECT(time_modified);
   REFLECT(extra_data); // don't allow scripts to depend on style specific data
-  REFLECT_NAMELESS(data);
+  reflect_values(handler);
+}
+
+template <typename Handler>
+void Card::reflect_values(Handler& handler) {
+  REFLECT_NAMELESS(data());
+}
+
+// ----------------------------------------------------------------------------- : Lazy reading
+
+/// The values of the indexed fields of a card, see LazyCards
+struct IndexedValues {
+  const vector<FieldP>&     fields;
+  IndexMap<FieldP, ValueP>& values;
+};
+template <> void Reader::handle(IndexedValues& index) {
+  FOR_EACH_CONST(f, index.fields) {
+    if (f->index >= index.values.size() || !index.values.at(f->index)) {
+      index.values.add(f, f->newValue());
+    }
+    handle(f->name.c_str(), index.values.at(f->index));
+  }
+}
+
+template <>
+void Card::reflect_values<Reader>(Reader& handler) {
+  LazyCards* lazy = lazy_cards_for_reading();
+  if (!lazy) {
+    REFLECT_NAMELESS(values);
+    return;
+  }
+  // keep the text, and read only the indexed fields
+  unread = make_intrusive<UnreadCard>();
+  unread->lazy = lazy;
+  unread->text = lazy->header;
+  unread->text += handler.getBlockText();
+  wxMemoryInputStream stream(unread->text.data(), unread->text.size());
+  Reader reader(stream, lazy->package, lazy->filename, true);
+  IndexedValues index = {lazy->indexed, values};
+  reader.handle_greedy(index);
+}
+
+/// The lines of the text of an unread card that contain values of card fields
+/** This leaves out the header and the other properties of the card,
+ *  those are written from the card itself, since they might have been changed.
+ */
+static String value_text(const UnreadCard& card) {
+  const vector<FieldP>& fields = card.lazy->game->card_fields;
+  String text = String::FromUTF8(card.text.data(), card.text.size());
+  String out;
+  bool in_value = false;
+  size_t start = 0, size = text.size();
+  while (start < size) {
+    size_t end = text.find_first_of(_('\n'), start);
+    if (end == String::npos) end = size;
+    else end += 1;
+    Char c = text.GetChar(start);
+    if (c != _('\t') && c != _('\n') && c != _('#')) {
+      // a key of the card, is it a field?
+      size_t colon = min(end, text.find_first_of(_(':'), start));
+      String key = canonical_name_form(trim(text.substr(start, colon - start)));
+      in_value = false;
+      FOR_EACH_CONST(f, fields) {
+        if (f->name == key) {
+          in_value = true;
+          break;
+        }
+      }
+    }
+    if (in_value) out += text.substr(start, end - start);
+    start = end;
+  }
+  return out;
+}
+
+template <>
+void Card::reflect_values<Writer>(Writer& handler) {
+  if (!unread) {
+    REFLECT_NAMELESS(values);
+    return;
+  }
+  // write the values as they were read, so saving doesn't have to read all cards
+  handler.handleBlockText(value_text(*unread));
+}
+
+void Card::read() const {
+  UnreadCardP card = move(unread);
+  const LazyCards& lazy = *card->lazy;
+  // the values that were already read might be in use, keep them
+  IndexMap<FieldP, ValueP> all_values;
+  all_values.init(lazy.game->card_fields);
+  FOR_EACH(v, values) {
+    if (v) all_values.add(v->fieldP, v);
+  }
+  values.swap(all_values);
+  // read the values from the text, the rest of the card was read with the set
+  // and might have been changed since then (for instance by ChangeSetStyleAction)
+  wxMemoryInputStream stream(card->text.data(), card->text.size());
+  Reader reader(stream, lazy.package, lazy.filename, true);
+  WITH_DYNAMIC_ARG(game_for_reading, lazy.game.get());
+  WITH_DYNAMIC_ARG(stylesheet_for_reading, lazy.stylesheet.get());
+  WITH_DYNAMIC_ARG(lazy_cards_for_reading, nullptr);
+  IndexedValues index = {lazy.game->card_fields, values};
+  try {
+    reader.handle_greedy(index);
+  } catch (const ParseError& err) {
+    handle_error(FileParseError(err.what(), lazy.filename));
+  }
 }
@@ -17,7 +17,10 @@
 class Game;
 class Dependency;
 class Keyword;
+class Packaged;
 DECLARE_POINTER_TYPE(Card);
+DECLARE_POINTER_TYPE(LazyCards);
+DECLARE_POINTER_TYPE(UnreadCard);
 DECLARE_POINTER_TYPE(Field);
 DECLARE_POINTER_TYPE(Value);
 DECLARE_POINTER_TYPE(StyleSheet);
@@ -33,8 +36,22 @@ public:
   Card(const Game& game);
   
   /// The values on the fields of the card.
-  /** The indices should correspond to the card_fields in the Game */
-  IndexMap<FieldP, ValueP> data;
+  /** The indices should correspond to the card_fields in the Game.
+   *  If the card was read lazily, the values are read on the first call.
+   */
+  inline IndexMap<FieldP, ValueP>& data() {
+    if (unread) read();
+    return values;
+  }
+  inline const IndexMap<FieldP, ValueP>& data() const {
+    if (unread) read();
+    return values;
+  }
+  /// Have the values of this card been read?
+  inline bool isRead() const { return !unread; }
+  /// The value of a field for showing in the card list
+  /** Doesn't read the card if the field is one of the fields that are read with the set, see LazyCards. */
+  ValueP listValue(const FieldP& field) const;
   /// Notes for this card
   String notes;
   /// Time the card was created/last modified
@@ -66,7 +83,7 @@ public:
   
   /// Find a value in the data by name and type
   template <typename T> T& value(const String& name) {
-    for(IndexMap<FieldP, ValueP>::iterator it = data.begin() ; it != data.end() ; ++it) {
+    for(IndexMap<FieldP, ValueP>::iterator it = data().begin() ; it != data().end() ; ++it) {
       if ((*it)->fieldP->name == name) {
         T* ret = dynamic_cast<T*>(it->get());
         if (!ret) throw InternalError(_("Card field with name '")+name+_("' doesn't have the right type"));
@@ -76,7 +93,7 @@ public:
     throw InternalError(_("Expected a card field with name '")+name+_("'"));
   }
   template <typename T> const T& value(const String& name) const {
-    for(IndexMap<FieldP, ValueP>::const_iterator it = data.begin() ; it != data.end() ; ++it) {
+    for(IndexMap<FieldP, ValueP>::const_iterator it = data().begin() ; it != data().end() ; ++it) {
       if ((*it)->fieldP->name == name) {
         const T* ret = dynamic_cast<const T*>(it->get());
         if (!ret) throw InternalError(_("Card field with name '")+name+_("' doesn't have the right type"));
@@ -87,8 +104,45 @@ public:
   }
   
   DECLARE_REFLECTION();
+private:
+  /// The values, or only the values of the indexed fields if the card has not been read yet
+  mutable IndexMap<FieldP, ValueP> values;
+  /// Text of the values, if they have not been read yet
+  mutable UnreadCardP unread;
+  
+  /// Read the values from the text in unread
+  void read() const;
+  template <typename Handler>
+  void reflect_values(Handler& handler);
+};
+
+// ----------------------------------------------------------------------------- : Lazy reading
+
+/// Information for reading the cards of a set lazily, shared by all cards of the set
+/** When a set is opened lazily only the text of the values of cards is kept,
+ *  with the values of the identifying fields and the columns of the card list, so the card list can be shown.
+ *  The other values are read when a card is first used, through Card::data().
+ */
+class LazyCards : public IntrusivePtrBase<LazyCards> {
+public:
+  GameP          game;
+  StyleSheetP    stylesheet;  ///< Default stylesheet of the set
+  Packaged*      package;     ///< Package the cards are from, for included files
+  String         filename;    ///< Filename for error messages
+  string         header;      ///< Text to put before the values of a card, with the version of the file
+  vector<FieldP> indexed;     ///< Fields that are read with the set
+};
+
+/// The values of a card that have not been read yet
+class UnreadCard : public IntrusivePtrBase<UnreadCard> {
+public:
+  LazyCardsP lazy;
+  string     text; ///< utf-8 text of the values, as in the set file
 };
 
+/// The cards that are being read are read lazily, if set
+DECLARE_DYNAMIC_ARG(LazyCards*, lazy_cards_for_reading);
+
 inline String type_name(const Card&) {
   return _TYPE_("card");
 }
@@ -92,14 +92,21 @@ FileFormatP mtg_editor_file_format();
 void export_images(Window* parent, const SetP& set);
 
 /// Export the image for each card in a list of cards
+/** If jobs > 1, the images are encoded and written by that many worker threads.
+ *  When an image can't be saved the other cards are still exported, then an Error is thrown.
+ */
 void export_images(const SetP& set, const vector<CardP>& cards,
-                   const String& path, const String& filename_template, FilenameConflicts conflicts);
+                   const String& path, const String& filename_template, FilenameConflicts conflicts,
+                   int jobs = 1);
 
 /// Export the image of a single card
 void export_image(const SetP& set, const CardP& card, const String& filename);
 
 /// Generate a bitmap image of a card
-Bitmap export_bitmap(const SetP& set, const CardP& card);
+/** If store_in_cache, a newly rendered image is stored in the render_cache, if that is enabled.
+ *  Bulk exports don't store, because storing encodes the image on the main thread.
+ */
+Bitmap export_bitmap(const SetP& set, const CardP& card, bool store_in_cache = true);
 
 /// Export a set to Magic Workstation format
 void export_mws(Window* parent, const SetP& set);
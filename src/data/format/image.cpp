@@ -9,12 +9,17 @@
 #include <util/prec.hpp>
 #include <util/tagged_string.hpp>
 #include <data/format/formats.hpp>
+#include <data/format/render_cache.hpp>
 #include <data/set.hpp>
 #include <data/card.hpp>
 #include <data/stylesheet.hpp>
 #include <data/settings.hpp>
 #include <render/card/viewer.hpp>
 #include <wx/filename.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
 
 // ----------------------------------------------------------------------------- : Single card export
 
@@ -44,8 +49,15 @@ Rotation UnzoomedDataViewer::getRotation() const {
   }
 }
 
-Bitmap export_bitmap(const SetP& set, const CardP& card) {
+Bitmap export_bitmap(const SetP& set, const CardP& card, bool store_in_cache) {
   if (!set) throw Error(_("no set"));
+  // maybe the card was rendered before
+  String cache_key;
+  if (render_cache.enabled()) {
+    cache_key = render_cache.key(*set, card);
+    Bitmap cached = render_cache.find(cache_key);
+    if (cached.Ok()) return cached;
+  }
   // create viewer
   UnzoomedDataViewer viewer(!settings.stylesheetSettingsFor(set->stylesheetFor(card)).card_normal_export());
   viewer.setSet(set);
@@ -60,22 +72,114 @@ Bitmap export_bitmap(const SetP& set, const CardP& card) {
   // draw
   viewer.draw(dc);
   dc.SelectObject(wxNullBitmap);
+  if (store_in_cache && !cache_key.empty()) render_cache.store(cache_key, bitmap);
   return bitmap;
 }
 
-// ----------------------------------------------------------------------------- : Multiple card export
+// ----------------------------------------------------------------------------- : Image encoding
+
+/// Saves images to files using a pool of worker threads
+/** Rendering uses the stylesheet's shared styles and wx drawing, so it has to happen on the main thread.
+ *  Encoding the rendered images (mostly PNG compression) is independent per card, and is done here.
+ */
+class ImageEncoderPool {
+public:
+  ImageEncoderPool(int jobs);
+  ~ImageEncoderPool();
+  
+  /// Add an image to be saved, blocks while too many images are waiting
+  /** Takes over the image, it must not be shared with other Image objects */
+  void add(Image&& img, const String& filename);
+  /// Wait until all images are saved, throws the first error encountered by a worker
+  void finish();
+  
+private:
+  std::mutex mutex;
+  std::condition_variable wake_workers; ///< Signaled when there is work, or when we are finished
+  std::condition_variable wake_main;    ///< Signaled when there is room in the queue
+  std::deque<pair<Image,String>> queue; ///< Images that still have to be saved
+  size_t max_queue; ///< Bound on the queue size, to limit memory use
+  bool done = false;
+  String error;     ///< First error message from a worker
+  vector<std::thread> workers;
+  
+  void work();
+};
+
+ImageEncoderPool::ImageEncoderPool(int jobs)
+  : max_queue(2 * jobs)
+{
+  for (int i = 0 ; i < jobs ; ++i) {
+    workers.emplace_back(&ImageEncoderPool::work, this);
+  }
+}
+
+ImageEncoderPool::~ImageEncoderPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    done = true;
+    queue.clear();
+  }
+  wake_workers.notify_all();
+  for (auto& worker : workers) {
+    if (worker.joinable()) worker.join();
+  }
+}
 
+void ImageEncoderPool::add(Image&& img, const String& filename) {
+  std::unique_lock<std::mutex> lock(mutex);
+  wake_main.wait(lock, [this]{ return queue.size() < max_queue; });
+  queue.emplace_back(img, filename);
+  // wxImage reference counting is not thread safe, drop our reference before a worker can see the image
+  img.Destroy();
+  wake_workers.notify_one();
+}
+
+void ImageEncoderPool::finish() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    done = true;
+  }
+  wake_workers.notify_all();
+  for (auto& worker : workers) {
+    worker.join();
+  }
+  workers.clear();
+  if (!error.empty()) throw Error(error);
+}
+
+void ImageEncoderPool::work() {
+  while (true) {
+    pair<Image,String> item;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      wake_workers.wait(lock, [this]{ return done || !queue.empty(); });
+      if (queue.empty()) return;
+      item = std::move(queue.front());
+      queue.pop_front();
+    }
+    wake_main.notify_one();
+    if (!item.first.SaveFile(item.second)) {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (error.empty()) error = _("Unable to save image ") + item.second;
+    }
+  }
+}
+
+// ----------------------------------------------------------------------------- : Multiple card export
 
 void export_images(const SetP& set, const vector<CardP>& cards,
-                   const String& path, const String& filename_template, FilenameConflicts conflicts)
+                   const String& path, const String& filename_template, FilenameConflicts conflicts,
+                   int jobs)
 {
   wxBusyCursor busy;
   // Script
   ScriptP filename_script = parse(filename_template, nullptr, true);
   // Path
   wxFileName fn(path);
-  // Export
-  std::set<String> used; // for CONFLICT_NUMBER_OVERWRITE
+  // Determine all filenames first, so conflicts are resolved in card order, independent of jobs
+  vector<pair<CardP,String>> to_export;
+  std::set<String> used;
   FOR_EACH_CONST(card, cards) {
     // filename for this card
     Context& ctx = set->getContext(card);
@@ -85,9 +189,25 @@ void export_images(const SetP& set, const vector<CardP>& cards,
     fn.SetFullName(filename);
     // does the file exist?
     if (!resolve_filename_conflicts(fn, conflicts, used)) continue;
-    // write image
     filename = fn.GetFullPath();
     used.insert(filename);
-    export_image(set, card, filename);
+    to_export.emplace_back(card, filename);
+  }
+  // Render and write images, cached images are used, but the newly rendered ones are not stored,
+  // that would encode every card a second time on the main thread
+  if (jobs <= 1) {
+    // like the encoder pool: keep going when a file can't be written, and report the first failure at the end
+    String error;
+    FOR_EACH(e, to_export) {
+      Image img = export_bitmap(set, e.first, false).ConvertToImage();
+      if (!img.SaveFile(e.second) && error.empty()) error = _("Unable to save image ") + e.second;
+    }
+    if (!error.empty()) throw Error(error);
+  } else {
+    ImageEncoderPool encoder(jobs);
+    FOR_EACH(e, to_export) {
+      encoder.add(export_bitmap(set, e.first, false).ConvertToImage(), e.second);
+    }
+    encoder.finish();
   }
 }
@@ -0,0 +1,210 @@
+//+----------------------------------------------------------------------------+
+//| Description:  Magic Set Editor - Program to make Magic (tm) cards          |
+//| Copyright:    (C) Twan van Laarhoven and the other MSE developers          |
+//| License:      GNU General Public License 2 or later (see file COPYING)     |
+//+----------------------------------------------------------------------------+
+
+// ----------------------------------------------------------------------------- : Includes
+
+#include <util/prec.hpp>
+#include <data/format/render_cache.hpp>
+#include <data/set.hpp>
+#include <data/card.hpp>
+#include <data/game.hpp>
+#include <data/stylesheet.hpp>
+#include <data/settings.hpp>
+#include <data/field/image.hpp>
+#include <data/field/symbol.hpp>
+#include <util/io/writer.hpp>
+#include <util/io/package_manager.hpp>
+#include <util/error.hpp>
+#include <wx/sstream.h>
+#include <wx/filename.h>
+#include <wx/dir.h>
+
+RenderCache render_cache;
+
+// ----------------------------------------------------------------------------- : Hashing
+
+/// A 128 bit hash, made of two independent 64 bit hashes
+class RenderHash {
+public:
+  void add(const void* data, size_t size) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0 ; i < size ; ++i) {
+      a = (a ^ bytes[i]) * 0x100000001b3ULL; // FNV-1a
+      b = (b + bytes[i] + 1) * 0x9e3779b97f4a7c15ULL;
+      b ^= b >> 29;
+    }
+  }
+  void add(const String& str) {
+    wxScopedCharBuffer utf8 = str.utf8_str();
+    add(utf8.data(), utf8.length());
+    add("", 1); // separator
+  }
+  String toString() const {
+    return String::Format(_("%016llx%016llx"), (unsigned long long)a, (unsigned long long)b);
+  }
+private:
+  uint64_t a = 0xcbf29ce484222325ULL;
+  uint64_t b = 0;
+};
+
+/// Add the contents of the image and symbol files used by some values
+/** The file names alone are not enough, names are reused after unused files are removed */
+static void add_files(RenderHash& hash, Set& set, const IndexMap<FieldP,ValueP>& values) {
+  FOR_EACH_CONST(v, values) {
+    const LocalFileName* file = nullptr;
+    if (const ImageValue* image = dynamic_cast<const ImageValue*>(v.get())) {
+      file = &image->filename;
+    } else if (const SymbolValue* symbol = dynamic_cast<const SymbolValue*>(v.get())) {
+      file = &symbol->filename;
+    }
+    if (!file || file->empty()) continue;
+    try {
+      auto stream = set.openIn(*file);
+      char buffer[4096];
+      while (true) {
+        stream->Read(buffer, sizeof(buffer));
+        size_t n = stream->LastRead();
+        if (n == 0) break;
+        hash.add(buffer, n);
+      }
+    } catch (const Error&) {
+      // the file is missing, so it is not drawn either
+    }
+  }
+}
+
+// ----------------------------------------------------------------------------- : RenderCache
+
+RenderCache::RenderCache()
+  : scanned(false)
+  , total_size(0)
+{}
+
+bool RenderCache::enabled() const {
+  return settings.render_cache_size > 0;
+}
+
+String RenderCache::key(Set& set, const CardP& card) {
+  const StyleSheet& stylesheet = set.stylesheetFor(card);
+  const StyleSheetSettings& ss = settings.stylesheetSettingsFor(stylesheet);
+  RenderHash hash;
+  hash.add(app_version.toString());
+  // the data, written like it is in a set file
+  wxStringOutputStream stream;
+  Writer writer(stream, app_version);
+  writer.handle(_("card"), card);
+  writer.handle(_("set_info"), set.data);
+  writer.handle(_("styling"), set.stylingDataFor(card));
+  hash.add(stream.GetString());
+  add_files(hash, set, card->data());
+  add_files(hash, set, set.data);
+  add_files(hash, set, set.stylingDataFor(card));
+  // scripts can use the position of the card
+  size_t index = std::find(set.cards.begin(), set.cards.end(), card) - set.cards.begin();
+  hash.add(String::Format(_("%d/%d"), (int)index, (int)set.cards.size()));
+  // the templates, and the packages they use (symbol fonts, includes, ...)
+  hash.add(package_manager.stamp(*set.game));
+  hash.add(package_manager.stamp(stylesheet));
+  // render options, see export_bitmap
+  hash.add(String::Format(_("%d %g %g %d %d"),
+    (int)ss.card_normal_export(), ss.card_zoom(), ss.card_angle(), (int)ss.card_anti_alias(), (int)ss.card_borders()));
+  return hash.toString();
+}
+
+String RenderCache::directory() {
+  String dir = user_settings_dir() + _("cache");
+  if (!wxDirExists(dir)) wxMkdir(dir);
+  dir += _("/render");
+  if (!wxDirExists(dir)) wxMkdir(dir);
+  return dir + _("/");
+}
+
+Bitmap RenderCache::find(const String& key) {
+  String filename = directory() + key + _(".png");
+  if (wxFileExists(filename)) {
+    wxLogNull no_log; // a damaged file is the same as a missing one
+    Image img;
+    if (img.LoadFile(filename, wxBITMAP_TYPE_PNG)) {
+      wxFileName(filename).Touch(); // the modification time is used to find the least recently used images
+      ++hits;
+      return Bitmap(img);
+    }
+  }
+  ++misses;
+  return Bitmap();
+}
+
+void RenderCache::store(const String& key, const Bitmap& bitmap) {
+  String filename = directory() + key + _(".png");
+  Image img = bitmap.ConvertToImage();
+  img.SetOption(wxIMAGE_OPTION_PNG_COMPRESSION_LEVEL, 1); // favor speed over size
+  {
+    // write to a temporary file first, so other instances of the program never see a partial file
+    wxLogNull no_log;
+    String temp_name = filename + _(".tmp");
+    if (!img.SaveFile(temp_name, wxBITMAP_TYPE_PNG)) {
+      wxRemoveFile(temp_name);
+      return;
+    }
+    if (!wxRenameFile(temp_name, filename, true)) {
+      wxRemoveFile(temp_name);
+      return;
+    }
+  }
+  std::lock_guard<std::mutex> lock(mutex);
+  if (scanned) {
+    total_size += wxFileName::GetSize(filename).GetValue();
+  } else {
+    scan();
+  }
+  unsigned long long max_size = (unsigned long long)settings.render_cache_size << 20;
+  if (total_size > max_size) {
+    evict(max_size / 4 * 3); // leave some room, so we don't have to do this again for the next image
+  }
+}
+
+unsigned long long RenderCache::size() {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (!scanned) scan();
+  return total_size;
+}
+
+void RenderCache::scan() {
+  wxArrayString files;
+  wxDir::GetAllFiles(directory(), &files, _("*.png"), wxDIR_FILES);
+  total_size = 0;
+  for (size_t i = 0 ; i < files.size() ; ++i) {
+    total_size += wxFileName::GetSize(files[i]).GetValue();
+  }
+  scanned = true;
+}
+
+void RenderCache::evict(unsigned long long max_size) {
+  struct CachedFile {
+    String             filename;
+    time_t             used;
+    unsigned long long size;
+  };
+  wxArrayString files;
+  wxDir::GetAllFiles(directory(), &files, _("*.png"), wxDIR_FILES);
+  vector<CachedFile> cached;
+  total_size = 0;
+  for (size_t i = 0 ; i < files.size() ; ++i) {
+    wxDateTime modified = wxFileName(files[i]).GetModificationTime();
+    CachedFile f = { files[i], modified.IsValid() ? modified.GetTicks() : 0, wxFileName::GetSize(files[i]).GetValue() };
+    total_size += f.size;
+    cached.push_back(f);
+  }
+  // least recently used first
+  sort(cached.begin(), cached.end(), [](const CachedFile& a, const CachedFile& b) { return a.used < b.used; });
+  FOR_EACH_CONST(f, cached) {
+    if (total_size <= max_size) break;
+    if (wxRemoveFile(f.filename)) {
+      total_size -= f.size;
+      ++evictions;
+    }
+  }
+}
@@ -0,0 +1,59 @@
+//+----------------------------------------------------------------------------+
+//| Description:  Magic Set Editor - Program to make Magic (tm) cards          |
+//| Copyright:    (C) Twan van Laarhoven and the other MSE developers          |
+//| License:      GNU General Public License 2 or later (see file COPYING)     |
+//+----------------------------------------------------------------------------+
+
+#pragma once
+
+// ----------------------------------------------------------------------------- : Includes
+
+#include <util/prec.hpp>
+#include <atomic>
+#include <mutex>
+
+class Set;
+DECLARE_POINTER_TYPE(Card);
+
+// ----------------------------------------------------------------------------- : RenderCache
+
+/// A cache of rendered card images on disk, used by export_bitmap
+/** Images are stored in user_settings_dir()/cache/render, named after a hash of everything
+ *  that goes into rendering a card: the card, set and styling data, the image files they use,
+ *  the game and stylesheet packages, and the render options.
+ *  When the cache becomes larger than settings.render_cache_size,
+ *  the least recently used images are removed.
+ */
+class RenderCache {
+public:
+  RenderCache();
+
+  /// Is the cache enabled in the settings?
+  bool enabled() const;
+  /// The key under which the image of a card is cached
+  String key(Set& set, const CardP& card);
+  /// Find a cached image, returns a bitmap that is not Ok() if there is none
+  Bitmap find(const String& key);
+  /// Store an image in the cache, removing old images if the cache becomes too large
+  void store(const String& key, const Bitmap& bitmap);
+  /// Total size of the cached images in bytes
+  unsigned long long size();
+
+  std::atomic<size_t> hits{0};      ///< Number of images found in the cache
+  std::atomic<size_t> misses{0};    ///< Number of images that had to be rendered
+  std::atomic<size_t> evictions{0}; ///< Number of images removed to limit the size
+
+private:
+  std::mutex         mutex;      ///< Lock for the size bookkeeping
+  bool               scanned;    ///< Has total_size been determined?
+  unsigned long long total_size; ///< Size of all files in the cache
+
+  String directory();
+  /// Determine total_size, the lock must be held
+  void scan();
+  /// Remove least recently used images until the cache is at most max_size bytes, the lock must be held
+  void evict(unsigned long long max_size);
+};
+
+/// The global render cache
+extern RenderCache render_cache;
@@ -75,6 +75,7 @@ public:
   
 protected:
   void validate(Version) override;
+  bool cacheScripts() const override { return true; }
   
   DECLARE_REFLECTION_OVERRIDE();
 };
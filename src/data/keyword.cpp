@@ -8,9 +8,11 @@
 
 #include <util/prec.hpp>
 #include <data/keyword.hpp>
+#include <data/field/text.hpp>
 #include <util/tagged_string.hpp>
 #include <unordered_map>
 #include <unordered_set>
+#include <mutex>
 
 class KeywordTrie;
 DECLARE_POINTER_TYPE(KeywordParamValue);
@@ -226,9 +228,15 @@ public:
   KeywordTrie();
   ~KeywordTrie();
   
+  /// A keyword that is found when reaching a node
+  struct Finished {
+    const Keyword* keyword;
+    size_t start_length; ///< Length of the text at the start of the keyword leading to this node, 0 if the keyword starts with a parameter
+  };
+
   unordered_map<wxUniChar, unique_ptr<KeywordTrie>> children; ///< children after a given character
   KeywordTrie* on_any_star; ///< children on /.*/ (owned or this)
-  vector<const Keyword*> finished; ///< keywords that end in this node
+  vector<Finished> finished; ///< keywords that end in this node
   
   /// Insert nodes representing the given character
   /** return the node where the evaluation will be after matching the character */
@@ -273,9 +281,83 @@ KeywordTrie* KeywordTrie::insertAnyStar() {
 }
 
 
+// ----------------------------------------------------------------------------- : KeywordAutomaton
+
+/// Keywords that can match in a string
+struct KeywordCandidates {
+  unordered_set<const Keyword*> anywhere; ///< keywords that start with a parameter, these can match anywhere
+  unordered_map<const Keyword*, vector<size_t>> starts; ///< other keywords, with the positions in the untagged string where they can start
+};
+
+/// A deterministic automaton to find keywords, made from the trie
+/* A state of the automaton is a set of trie nodes, including those reached with on_any_star links.
+ * Since the root loops to itself on any character every state includes it, so like in the Aho-Corasick algorithm
+ * all keywords are found in a single pass over the string.
+ *
+ * States and transitions are only made when a string needs them, and are kept for the next strings.
+ * When there are too many states they are all forgotten.
+ * The automaton can be used from multiple threads.
+ */
+class KeywordAutomaton {
+public:
+  KeywordAutomaton(const KeywordTrie* root) : root(root) {}
+
+  /// Find the keywords that can match in a tagged string
+  void find(const String& tagged_str, KeywordCandidates& out);
+
+private:
+  struct State {
+    vector<const KeywordTrie*>       nodes;    ///< trie nodes in this state, sorted
+    vector<KeywordTrie::Finished>    finished; ///< keywords that end in this state
+    unordered_map<wxUniChar, State*> next;     ///< transitions that were made so far
+  };
+  const KeywordTrie* root;
+  std::mutex mutex; ///< Lock for the states
+  map<vector<const KeywordTrie*>, unique_ptr<State>> states;
+  State* start = nullptr;
+
+  /// The state for a set of trie nodes, after following on_any_star links
+  State* state(vector<const KeywordTrie*>& nodes);
+  /// The state after a character
+  State* step(State* from, wxUniChar c);
+};
+
+// ----------------------------------------------------------------------------- : KeywordExpansion
+
+/// A paragraph of a text with its keywords expanded
+struct KeywordParagraph {
+  /// A keyword that matches in the paragraph
+  struct Match {
+    const Keyword* keyword;
+    size_t         pos;  ///< position in the untagged paragraph
+    String         text; ///< the untagged text that matches
+    inline bool operator == (const Match& that) const {
+      return keyword == that.keyword && pos == that.pos && text == that.text;
+    }
+  };
+  bool                   first;       ///< the first paragraph of the text, the others come after a newline
+  String                 source;      ///< tagged text of the paragraph, including the newline at the end
+  vector<Match>          matches;     ///< all matches in the paragraph, they don't extend past its end
+  String                 result;      ///< the paragraph with keywords expanded
+  vector<const Keyword*> used;        ///< keywords added to the usage statistics
+  int                    atom;        ///< state at the end of the paragraph
+  char                   expand_type; ///< state at the end of the paragraph
+};
+
+/// The expansion of a text in paragraphs, kept while a value is being edited
+/** When the value is edited again, only paragraphs that changed are expanded again.
+ *  This assumes that nothing else the scripts use has changed in between,
+ *  any other update of the value doesn't use the previous expansion.
+ */
+struct KeywordExpansion {
+  ScriptValueP match_condition, expand_default, combine_script; ///< the options for the expansion
+  vector<KeywordParagraph> paragraphs;
+};
+
 // ----------------------------------------------------------------------------- : KeywordDatabase
 
 IMPLEMENT_DYNAMIC_ARG(KeywordUsageStatistics*, keyword_usage_statistics, nullptr);
+IMPLEMENT_DYNAMIC_ARG(const Value*, value_being_edited, nullptr);
 
 KeywordDatabase::KeywordDatabase()
   : root(nullptr)
@@ -284,7 +366,10 @@ KeywordDatabase::KeywordDatabase()
 KeywordDatabase::~KeywordDatabase() {}
 
 void KeywordDatabase::clear() {
+  automaton.reset();
   root.reset();
+  std::lock_guard<std::mutex> lock(expansions_mutex);
+  expansions.clear();
 }
 
 void KeywordDatabase::add(const vector<KeywordP>& kws) {
@@ -305,6 +390,7 @@ void KeywordDatabase::add(const Keyword& kw) {
   String text; // normal text
   size_t param = 0;
   bool only_star = true;
+  bool starts_with_text = true; // is text the start of the keyword?
   for (size_t i = 0 ; i < kw.match.size() ;) {
     Char c = kw.match.GetChar(i);
     if (is_substr(kw.match, i, _("<atom-param"))) {
@@ -315,18 +401,20 @@ void KeywordDatabase::add(const Keyword& kw) {
         kw.parameters[param]->eat_separator_after(kw.match, i);
       }
       ++param;
-      // match anything
-      cur = cur->insert(text);
-      text.clear();
-      cur = cur->insertAnyStar();
       // enough?
       if (!only_star) {
         // If we have matched anything specific, this is a good time to stop
         // it doesn't really matter how long we go on, since the trie is only used
         // as an optimization to not have to match lots of regexes.
         // As an added bonus, we get a better behaviour of matching earlier keywords first.
+        // If the text is the start of the keyword, then where it ends also tells us where the keyword starts.
         break;
       }
+      // match anything
+      cur = cur->insert(text);
+      text.clear();
+      cur = cur->insertAnyStar();
+      starts_with_text = false;
     } else {
       text += c;
       i++;
@@ -335,7 +423,9 @@ void KeywordDatabase::add(const Keyword& kw) {
   }
   cur = cur->insert(text);
   // now cur is the trie after matching the keyword anywhere in the input text
-  cur->finished.push_back(&kw);
+  cur->finished.push_back(KeywordTrie::Finished{&kw, starts_with_text ? text.size() : 0});
+  // the automaton has to see the new keyword
+  automaton = make_unique<KeywordAutomaton>(root.get());
 }
 
 void KeywordDatabase::prepare_parameters(const vector<KeywordParamP>& ps, const vector<KeywordP>& kws) {
@@ -359,6 +449,9 @@ void dump(int i, const KeywordTrie* t) {
 
 // ----------------------------------------------------------------------------- : KeywordDatabase : matching
 
+/// Maximum number of states of a KeywordAutomaton
+const size_t MAX_KEYWORD_AUTOMATON_STATES = 10000;
+
 // transitive closure of a state, follow all on_any_star links
 void closure(vector<const KeywordTrie*>& state) {
   for (size_t j = 0 ; j < state.size() ; ++j) {
@@ -366,6 +459,9 @@ void closure(vector<const KeywordTrie*>& state) {
       state.push_back(state[j]->on_any_star);
     }
   }
+  // a set of nodes, so equal states are found
+  sort(state.begin(), state.end());
+  state.erase(unique(state.begin(), state.end()), state.end());
 }
 
 void step_state(vector<const KeywordTrie*>& state, wxUniChar c) {
@@ -383,16 +479,45 @@ void step_state(vector<const KeywordTrie*>& state, wxUniChar c) {
   swap(state,next);
 }
 
-// Collect possible matching keywords
-/* First step in matching is to run over the string, and use the trie to find keywords that *potentially* appear in it.
- */
-unordered_set<Keyword const*> possible_matches(String const& tagged_str, KeywordTrie const* trie_root) {
-  unordered_set<const Keyword*> possible_matches;
-  if (!trie_root) return possible_matches;
+KeywordAutomaton::State* KeywordAutomaton::state(vector<const KeywordTrie*>& nodes) {
+  closure(nodes);
+  unique_ptr<State>& s = states[nodes];
+  if (!s) {
+    s = make_unique<State>();
+    s->nodes = nodes;
+    for (auto kt : nodes) {
+      s->finished.insert(s->finished.end(), kt->finished.begin(), kt->finished.end());
+    }
+  }
+  return s.get();
+}
 
-  vector<const KeywordTrie*> state;
-  state.push_back(trie_root);
+KeywordAutomaton::State* KeywordAutomaton::step(State* from, wxUniChar c) {
+  auto it = from->next.find(c);
+  if (it != from->next.end()) return it->second;
+  vector<const KeywordTrie*> nodes = from->nodes;
+  step_state(nodes, c);
+  if (states.size() >= MAX_KEYWORD_AUTOMATON_STATES) {
+    // start over, this also removes from
+    states.clear();
+    start = nullptr;
+    return state(nodes);
+  }
+  return from->next[c] = state(nodes);
+}
 
+// Collect possible matching keywords
+/* First step in matching is to run over the string, and use the automaton to find keywords that *potentially* appear in it.
+ * For keywords that start with text we also know where they can start: where that text ends, minus its length.
+ */
+void KeywordAutomaton::find(const String& tagged_str, KeywordCandidates& out) {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (!start) {
+    vector<const KeywordTrie*> nodes(1, root);
+    start = state(nodes);
+  }
+  State* cur = start;
+  size_t pos = 0; // position in the untagged string
   for (String::const_iterator it = tagged_str.begin(); it != tagged_str.end();) {
     wxUniChar c = *it;
     // tag?
@@ -400,19 +525,19 @@ unordered_set<Keyword const*> possible_matches(String const& tagged_str, Keyword
       it = skip_tag(it, tagged_str.end());
     } else {
       ++it;
+      ++pos;
       c = toLower(c); // case insensitive matching
-      // find 'next' trie node set matching c
-      step_state(state, c);
-      closure(state);
+      cur = step(cur, c);
       // matches
-      for (auto kt : state) {
-        for (auto kw : kt->finished) {
-          possible_matches.insert(kw);
+      for (auto const& f : cur->finished) {
+        if (f.start_length == 0) {
+          out.anywhere.insert(f.keyword);
+        } else {
+          out.starts[f.keyword].push_back(pos - f.start_length);
         }
       }
     }
   }
-  return possible_matches;
 }
 
 struct KeywordMatch {
@@ -429,7 +554,6 @@ struct KeywordMatch {
  */
 void keyword_matches(const String& untagged_str, const Keyword& keyword, vector<KeywordMatch>& out) {
   Regex::Results match;
-  size_t i = 0;
   String::const_iterator it = untagged_str.begin();
   while (keyword.match_re.matches(match, it, untagged_str.end())) {
     size_t pos = match[0].first - untagged_str.begin();
@@ -437,10 +561,29 @@ void keyword_matches(const String& untagged_str, const Keyword& keyword, vector<
     it = max(it+1, match[0].end());
   }
 }
-void keyword_matches(const String& untagged_str, unordered_set<Keyword const*> keywords, vector<KeywordMatch>& out) {
-  for (auto keyword : keywords) {
+// Match a keyword only at the given start positions (in increasing order)
+// This finds the same matches as searching the whole string
+void keyword_matches(const String& untagged_str, const Keyword& keyword, const vector<size_t>& starts, vector<KeywordMatch>& out) {
+  Regex::Results match;
+  String::const_iterator it = untagged_str.begin();
+  for (size_t pos : starts) {
+    String::const_iterator at = untagged_str.begin() + pos;
+    if (at < it) continue; // overlaps the previous match
+    // a search from it would not look at the characters before it
+    if (keyword.match_re.matches_at(match, at, untagged_str.end(), at != it)) {
+      out.emplace_back(keyword, match, pos);
+      it = max(at+1, match[0].end());
+    }
+  }
+}
+void keyword_matches(const String& untagged_str, const KeywordCandidates& candidates, vector<KeywordMatch>& out) {
+  for (auto keyword : candidates.anywhere) {
     keyword_matches(untagged_str, *keyword, out);
   }
+  for (auto const& kw_starts : candidates.starts) {
+    if (candidates.anywhere.count(kw_starts.first)) continue; // already matched everywhere
+    keyword_matches(untagged_str, *kw_starts.first, kw_starts.second, out);
+  }
 }
 void sort_keyword_matches(vector<KeywordMatch>& matches) {
   sort(matches.begin(), matches.end(), [](KeywordMatch const& a, KeywordMatch const& b) {
@@ -457,22 +600,42 @@ void sort_keyword_matches(vector<KeywordMatch>& matches) {
     return a.keyword->keyword < b.keyword->keyword;
   });
 }
-vector<KeywordMatch> keyword_matches(const String& untagged_str, unordered_set<Keyword const*> keywords) {
+vector<KeywordMatch> keyword_matches(const String& untagged_str, const KeywordCandidates& candidates) {
   vector<KeywordMatch> out;
-  keyword_matches(untagged_str, keywords, out);
+  keyword_matches(untagged_str, candidates, out);
   sort_keyword_matches(out);
   return out;
 }
 
 
 
+// ----------------------------------------------------------------------------- : KeywordDatabase : expanding
+
+/// Maximum number of values for which the previous expansion is kept
+const size_t MAX_KEYWORD_EXPANSIONS = 16;
+
+// The matches in the paragraph [untagged_pos, untagged_pos+untagged_len)
+// returns false if one of them extends past the end of the paragraph
+bool paragraph_matches(vector<KeywordMatch>::const_iterator match_it, vector<KeywordMatch>::const_iterator end, size_t untagged_pos, size_t untagged_len, vector<KeywordParagraph::Match>& out) {
+  for ( ; match_it != end && match_it->pos < untagged_pos + untagged_len ; ++match_it) {
+    if (match_it->pos < untagged_pos) continue;
+    if (match_it->pos + (size_t)match_it->match.length() > untagged_pos + untagged_len) return false;
+    out.push_back(KeywordParagraph::Match{match_it->keyword, match_it->pos - untagged_pos, match_it->match.str()});
+  }
+  return true;
+}
+
 tuple<bool,String::const_iterator> expand_keyword(String::const_iterator it, String::const_iterator end, KeywordMatch const& match, char expand_type, String& out, KeywordExpandOptions const& options);
 
 /* Last step in matching is to go over the string, and expand each of the matches, as long as they don't overlap
  * Note that matches are already sorted, so we can try them in order.
  * But as a complication, positions and lengths in matches refer to the untagged string.
+ *
+ * If there is a previous expansion, then paragraphs that are the same as before are copied from it.
+ * The paragraphs are stored in next.
  */
-String expand_keywords(const String& tagged_str, vector<KeywordMatch> const& matches, KeywordExpandOptions const& options) {
+String expand_keywords(const String& tagged_str, vector<KeywordMatch> const& matches, KeywordExpandOptions const& options,
+                       const KeywordExpansion* previous = nullptr, KeywordExpansion* next = nullptr) {
   vector<KeywordMatch>::const_iterator match_it = matches.begin();
   size_t untagged_pos = 0;
 
@@ -515,6 +678,65 @@ String expand_keywords(const String& tagged_str, vector<KeywordMatch> const& mat
     }
   };
 
+  // Paragraphs start at the start of the string and after newlines, in the default state
+  // Where the current paragraph started, paragraph_start == end if it is not in the default state
+  String::const_iterator paragraph_start = end;
+  vector<KeywordMatch>::const_iterator paragraph_match = match_it;
+  size_t paragraph_out = 0, paragraph_untagged = 0, paragraph_used = 0;
+  auto at_paragraph_start = [&]() {
+    paragraph_start = end;
+    if (atom != 0 || expand_type != default_expand_type) return;
+    bool first = it == tagged_str.begin();
+    // reuse paragraphs from the previous expansion
+    while (previous && it != end) {
+      String::const_iterator p_end = find(it, end, _('\n'));
+      if (p_end != end) ++p_end;
+      String source(it, p_end);
+      size_t p_untagged = untagged_length(it, p_end);
+      vector<KeywordParagraph::Match> p_matches;
+      if (!paragraph_matches(match_it, matches.end(), untagged_pos, p_untagged, p_matches)) break;
+      auto p = find_if(previous->paragraphs.begin(), previous->paragraphs.end(), [&](const KeywordParagraph& para) {
+        return para.first == first && para.source == source && para.matches == p_matches;
+      });
+      if (p == previous->paragraphs.end()) break;
+      out += p->result;
+      if (options.stat && options.stat_key) {
+        FOR_EACH_CONST(kw, p->used) options.stat->emplace_back(options.stat_key, kw);
+      }
+      atom = p->atom;
+      expand_type = p->expand_type;
+      it = p_end;
+      untagged_pos += p_untagged;
+      if (next) next->paragraphs.push_back(*p);
+      if (atom != 0 || expand_type != default_expand_type) return;
+      first = false;
+    }
+    paragraph_start    = it;
+    paragraph_match    = match_it;
+    paragraph_out      = out.size();
+    paragraph_untagged = untagged_pos;
+    paragraph_used     = options.stat ? options.stat->size() : 0;
+  };
+  auto at_paragraph_end = [&]() {
+    if (!next || paragraph_start == end) return;
+    KeywordParagraph p;
+    p.first = paragraph_start == tagged_str.begin();
+    if (!paragraph_matches(paragraph_match, matches.end(), paragraph_untagged, untagged_pos - paragraph_untagged, p.matches)) return;
+    p.source = String(paragraph_start, it);
+    p.result = out.substr(paragraph_out);
+    if (options.stat) {
+      for (size_t i = paragraph_used ; i < options.stat->size() ; ++i) p.used.push_back((*options.stat)[i].second);
+    }
+    p.atom = atom;
+    p.expand_type = expand_type;
+    next->paragraphs.push_back(move(p));
+  };
+
+  at_paragraph_start();
+  if (it != tagged_str.begin()) {
+    // we are after a newline of a paragraph that was reused
+    skip_tags_for_keyword(true, false);
+  }
   while (true) {
     // prefer to match 'outside' tags, so before open tags and after close tags
     // that way we avoid breaking up atoms
@@ -546,10 +768,15 @@ String expand_keywords(const String& tagged_str, vector<KeywordMatch> const& mat
     out += *it;
     ++it;
     ++untagged_pos;
+    if (*(it - 1) == _('\n')) {
+      at_paragraph_end();
+      at_paragraph_start();
+    }
     // after matching or skipping, go past close tags, to remain as much oustide tags as possible
     after_match:
     skip_tags_for_keyword(true, false);
   }
+  at_paragraph_end();
   return out;
 }
 
@@ -786,15 +1013,42 @@ String KeywordDatabase::expand(const String& text, KeywordExpandOptions const& o
   if (!root) return tagged;
 
   // Find potential matches
-  auto possible_matches = ::possible_matches(tagged, root.get());
+  KeywordCandidates candidates;
+  automaton->find(tagged, candidates);
 
   // Refine
   String untagged = untag_no_escape(tagged);
-  auto matches = keyword_matches(untagged, possible_matches);
+  auto matches = keyword_matches(untagged, candidates);
   
   // Expand
-  String result = expand_keywords(tagged, matches, options);
+  // When a value is being edited, paragraphs that were not changed are the same as in the previous expansion
+  unique_ptr<KeywordExpansion> previous, next;
+  if (options.stat_key) {
+    std::lock_guard<std::mutex> lock(expansions_mutex);
+    auto it = expansions.find(options.stat_key);
+    if (it != expansions.end()) {
+      previous = move(it->second);
+      expansions.erase(it);
+    }
+  }
+  if (options.stat_key && options.stat_key == value_being_edited()) {
+    if (previous && (previous->match_condition != options.match_condition || previous->expand_default != options.expand_default || previous->combine_script != options.combine_script)) {
+      previous.reset();
+    }
+    next = make_unique<KeywordExpansion>();
+    next->match_condition = options.match_condition;
+    next->expand_default  = options.expand_default;
+    next->combine_script  = options.combine_script;
+  } else {
+    previous.reset(); // something else might have changed
+  }
+  String result = expand_keywords(tagged, matches, options, previous.get(), next.get());
   assert_tagged(result, false);
+  if (next) {
+    std::lock_guard<std::mutex> lock(expansions_mutex);
+    if (expansions.size() >= MAX_KEYWORD_EXPANSIONS) expansions.clear();
+    expansions[options.stat_key] = move(next);
+  }
   return result;
 }
 
@@ -826,3 +1080,14 @@ ScriptValueP KeywordParamValue::getMember(const String& name) const {
   if (name == _("param"))            return to_script(value);
   return ScriptValue::getMember(name);
 }
+
+// ----------------------------------------------------------------------------- : Without a database
+
+String expand_keywords_without_database(const String& text, const vector<KeywordP>& keywords, const KeywordExpandOptions& options) {
+  String tagged = remove_keyword_tags(text);
+  String untagged = untag_no_escape(tagged);
+  vector<KeywordMatch> matches;
+  FOR_EACH_CONST(kw, keywords) keyword_matches(untagged, *kw, matches);
+  sort_keyword_matches(matches);
+  return expand_keywords(tagged, matches, options);
+}
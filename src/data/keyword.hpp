@@ -13,12 +13,15 @@
 #include <util/dynamic_arg.hpp>
 #include <util/regex.hpp>
 #include <data/filter.hpp>
+#include <mutex>
 
 DECLARE_POINTER_TYPE(KeywordParam);
 DECLARE_POINTER_TYPE(KeywordMode);
 DECLARE_POINTER_TYPE(Keyword);
 DECLARE_POINTER_TYPE(ParamReferenceType);
 class KeywordTrie;
+class KeywordAutomaton;
+struct KeywordExpansion;
 class Value;
 
 // ----------------------------------------------------------------------------- : Keyword parameters
@@ -134,6 +137,10 @@ inline String type_name(const vector<KeywordP>&) {
 /// Store keyword usage statistics here, using value_being_updated as the key
 typedef vector<pair<const Value*, const Keyword*>> KeywordUsageStatistics;
 
+/// The value whose text is being edited, while updating it
+/** Expanding keywords in that value can reuse the paragraphs that were not edited */
+DECLARE_DYNAMIC_ARG(const Value*, value_being_edited);
+
 struct KeywordExpandOptions {
   ScriptValueP match_condition;
   ScriptValueP expand_default;
@@ -176,6 +183,9 @@ public:
   
 private:
   unique_ptr<KeywordTrie> root; ///< Data structure for finding keywords
+  unique_ptr<KeywordAutomaton> automaton; ///< Deterministic version of the trie, states are made while matching
+  mutable std::mutex expansions_mutex; ///< Lock for expansions
+  mutable unordered_map<const Value*, unique_ptr<KeywordExpansion>> expansions; ///< Previous expansions of values that are being edited
   
   /// (try to) expand a single keyword
   /** If the keyword matches:
@@ -188,6 +198,10 @@ private:
                  KeywordUsageStatistics* stat, Value* stat_key) const;
 };
 
+/// Expand keywords by trying the regex of every keyword at every position, without a KeywordDatabase
+/** This is much slower than KeywordDatabase::expand, but it should give the same result */
+String expand_keywords_without_database(const String& text, const vector<KeywordP>& keywords, const KeywordExpandOptions& options);
+
 // ----------------------------------------------------------------------------- : Processing parameters
 
 /// A script value containing the value of a keyword parameter
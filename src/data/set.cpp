@@ -13,12 +13,14 @@
 #include <data/card.hpp>
 #include <data/keyword.hpp>
 #include <data/pack.hpp>
+#include <data/settings.hpp>
 #include <data/field.hpp>
 #include <data/field/text.hpp>    // for 0.2.7 fix
 #include <data/field/information.hpp>
 #include <util/tagged_string.hpp> // for 0.2.7 fix
 #include <util/order_cache.hpp>
 #include <util/delayed_index_maps.hpp>
+#include <util/io/package_manager.hpp>
 #include <script/script_manager.hpp>
 #include <script/profiler.hpp>
 #include <wx/sstream.h>
@@ -64,6 +66,19 @@ void Set::updateStyles(const CardP& card, bool only_content_dependent) {
 void Set::updateDelayed() {
   script_manager->updateDelayed();
 }
+void Set::setBackgroundUpdates(bool background) {
+  if (!background) script_manager->updateAllPending();
+  script_manager->background_updates = background;
+}
+bool Set::updatePending(long max_time) {
+  return script_manager->updatePending(max_time);
+}
+void Set::readAllCards() {
+  if (!lazy_cards) return;
+  lazy_cards.reset();
+  FOR_EACH(card, cards) card->data();
+  script_manager->updateAll();
+}
 
 Context& Set::getContextForThumbnails() {
   assert(!wxThread::IsMain());
@@ -153,7 +168,7 @@ void Set::validate(Version file_app_version) {
     // Since 0.2.7 we use </tag> style close tags, in older versions it was </>
     // Walk over all fields and fix...
     FOR_EACH(c, cards) {
-      FOR_EACH(v, c->data) fix_value_207(v);
+      FOR_EACH(v, c->data()) fix_value_207(v);
     }
     FOR_EACH(v, data) fix_value_207(v);
 /*    FOR_EACH(s, styleData) {
@@ -166,20 +181,42 @@ void Set::validate(Version file_app_version) {
   script_manager->updateAll();
 }
 
-void reflect_version_check(Reader& handler, const Char* key, intrusive_ptr<Packaged> const& package) {
-  if (!package) return;
+/// Returns true if the file was made with the same version of the package
+bool reflect_version_check(Reader& handler, const Char* key, intrusive_ptr<Packaged> const& package) {
+  if (!package) return true;
   Version v = package->version;
   handler.handle(key, v);
   if (package->version < v) {
     queue_message(MESSAGE_WARNING, "This set file is made with a newer version of the '" + package->name() + "' template. Please update the template files.");
   }
+  return v == package->version;
 }
-void reflect_version_check(Writer& handler, const Char* key, intrusive_ptr<Packaged> const& package) {
-  if (!package) return;
+bool reflect_version_check(Writer& handler, const Char* key, intrusive_ptr<Packaged> const& package) {
+  if (!package) return true;
   handler.handle(key, package->version);
+  return true;
+}
+bool reflect_version_check(GetMember& handler, const Char* key, intrusive_ptr<Packaged> const& package) { return true; }
+bool reflect_version_check(GetDefaultMember& handler, const Char* key, intrusive_ptr<Packaged> const& package) { return true; }
+
+/// The version of a template is often not changed while it is being edited, so also look at the modification times
+static String template_stamp(const GameP& game, const StyleSheetP& stylesheet) {
+  String stamp = package_manager.stamp(*game);
+  if (stylesheet) stamp += _(" ") + package_manager.stamp(*stylesheet);
+  return stamp;
 }
-void reflect_version_check(GetMember& handler, const Char* key, intrusive_ptr<Packaged> const& package) {}
-void reflect_version_check(GetDefaultMember& handler, const Char* key, intrusive_ptr<Packaged> const& package) {}
+/// Returns true if the file was made with the same template files, and their dependencies
+bool reflect_stamp_check(Reader& handler, const Char* key, const GameP& game, const StyleSheetP& stylesheet) {
+  String stamp;
+  handler.handle(key, stamp);
+  return stamp == template_stamp(game, stylesheet);
+}
+bool reflect_stamp_check(Writer& handler, const Char* key, const GameP& game, const StyleSheetP& stylesheet) {
+  handler.handle(key, template_stamp(game, stylesheet));
+  return true;
+}
+bool reflect_stamp_check(GetMember& handler, const Char* key, const GameP& game, const StyleSheetP& stylesheet) { return true; }
+bool reflect_stamp_check(GetDefaultMember& handler, const Char* key, const GameP& game, const StyleSheetP& stylesheet) { return true; }
 
 IMPLEMENT_REFLECTION(Set) {
   REFLECT(game);
@@ -187,11 +224,12 @@ IMPLEMENT_REFLECTION(Set) {
     REFLECT_IF_READING {
       data.init(game->set_fields);
     }
-    reflect_version_check(handler, _("game_version"), game);
+    bool up_to_date = reflect_version_check(handler, _("game_version"), game);
     WITH_DYNAMIC_ARG(game_for_reading, game.get());
     REFLECT(stylesheet);
     REFLECT_COMPAT(<300, "style", stylesheet);
-    reflect_version_check(handler, _("stylesheet_version"), stylesheet);
+    up_to_date &= reflect_version_check(handler, _("stylesheet_version"), stylesheet);
+    up_to_date &= reflect_stamp_check(handler, _("template_stamp"), game, stylesheet);
     WITH_DYNAMIC_ARG(stylesheet_for_reading, stylesheet.get());
     REFLECT_N("set_info", data);
     if (stylesheet) {
@@ -199,7 +237,7 @@ IMPLEMENT_REFLECTION(Set) {
       REFLECT_N("styling", styling_data);
     }
     // Experimental: save each card to a different file
-    reflect_cards(handler);
+    reflect_cards(handler, up_to_date);
     REFLECT(keywords);
     REFLECT(pack_types);
   }
@@ -210,16 +248,52 @@ IMPLEMENT_REFLECTION(Set) {
 
 // TODO: make this a more generic function to be used elsewhere
 template <typename Handler>
-void Set::reflect_cards (Handler& handler) {
+void Set::reflect_cards (Handler& handler, bool up_to_date) {
+  REFLECT(cards);
+}
+
+template <>
+void Set::reflect_cards<Reader> (Reader& handler, bool up_to_date) {
+  // When the file was saved with the same program and templates, the values of the cards are up to date.
+  // Then the cards don't have to be read now, only when they are used.
+  if (!settings.read_cards_lazily || !up_to_date || !(handler.formatVersion() == app_version) || !isZipfile()) {
+    REFLECT(cards);
+    return;
+  }
+  lazy_cards = make_intrusive<LazyCards>();
+  lazy_cards->game       = game;
+  lazy_cards->stylesheet = stylesheet;
+  lazy_cards->package    = this;
+  lazy_cards->filename   = absoluteFilename() + _("/") + typeName();
+  lazy_cards->header     = "mse_version: " + app_version.toString().ToStdString() + "\n";
+  // read the fields needed for the card list and for Card::identification
+  FOR_EACH(f, game->card_fields) {
+    if (f->identifying || f->index == 0 || (f->card_list_allow && settings.columnSettingsFor(*game, *f).visible)) {
+      lazy_cards->indexed.push_back(f);
+    }
+  }
+  WITH_DYNAMIC_ARG(lazy_cards_for_reading, lazy_cards.get());
   REFLECT(cards);
 }
 
 template <>
-void Set::reflect_cards<Writer> (Writer& handler) {
+void Set::reflect_cards<Writer> (Writer& handler, bool up_to_date) {
   // When writing to a directory, we write each card in a separate file.
   // We don't do this in zipfiles because it leads to bloat.
   if (isZipfile()) {
-    REFLECT(cards);
+    if (clipboard_package()) {
+      REFLECT(cards);
+      return;
+    }
+    // Cards are written in parallel, cards that have not been read are written from their text,
+    // so writing doesn't read them, which would change shared state
+    Package* writing = writing_package();
+    handler.handleParallel(_("cards"), cards, [&](const function<void ()>& write) {
+      WITH_DYNAMIC_ARG(writing_package, writing);
+      WITH_DYNAMIC_ARG(game_for_reading, game.get());
+      WITH_DYNAMIC_ARG(stylesheet_for_reading, stylesheet.get());
+      write();
+    });
   } else {
     set<String> used;
     FOR_EACH(card, cards) {
@@ -25,6 +25,7 @@ DECLARE_POINTER_TYPE(Value);
 DECLARE_POINTER_TYPE(Keyword);
 DECLARE_POINTER_TYPE(PackType);
 DECLARE_POINTER_TYPE(ScriptValue);
+DECLARE_POINTER_TYPE(LazyCards);
 class SetScriptManager;
 class SetScriptContext;
 class Context;
@@ -71,6 +72,15 @@ public:
   void updateStyles(const CardP& card, bool only_content_dependent);
   /// Update scripts that were delayed
   void updateDelayed();
+  /// Should scripts that depend on a changed value be updated in the background? (default: false)
+  /** Only the GUI enables this, it must then call updatePending when idle */
+  void setBackgroundUpdates(bool background);
+  /// Update some of the scripts waiting for a background update
+  /** Stops after max_time milliseconds, returns true if there is work left */
+  bool updatePending(long max_time);
+  /// Read all cards that were not read when opening the set, and update their scripts
+  /** Needed before using things that are not stored in the file, like keyword usage statistics */
+  void readAllCards();
   /// A context for performing scripts
   /** Should only be used from the thumbnail thread! */
   Context& getContextForThumbnails();
@@ -127,7 +137,10 @@ protected:
 private:
   DECLARE_REFLECTION_OVERRIDE();
   template <typename Handler>
-  void reflect_cards(Handler& handler);
+  void reflect_cards(Handler& handler, bool up_to_date);
+  
+  /// Cards are read lazily, see LazyCards. Reset by readAllCards()
+  LazyCardsP lazy_cards;
   
   /// Object for managing and executing scripts
   unique_ptr<SetScriptManager> script_manager;
@@ -168,10 +168,18 @@ Settings::Settings()
   , set_window_height    (300)
   , card_notes_height    (40)
   , open_sets_in_new_window(true)
+  , background_script_updates(true)
+  , save_compaction_threshold(25)
+  , read_cards_lazily    (true)
   , symbol_grid_size     (30)
   , symbol_grid          (true)
   , symbol_grid_snap     (false)
   , print_layout         (LAYOUT_NO_SPACE)
+  , render_cache_size    (256)
+  , generated_image_cache_size(128)
+  , decoded_image_cache_size(128)
+  , decoded_image_mipmaps(true)
+  , prefetch_cards(2)
 #if 0
   #if USE_OLD_STYLE_UPDATE_CHECKER
   , updates_url          ()
@@ -254,11 +262,19 @@ IMPLEMENT_REFLECTION_NO_SCRIPT(Settings) {
   REFLECT(set_window_height);
   REFLECT(card_notes_height);
   REFLECT(open_sets_in_new_window);
+  REFLECT(background_script_updates);
+  REFLECT(save_compaction_threshold);
+  REFLECT(read_cards_lazily);
   REFLECT(symbol_grid_size);
   REFLECT(symbol_grid);
   REFLECT(symbol_grid_snap);
   REFLECT(default_game);
   REFLECT(print_layout);
+  REFLECT(render_cache_size);
+  REFLECT(generated_image_cache_size);
+  REFLECT(decoded_image_cache_size);
+  REFLECT(decoded_image_mipmaps);
+  REFLECT(prefetch_cards);
   REFLECT(apprentice_location);
 #if 0
   #if USE_OLD_STYLE_UPDATE_CHECKER
@@ -153,6 +153,9 @@ public:
   UInt set_window_height;
   UInt card_notes_height;
   bool open_sets_in_new_window;
+  bool background_script_updates; ///< Update scripts depending on an edit while the program is idle
+  UInt save_compaction_threshold; ///< Sets are saved by appending changed files, until more than this percentage of the file is unused, 0 always rewrites the file
+  bool read_cards_lazily;         ///< Only read the values of cards in a set when they are used
   
   // --------------------------------------------------- : Symbol editor
   UInt symbol_grid_size;
@@ -189,6 +192,14 @@ public:
   
   PageLayoutType print_layout;
   
+  // --------------------------------------------------- : Caching
+  
+  UInt render_cache_size; ///< Maximum size of the cache of rendered cards in MB, 0 disables the cache
+  UInt generated_image_cache_size; ///< Maximum memory used by the shared cache of generated images in MB, 0 disables the cache
+  UInt decoded_image_cache_size;   ///< Maximum memory used by the cache of images loaded from packages in MB, 0 disables the cache
+  bool decoded_image_mipmaps;      ///< Keep scaled down versions of images loaded from packages?
+  UInt prefetch_cards;             ///< Number of cards before and after the selected card that are prepared in the background, 0 disables prefetching
+  
   // --------------------------------------------------- : Special game stuff
   String apprentice_location;
   
@@ -225,3 +236,6 @@ private:
 /// The global settings object
 extern Settings settings;
 
+/// Directory to use for settings and other data files, ending in a slash (defined in settings.cpp)
+String user_settings_dir();
+
@@ -8,6 +8,7 @@
 
 #include <util/prec.hpp>
 #include <gfx/gfx.hpp>
+#include <gfx/image_kernels.hpp>
 #include <util/error.hpp>
 
 // ----------------------------------------------------------------------------- : Linear Blend
@@ -43,18 +44,19 @@ void linear_blend(Image& img1, const Image& img2, double x1,double y1, double x2
   int d  = to_int( - (x1 * width * xm + y1 * height * ym) );
   
   Byte *data1 = img1.GetData(), *data2 = img2.GetData();
+  const ImageKernels& kernels = image_kernels();
+  vector<int> mults(3 * width); // multiplier for each subpixel in a row
   // blend pixels
   for (int y = 0 ; y < height ; ++y) {
     for (int x = 0 ; x < width ; ++x) {
       int mult = x * xm + y * ym + d;
       if (mult < 0)      mult = 0;
       if (mult > fixed)  mult = fixed;
-      data1[0] = data1[0] + mult * (data2[0] - data1[0]) / fixed;
-      data1[1] = data1[1] + mult * (data2[1] - data1[1]) / fixed;
-      data1[2] = data1[2] + mult * (data2[2] - data1[2]) / fixed;
-      data1 += 3;
-      data2 += 3;
+      mults[3*x] = mults[3*x+1] = mults[3*x+2] = mult;
     }
+    kernels.fixed_blend(data1, data2, mults.data(), 3 * width);
+    data1 += 3 * width;
+    data2 += 3 * width;
   }
 }
 
@@ -69,9 +71,7 @@ void mask_blend(Image& img1, const Image& img2, const Image& mask) {
   UInt size = img1.GetWidth() * img1.GetHeight() * 3;
   Byte *data1 = img1.GetData(), *data2 = img2.GetData(), *dataM = mask.GetData();
   // for each subpixel...
-  for (UInt i = 0 ; i < size ; ++i) {
-    data1[i] = (data1[i] * dataM[i] + data2[i] * (255 - dataM[i])) / 255;
-  }
+  image_kernels().mask_blend(data1, data2, dataM, size);
 }
 
 // ----------------------------------------------------------------------------- : Alpha
@@ -96,11 +96,7 @@ void set_alpha(Image& img, Byte* al, const wxSize& alpha_size) {
     memcpy(img.GetAlpha(), al, img.GetWidth() * img.GetHeight());
   } else{
     // merge
-    Byte *im = img.GetAlpha();
-    size_t size = img.GetWidth() * img.GetHeight();
-    for (size_t i = 0 ; i < size ; ++i) {
-      im[i] = (im[i] * al[i]) / 255;
-    }
+    image_kernels().multiply(img.GetAlpha(), al, img.GetWidth() * img.GetHeight());
   }
 }
 
@@ -110,10 +106,6 @@ void set_alpha(Image& img, double alpha) {
     img.InitAlpha();
     memset(img.GetAlpha(), b_alpha, img.GetWidth() * img.GetHeight());
   } else {
-    Byte *im = img.GetAlpha();
-    size_t size = img.GetWidth() * img.GetHeight();
-    for (size_t i = 0 ; i < size ; ++i) {
-      im[i] = (im[i] * b_alpha) / 255;
-    }
+    image_kernels().multiply_const(img.GetAlpha(), b_alpha, img.GetWidth() * img.GetHeight());
   }
 }
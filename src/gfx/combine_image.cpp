@@ -8,6 +8,7 @@
 
 #include <util/prec.hpp>
 #include <gfx/gfx.hpp>
+#include <gfx/image_kernels.hpp>
 #include <util/reflect.hpp>
 #include <algorithm>
 
@@ -87,32 +88,21 @@ COMBINE_FUN(COMBINE_SYMMETRIC_OVERLAY, (Combine<COMBINE_OVERLAY>::f(a,b) + Combi
 
 // ----------------------------------------------------------------------------- : Combining
 
-/// Combine image b onto image a using some combining mode.
-/// The results are stored in the image A.
+/// Combine the bytes of b onto those of a using some combining mode.
+/// The results are stored in a.
 template <ImageCombine combine>
-void combine_image_do(Image& a, Image b) {
-  UInt size = a.GetWidth() * a.GetHeight() * 3;
-  Byte *dataA = a.GetData(), *dataB = b.GetData();
+void combine_image_do(Byte* dataA, const Byte* dataB, size_t size) {
   // for each pixel: apply function
-  for (UInt i = 0 ; i < size ; ++i) {
+  for (size_t i = 0 ; i < size ; ++i) {
     dataA[i] = Combine<combine>::f(dataA[i], dataB[i]);
   }
 }
 
-void combine_image(Image& a, const Image& b, ImageCombine combine) {
-  // Images must have same size
-  assert(a.GetWidth()  == b.GetWidth());
-  assert(a.GetHeight() == b.GetHeight());
-  // Copy alpha channel?
-  if (b.HasAlpha()) {
-    if (!a.HasAlpha()) a.InitAlpha();
-    memcpy(a.GetAlpha(), b.GetAlpha(), a.GetWidth() * a.GetHeight());
-  }
-  // Combine image data, by dispatching to combineImageDo
+void combine_bytes_scalar(ImageCombine combine, Byte* a, const Byte* b, size_t n) {
   switch(combine) {
-    #define DISPATCH(comb) case comb: combine_image_do<comb>(a,b); return
+    #define DISPATCH(comb) case comb: combine_image_do<comb>(a,b,n); return
     case COMBINE_DEFAULT:
-    case COMBINE_NORMAL: a = b; return; // no need to do a per pixel operation
+    case COMBINE_NORMAL: memcpy(a, b, n); return;
     DISPATCH(COMBINE_ADD);
     DISPATCH(COMBINE_SUBTRACT);
     DISPATCH(COMBINE_STAMP);
@@ -136,6 +126,26 @@ void combine_image(Image& a, const Image& b, ImageCombine combine) {
     DISPATCH(COMBINE_XOR);
     DISPATCH(COMBINE_SHADOW);
     DISPATCH(COMBINE_SYMMETRIC_OVERLAY);
+    #undef DISPATCH
+  }
+}
+
+void combine_image(Image& a, const Image& b, ImageCombine combine) {
+  // Images must have same size
+  assert(a.GetWidth()  == b.GetWidth());
+  assert(a.GetHeight() == b.GetHeight());
+  // Copy alpha channel?
+  if (b.HasAlpha()) {
+    if (!a.HasAlpha()) a.InitAlpha();
+    memcpy(a.GetAlpha(), b.GetAlpha(), a.GetWidth() * a.GetHeight());
+  }
+  if (combine <= COMBINE_NORMAL) {
+    a = b; return; // no need to do a per pixel operation
+  }
+  // Combine image data, with a vector kernel if there is one for this mode
+  size_t size = a.GetWidth() * a.GetHeight() * 3;
+  if (!image_kernels().combine(combine, a.GetData(), b.GetData(), size)) {
+    combine_bytes_scalar(combine, a.GetData(), b.GetData(), size);
   }
 }
 
@@ -0,0 +1,140 @@
+//+----------------------------------------------------------------------------+
+//| Description:  Magic Set Editor - Program to make Magic (tm) cards          |
+//| Copyright:    (C) Twan van Laarhoven and the other MSE developers          |
+//| License:      GNU General Public License 2 or later (see file COPYING)     |
+//+----------------------------------------------------------------------------+
+
+// ----------------------------------------------------------------------------- : Includes
+
+#include <util/prec.hpp>
+#include <gfx/decoded_image_cache.hpp>
+#include <gfx/gfx.hpp>
+#include <util/io/package.hpp>
+#include <data/settings.hpp>
+#include <gui/util.hpp> // image_load_file
+
+DecodedImageCache decoded_image_cache;
+
+static size_t image_size(const Image& image) {
+  return (size_t)image.GetWidth() * image.GetHeight() * (image.HasAlpha() ? 4 : 3);
+}
+
+static Image load_image(Package& package, const String& filename) {
+  auto stream = package.openIn(filename);
+  Image image;
+  if (image_load_file(image, *stream)) {
+    if (image.HasMask()) image.InitAlpha(); // we can't handle masks
+  }
+  return image;
+}
+
+// ----------------------------------------------------------------------------- : Key
+
+DecodedImageCache::Key::Key(Package& package, const String& filename)
+  : package(&package), package_name(package.absoluteFilename())
+  , filename(filename), modified(0)
+{
+  DateTime time = package.modificationTime(filename);
+  if (time.IsValid()) modified = time.GetValue();
+  hash = std::hash<const void*>()(this->package);
+  hash = hash * 31 + std::hash<std::wstring>()(filename.ToStdWstring());
+  hash = hash * 31 + std::hash<long long>()(modified.GetValue());
+}
+
+bool DecodedImageCache::Key::operator == (const Key& that) const {
+  return hash == that.hash
+      && package == that.package && modified == that.modified
+      && filename == that.filename && package_name == that.package_name;
+}
+
+// ----------------------------------------------------------------------------- : DecodedImageCache
+
+DecodedImageCache::DecodedImageCache()
+  : total_size(0)
+  , hits(0), misses(0), evictions(0)
+{}
+
+Image DecodedImageCache::get(Package& package, const String& filename, int min_width, int min_height) {
+  size_t max_size = (size_t)settings.decoded_image_cache_size << 20;
+  if (max_size == 0) return load_image(package, filename); // disabled
+  Key key(package, filename);
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = index.find(&key);
+    if (it != index.end()) {
+      // move to front
+      entries.splice(entries.begin(), entries, it->second);
+      ++hits;
+      Image result = pick(entries.front(), min_width, min_height);
+      evict(max_size, &entries.front());
+      return result;
+    }
+    ++misses;
+  }
+  // load the image without holding the lock, other threads can use the cache in the meantime
+  Image image = load_image(package, filename);
+  if (!image.Ok()) return image;
+  std::lock_guard<std::mutex> lock(mutex);
+  auto it = index.find(&key);
+  if (it != index.end()) {
+    // another thread loaded the same image
+    entries.splice(entries.begin(), entries, it->second);
+  } else {
+    size_t size = image_size(image);
+    entries.push_front(Entry{move(key), {image}, size});
+    index[&entries.front().key] = entries.begin();
+    total_size += size;
+  }
+  image = Image(); // the reference counts of images are not thread safe, only share the image inside the lock
+  Image result = pick(entries.front(), min_width, min_height);
+  evict(max_size, &entries.front());
+  return result;
+}
+
+Image DecodedImageCache::pick(Entry& entry, int min_width, int min_height) {
+  size_t level = 0;
+  if (min_width > 0 && min_height > 0) {
+    if (settings.decoded_image_mipmaps) addLevels(entry, min_width, min_height);
+    while (level + 1 < entry.levels.size() &&
+           entry.levels[level + 1].GetWidth() >= min_width && entry.levels[level + 1].GetHeight() >= min_height) {
+      ++level;
+    }
+  }
+  return entry.levels[level].Copy();
+}
+
+void DecodedImageCache::addLevels(Entry& entry, int min_width, int min_height) {
+  while (true) {
+    int w = entry.levels.back().GetWidth() / 2, h = entry.levels.back().GetHeight() / 2;
+    if (w < min_width || h < min_height) break;
+    Image smaller = resample(entry.levels.back(), w, h);
+    size_t size = image_size(smaller);
+    entry.levels.push_back(smaller);
+    entry.size += size;
+    total_size += size;
+  }
+}
+
+void DecodedImageCache::evict(size_t max_size, const Entry* keep) {
+  // least recently used first
+  for (auto it = entries.end() ; it != entries.begin() && total_size > max_size ; ) {
+    --it;
+    if (&*it == keep) continue;
+    total_size -= it->size;
+    index.erase(&it->key);
+    it = entries.erase(it);
+    ++evictions;
+  }
+}
+
+void DecodedImageCache::clear() {
+  std::lock_guard<std::mutex> lock(mutex);
+  index.clear();
+  entries.clear();
+  total_size = 0;
+}
+
+DecodedImageCacheInfo DecodedImageCache::info() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return DecodedImageCacheInfo{entries.size(), total_size, hits, misses, evictions};
+}
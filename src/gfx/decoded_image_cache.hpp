@@ -0,0 +1,95 @@
+//+----------------------------------------------------------------------------+
+//| Description:  Magic Set Editor - Program to make Magic (tm) cards          |
+//| Copyright:    (C) Twan van Laarhoven and the other MSE developers          |
+//| License:      GNU General Public License 2 or later (see file COPYING)     |
+//+----------------------------------------------------------------------------+
+
+#pragma once
+
+// ----------------------------------------------------------------------------- : Includes
+
+#include <util/prec.hpp>
+#include <list>
+#include <mutex>
+
+class Package;
+
+// ----------------------------------------------------------------------------- : DecodedImageCache
+
+/// Statistics of a DecodedImageCache
+struct DecodedImageCacheInfo {
+  size_t count;     ///< Number of cached images
+  size_t size;      ///< Memory used by the cached images in bytes, including the scaled down versions
+  size_t hits;      ///< Number of images found in the cache
+  size_t misses;    ///< Number of images that had to be loaded
+  size_t evictions; ///< Number of images removed to limit the size
+};
+
+/// A cache of images loaded from files in packages, so they are not decoded again for every generated image
+/** Images are identified by the package, the name of the file and its modification time,
+ *  so a file that is changed is loaded again.
+ *
+ *  With settings.decoded_image_mipmaps, scaled down versions of each image are kept as well, each half the size of the previous one.
+ *  Requests for a small image are then served from the smallest version that is large enough.
+ *
+ *  When the cache is larger than settings.decoded_image_cache_size, the least recently used images are removed.
+ *
+ *  Unlike GeneratedImageCache this cache can be used from any thread:
+ *  images are only shared inside the cache, get returns a copy.
+ */
+class DecodedImageCache {
+public:
+  DecodedImageCache();
+
+  /// Load an image from a file in a package, or take it from the cache
+  /** If min_width and min_height are positive, the result can be a scaled down version of the image that is at least that large.
+   *  The result is not shared, it can be modified.
+   *  Returns an image that is not Ok() if the file is not an image, throws an error if it can't be opened.
+   */
+  Image get(Package& package, const String& filename, int min_width = 0, int min_height = 0);
+  /// Remove all images, for instance because packages were reloaded
+  void clear();
+
+  /// Statistics of the cache
+  DecodedImageCacheInfo info() const;
+
+private:
+  /// A file in a package
+  struct Key {
+    Package*   package;
+    String     package_name; ///< Absolute filename of the package, in case another package is created at the same address
+    String     filename;
+    wxLongLong modified;
+    size_t     hash;
+
+    Key(Package& package, const String& filename);
+    bool operator == (const Key& that) const;
+  };
+  struct Entry {
+    Key           key;
+    vector<Image> levels; ///< The image, followed by versions that are each half the size of the previous one
+    size_t        size;   ///< Memory used by the levels
+  };
+  struct KeyHash {
+    inline size_t operator () (const Key* k) const { return k->hash; }
+  };
+  struct KeyEqual {
+    inline bool operator () (const Key* a, const Key* b) const { return *a == *b; }
+  };
+
+  mutable std::mutex mutex; ///< Lock for all members
+  list<Entry> entries; ///< Most recently used first
+  unordered_map<const Key*, list<Entry>::iterator, KeyHash, KeyEqual> index;
+  size_t total_size;
+  size_t hits, misses, evictions;
+
+  /// A copy of the smallest level of an entry that is at least min_width by min_height
+  Image pick(Entry& entry, int min_width, int min_height);
+  /// Add scaled down versions of the image until the smallest is less than twice as large as needed
+  void addLevels(Entry& entry, int min_width, int min_height);
+  /// Remove images until the cache is at most max_size bytes, except for the given entry
+  void evict(size_t max_size, const Entry* keep);
+};
+
+/// The global decoded image cache
+extern DecodedImageCache decoded_image_cache;
@@ -0,0 +1,154 @@
+//+----------------------------------------------------------------------------+
+//| Description:  Magic Set Editor - Program to make Magic (tm) cards          |
+//| Copyright:    (C) Twan van Laarhoven and the other MSE developers          |
+//| License:      GNU General Public License 2 or later (see file COPYING)     |
+//+----------------------------------------------------------------------------+
+
+// ----------------------------------------------------------------------------- : Includes
+
+#include <util/prec.hpp>
+#include <gfx/font_metrics.hpp>
+#include <wx/dcmemory.h>
+#include <chrono>
+
+FontMetricsCache font_metrics_cache;
+
+/// Maximum number of texts remembered per font, when there are more the texts of that font are forgotten
+const size_t MAX_TEXTS_PER_FONT = 4096;
+
+static int text_width(wxDC& dc, const String& text) {
+  int w, h;
+  dc.GetTextExtent(text, &w, &h);
+  return w;
+}
+
+// ----------------------------------------------------------------------------- : FontMetricsCache
+
+FontMetricsCache::FontMetricsCache()
+  : hits(0), misses(0)
+{}
+
+void FontMetricsCache::measure(wxDC& dc, const String& text, size_t start, size_t end, int* widths_out) {
+  if (start >= end) return;
+  String key = dc.GetFont().GetNativeFontInfoDesc();
+  String line = text.substr(start, end - start);
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = fonts.find(key);
+    if (it != fonts.end()) {
+      auto widths = it->second.texts.find(line);
+      if (widths != it->second.texts.end()) {
+        ++hits;
+        copy(widths->second.begin(), widths->second.end(), widths_out);
+        return;
+      }
+    }
+    ++misses;
+  }
+  // measure it without holding the lock
+  // the extents are the widths of the prefixes, so the widths add up to the width of the text
+  wxArrayInt extents;
+  dc.GetPartialTextExtents(line, extents);
+  vector<int> widths(line.size());
+  int prev = 0;
+  for (size_t i = 0 ; i < widths.size() ; ++i) {
+    int extent = i < extents.size() ? extents[i] : prev;
+    widths[i] = extent - prev;
+    prev = extent;
+  }
+  copy(widths.begin(), widths.end(), widths_out);
+  // store
+  std::lock_guard<std::mutex> lock(mutex);
+  Metrics& metrics = fonts[key];
+  if (metrics.texts.size() >= MAX_TEXTS_PER_FONT) metrics.texts.clear();
+  metrics.texts.emplace(move(line), move(widths));
+}
+
+void FontMetricsCache::height(wxDC& dc, int* text_height_out, int* char_height_out) {
+  String key = dc.GetFont().GetNativeFontInfoDesc();
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = fonts.find(key);
+    if (it != fonts.end() && it->second.text_height >= 0) {
+      *text_height_out = it->second.text_height;
+      *char_height_out = it->second.char_height;
+      return;
+    }
+  }
+  int w;
+  dc.GetTextExtent(_("H"), &w, text_height_out);
+  *char_height_out = dc.GetCharHeight();
+  std::lock_guard<std::mutex> lock(mutex);
+  Metrics& metrics = fonts[key];
+  metrics.text_height = *text_height_out;
+  metrics.char_height = *char_height_out;
+}
+
+void FontMetricsCache::clear() {
+  std::lock_guard<std::mutex> lock(mutex);
+  fonts.clear();
+}
+
+FontMetricsCacheInfo FontMetricsCache::info() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return FontMetricsCacheInfo{fonts.size(), hits, misses};
+}
+
+// ----------------------------------------------------------------------------- : Benchmark
+
+String text_layout_benchmark() {
+  // a long rules text, measured at the font sizes a search for a fitting scale goes through
+  String text;
+  for (int i = 0 ; i < 6 ; ++i) {
+    text += _("Flying, first strike. When this creature enters the battlefield, each opponent sacrifices a creature ");
+    text += _("with the greatest power among creatures they control, then you draw a card for each \u201Cquest\u201D counter on it. ");
+  }
+  const int sizes[] = {40, 34, 30, 27, 28, 29, 28};
+  const int repeat = 5;
+  wxBitmap bitmap(16, 16);
+  wxMemoryDC dc(bitmap);
+  vector<int> widths(text.size());
+  // measure every prefix, like text layout used to do
+  auto prefix = [&]() {
+    long total = 0;
+    FOR_EACH_CONST(size, sizes) {
+      dc.SetFont(wxFont(size, wxFONTFAMILY_ROMAN, wxFONTSTYLE_NORMAL, wxFONTWEIGHT_NORMAL));
+      int prev = 0;
+      for (size_t i = 0 ; i < text.size() ; ++i) {
+        int w = text_width(dc, text.substr(0, i + 1));
+        widths[i] = w - prev;
+        prev = w;
+      }
+      total += prev;
+    }
+    return total;
+  };
+  auto cached = [&]() {
+    long total = 0;
+    FOR_EACH_CONST(size, sizes) {
+      dc.SetFont(wxFont(size, wxFONTFAMILY_ROMAN, wxFONTSTYLE_NORMAL, wxFONTWEIGHT_NORMAL));
+      font_metrics_cache.measure(dc, text, 0, text.size(), widths.data());
+      FOR_EACH(w, widths) total += w;
+    }
+    return total;
+  };
+  typedef std::function<long ()> Measure;
+  vector<pair<String,Measure>> ways = {
+    {_("prefix"),       prefix},
+    {_("cache (cold)"), [&]() { font_metrics_cache.clear(); return cached(); }},
+    {_("cache (warm)"), cached},
+  };
+  String result = String::Format(_("%d characters, %d font sizes\n"), (int)text.size(), (int)(sizeof(sizes) / sizeof(sizes[0])));
+  result += String::Format(_("%-18s%10s%10s\n"), _("method"), _("ms"), _("width"));
+  FOR_EACH(way, ways) {
+    double best = 1e9;
+    long total = 0;
+    for (int i = 0 ; i < repeat ; ++i) {
+      auto start = std::chrono::steady_clock::now();
+      total = way.second();
+      best = min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+    result += String::Format(_("%-18s%10.2f%10ld\n"), way.first, best * 1000, total);
+  }
+  return result;
+}
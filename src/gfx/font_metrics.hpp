@@ -0,0 +1,63 @@
+//+----------------------------------------------------------------------------+
+//| Description:  Magic Set Editor - Program to make Magic (tm) cards          |
+//| Copyright:    (C) Twan van Laarhoven and the other MSE developers          |
+//| License:      GNU General Public License 2 or later (see file COPYING)     |
+//+----------------------------------------------------------------------------+
+
+#pragma once
+
+// ----------------------------------------------------------------------------- : Includes
+
+#include <util/prec.hpp>
+#include <mutex>
+
+// ----------------------------------------------------------------------------- : FontMetricsCache
+
+/// Statistics of a FontMetricsCache
+struct FontMetricsCacheInfo {
+  size_t count;  ///< Number of fonts in the cache
+  size_t hits;   ///< Number of texts that were in the cache
+  size_t misses; ///< Number of texts that had to be measured
+};
+
+/// A cache of the widths of characters in texts, so text can be measured without asking the dc for every prefix
+/** Texts are measured with wxDC::GetPartialTextExtents, which includes kerning and ligatures.
+ *  For each font (face, size, weight, style and underline) the widths of the characters
+ *  of the texts measured in that font are remembered.
+ *  The search for a fitting scale measures the same texts at the same font sizes over and over again.
+ *
+ *  The cache is shared by all text viewers, and can be used from any thread.
+ */
+class FontMetricsCache {
+public:
+  FontMetricsCache();
+
+  /// Measure the characters text[start...end) in the current font of the dc
+  /** widths_out[i] is set to the width of character start+i in device units.
+   *  The widths add up to the width of the whole text.
+   *  The text should not contain newlines, so a line should be measured at once.
+   */
+  void measure(wxDC& dc, const String& text, size_t start, size_t end, int* widths_out);
+  /// Height of text in the current font of the dc in device units, as given by GetTextExtent and GetCharHeight
+  void height(wxDC& dc, int* text_height_out, int* char_height_out);
+  /// Forget all fonts
+  void clear();
+
+  /// Statistics of the cache
+  FontMetricsCacheInfo info() const;
+
+private:
+  struct Metrics {
+    int text_height = -1, char_height = -1;
+    unordered_map<String,vector<int>> texts; ///< Widths of the characters of texts
+  };
+  mutable std::mutex mutex; ///< Lock for all members
+  unordered_map<String,Metrics> fonts; ///< Metrics by description of the font
+  size_t hits, misses;
+};
+
+/// The global font metrics cache
+extern FontMetricsCache font_metrics_cache;
+
+/// Compare measuring rules text from the cache with measuring every prefix, returns a table of results
+String text_layout_benchmark();
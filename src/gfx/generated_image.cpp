@@ -8,12 +8,23 @@
 
 #include <util/prec.hpp>
 #include <gfx/generated_image.hpp>
+#include <gfx/decoded_image_cache.hpp>
 #include <util/io/package.hpp>
 #include <util/error.hpp>
 #include <data/symbol.hpp>
 #include <data/field/symbol.hpp>
 #include <render/symbol/filter.hpp>
 #include <gui/util.hpp> // load_resource_image
+#include <typeinfo>
+
+// ----------------------------------------------------------------------------- : Hashing
+
+template <typename T> static inline size_t hash_combine(size_t h, const T& x) {
+  return h * 31 + std::hash<T>()(x);
+}
+static inline size_t hash_combine(size_t h, Color c) {
+  return h * 31 + c.packed;
+}
 
 // ----------------------------------------------------------------------------- : GeneratedImage
 
@@ -23,8 +34,17 @@ GeneratedImageP GeneratedImage::toImage() const {
   return const_cast<GeneratedImage*>(this)->intrusive_from_this();
 }
 
+size_t GeneratedImage::hash() const {
+  return typeid(*this).hash_code();
+}
+size_t SimpleFilterImage::hash() const {
+  return hash_combine(GeneratedImage::hash(), image->hash());
+}
+
 Image GeneratedImage::generateConform(const Options& options) const {
-  return conform_image(generate(options),options);
+  Options sub_options(options);
+  sub_options.downscale_sources = true;
+  return conform_image(generate(sub_options),options);
 }
 
 Image conform_image(const Image& img, const GeneratedImage::Options& options) {
@@ -78,6 +98,53 @@ Image conform_image(const Image& img, const GeneratedImage::Options& options) {
   return image;
 }
 
+/// Scale down an image loaded from a file to the size conform_image will give it, if the options allow that
+/** Blending and combining then works on the small images, instead of on the full size ones.
+ *  The border of ASPECT_BORDER is not added, that is left to conform_image.
+ */
+static Image downscale_source(const Image& image, const GeneratedImage::Options& options) {
+  if (!options.downscale_sources || options.width <= 0 || options.height <= 0) return image;
+  int iw = image.GetWidth(), ih = image.GetHeight();
+  if (iw <= 0 || ih <= 0) return image;
+  int w = options.width, h = options.height;
+  if (options.preserve_aspect == ASPECT_FIT ||
+      (options.preserve_aspect == ASPECT_BORDER && (w < h * 3) && (h < w * 3))) {
+    if (iw * h > ih * w) { // too much height requested
+      h = max(1, w * ih / iw);
+    } else {
+      w = max(1, h * iw / ih);
+    }
+  }
+  if (w >= iw && h >= ih) return image; // never make images larger
+  return resample(image, w, h);
+}
+
+/// Give images that are combined the same size
+/** With options.downscale_sources only images loaded from files are scaled down,
+ *  others (such as rotated, cropped, built in and symbol images) keep their natural size.
+ *  Images that are larger than the smallest one are scaled down to its size,
+ *  which is the size they would have had if they had been loaded from a file.
+ */
+static void match_source_sizes(const GeneratedImage::Options& options, std::initializer_list<Image*> images) {
+  if (!options.downscale_sources) return;
+  Image* smallest = nullptr;
+  for (Image* img : images) {
+    if (!smallest || img->GetWidth() * img->GetHeight() < smallest->GetWidth() * smallest->GetHeight()) smallest = img;
+  }
+  int w = smallest->GetWidth(), h = smallest->GetHeight();
+  if (w <= 0 || h <= 0) return;
+  for (Image* img : images) {
+    if (img->GetWidth() != w || img->GetHeight() != h) *img = resample(*img, w, h);
+  }
+}
+
+/// Load an image from a file, through the decoded_image_cache
+/** If downscale_source will scale the image down, a smaller version of the image that is still large enough is good enough. */
+static Image load_source(Package& package, const String& filename, const GeneratedImage::Options& options) {
+  bool smaller_ok = options.downscale_sources && options.width > 0 && options.height > 0;
+  return decoded_image_cache.get(package, filename, smaller_ok ? options.width : 0, smaller_ok ? options.height : 0);
+}
+
 // ----------------------------------------------------------------------------- : BlankImage
 
 Image BlankImage::generate(const Options& opt) const {
@@ -97,8 +164,9 @@ bool BlankImage::operator == (const GeneratedImage& that) const {
 // ----------------------------------------------------------------------------- : LinearBlendImage
 
 Image LinearBlendImage::generate(const Options& opt) const {
-  Image img = image1->generate(opt);
-  linear_blend(img, image2->generate(opt), x1, y1, x2, y2);
+  Image img = image1->generate(opt), img2 = image2->generate(opt);
+  match_source_sizes(opt, {&img, &img2});
+  linear_blend(img, img2, x1, y1, x2, y2);
   return img;
 }
 ImageCombine LinearBlendImage::combine() const {
@@ -111,12 +179,23 @@ bool LinearBlendImage::operator == (const GeneratedImage& that) const {
                && x1 == that2->x1 && y1 == that2->y1
                && x2 == that2->x2 && y2 == that2->y2;
 }
+size_t LinearBlendImage::hash() const {
+  size_t h = GeneratedImage::hash();
+  h = hash_combine(h, image1->hash());
+  h = hash_combine(h, image2->hash());
+  h = hash_combine(h, x1);
+  h = hash_combine(h, y1);
+  h = hash_combine(h, x2);
+  h = hash_combine(h, y2);
+  return h;
+}
 
 // ----------------------------------------------------------------------------- : MaskedBlendImage
 
 Image MaskedBlendImage::generate(const Options& opt) const {
-  Image img = light->generate(opt);
-  mask_blend(img, dark->generate(opt), mask->generate(opt));
+  Image img = light->generate(opt), img_dark = dark->generate(opt), img_mask = mask->generate(opt);
+  match_source_sizes(opt, {&img, &img_dark, &img_mask});
+  mask_blend(img, img_dark, img_mask);
   return img;
 }
 ImageCombine MaskedBlendImage::combine() const {
@@ -128,12 +207,20 @@ bool MaskedBlendImage::operator == (const GeneratedImage& that) const {
                && *dark  == *that2->dark
                && *mask  == *that2->mask;
 }
+size_t MaskedBlendImage::hash() const {
+  size_t h = GeneratedImage::hash();
+  h = hash_combine(h, light->hash());
+  h = hash_combine(h, dark->hash());
+  h = hash_combine(h, mask->hash());
+  return h;
+}
 
 // ----------------------------------------------------------------------------- : CombineBlendImage
 
 Image CombineBlendImage::generate(const Options& opt) const {
-  Image img = image1->generate(opt);
-  combine_image(img, image2->generate(opt), image_combine);
+  Image img = image1->generate(opt), img2 = image2->generate(opt);
+  match_source_sizes(opt, {&img, &img2});
+  combine_image(img, img2, image_combine);
   return img;
 }
 ImageCombine CombineBlendImage::combine() const {
@@ -145,12 +232,20 @@ bool CombineBlendImage::operator == (const GeneratedImage& that) const {
                && *image2 == *that2->image2
                && image_combine == that2->image_combine;
 }
+size_t CombineBlendImage::hash() const {
+  size_t h = GeneratedImage::hash();
+  h = hash_combine(h, image1->hash());
+  h = hash_combine(h, image2->hash());
+  h = hash_combine(h, (int)image_combine);
+  return h;
+}
 
 // ----------------------------------------------------------------------------- : SetMaskImage
 
 Image SetMaskImage::generate(const Options& opt) const {
-  Image img = image->generate(opt);
-  set_alpha(img, mask->generate(opt));
+  Image img = image->generate(opt), img_mask = mask->generate(opt);
+  match_source_sizes(opt, {&img, &img_mask});
+  set_alpha(img, img_mask);
   return img;
 }
 bool SetMaskImage::operator == (const GeneratedImage& that) const {
@@ -158,6 +253,11 @@ bool SetMaskImage::operator == (const GeneratedImage& that) const {
   return that2 && *image == *that2->image
                && *mask  == *that2->mask;
 }
+size_t SetMaskImage::hash() const {
+  size_t h = SimpleFilterImage::hash();
+  h = hash_combine(h, mask->hash());
+  return h;
+}
 
 Image SetAlphaImage::generate(const Options& opt) const {
   Image img = image->generate(opt);
@@ -169,6 +269,11 @@ bool SetAlphaImage::operator == (const GeneratedImage& that) const {
   return that2 && *image == *that2->image
                && alpha  == that2->alpha;
 }
+size_t SetAlphaImage::hash() const {
+  size_t h = SimpleFilterImage::hash();
+  h = hash_combine(h, alpha);
+  return h;
+}
 
 // ----------------------------------------------------------------------------- : SetCombineImage
 
@@ -183,6 +288,11 @@ bool SetCombineImage::operator == (const GeneratedImage& that) const {
   return that2 && *image == *that2->image
                && image_combine == that2->image_combine;
 }
+size_t SetCombineImage::hash() const {
+  size_t h = SimpleFilterImage::hash();
+  h = hash_combine(h, (int)image_combine);
+  return h;
+}
 
 // ----------------------------------------------------------------------------- : SaturateImage
 
@@ -196,6 +306,11 @@ bool SaturateImage::operator == (const GeneratedImage& that) const {
   return that2 && *image == *that2->image
                && amount == that2->amount;
 }
+size_t SaturateImage::hash() const {
+  size_t h = SimpleFilterImage::hash();
+  h = hash_combine(h, amount);
+  return h;
+}
 
 // ----------------------------------------------------------------------------- : InvertImage
 
@@ -221,6 +336,11 @@ bool RecolorImage::operator == (const GeneratedImage& that) const {
   return that2 && *image == *that2->image
                && color == that2->color;
 }
+size_t RecolorImage::hash() const {
+  size_t h = SimpleFilterImage::hash();
+  h = hash_combine(h, color);
+  return h;
+}
 
 Image RecolorImage2::generate(const Options& opt) const {
   Image img = image->generate(opt);
@@ -235,6 +355,14 @@ bool RecolorImage2::operator == (const GeneratedImage& that) const {
                && blue == that2->blue
                && white == that2->white;
 }
+size_t RecolorImage2::hash() const {
+  size_t h = SimpleFilterImage::hash();
+  h = hash_combine(h, red);
+  h = hash_combine(h, green);
+  h = hash_combine(h, blue);
+  h = hash_combine(h, white);
+  return h;
+}
 
 // ----------------------------------------------------------------------------- : FlipImage
 
@@ -257,7 +385,9 @@ bool FlipImageVertical::operator == (const GeneratedImage& that) const {
 }
 
 Image RotateImage::generate(const Options& opt) const {
-  Image img = image->generate(opt);
+  Options sub_opt(opt);
+  sub_opt.downscale_sources = false; // the size of the input is not the size of the result
+  Image img = image->generate(sub_opt);
   return rotate_image(img,angle);
 }
 bool RotateImage::operator == (const GeneratedImage& that) const {
@@ -265,6 +395,11 @@ bool RotateImage::operator == (const GeneratedImage& that) const {
   return that2 && *image == *that2->image
                && angle == that2->angle;
 }
+size_t RotateImage::hash() const {
+  size_t h = SimpleFilterImage::hash();
+  h = hash_combine(h, angle);
+  return h;
+}
 
 // ----------------------------------------------------------------------------- : EnlargeImage
 
@@ -276,6 +411,7 @@ Image EnlargeImage::generate(const Options& opt) const {
     , opt.package
     , opt.local_package
     , opt.preserve_aspect);
+  sub_opt.downscale_sources = opt.downscale_sources;
   Image img = image->generate(sub_opt);
   // size of generated image
   int w  = img.GetWidth(),  h = img.GetHeight();  // original image size
@@ -303,11 +439,18 @@ bool EnlargeImage::operator == (const GeneratedImage& that) const {
   return that2 && *image      == *that2->image
                && border_size == that2->border_size;
 }
+size_t EnlargeImage::hash() const {
+  size_t h = SimpleFilterImage::hash();
+  h = hash_combine(h, border_size);
+  return h;
+}
 
 // ----------------------------------------------------------------------------- : CropImage
 
 Image CropImage::generate(const Options& opt) const {
-  return image->generate(opt).Size(wxSize((int)width, (int)height), wxPoint(-(int)offset_x, -(int)offset_y));
+  Options sub_opt(opt);
+  sub_opt.downscale_sources = false; // the crop rectangle is in pixels of the input
+  return image->generate(sub_opt).Size(wxSize((int)width, (int)height), wxPoint(-(int)offset_x, -(int)offset_y));
 }
 bool CropImage::operator == (const GeneratedImage& that) const {
   const CropImage* that2 = dynamic_cast<const CropImage*>(&that);
@@ -315,6 +458,14 @@ bool CropImage::operator == (const GeneratedImage& that) const {
                && width    == that2->width    && height   == that2->height
                && offset_x == that2->offset_x && offset_y == that2->offset_y;
 }
+size_t CropImage::hash() const {
+  size_t h = SimpleFilterImage::hash();
+  h = hash_combine(h, width);
+  h = hash_combine(h, height);
+  h = hash_combine(h, offset_x);
+  h = hash_combine(h, offset_y);
+  return h;
+}
 
 // ----------------------------------------------------------------------------- : DropShadowImage
 
@@ -407,18 +558,24 @@ bool DropShadowImage::operator == (const GeneratedImage& that) const {
                && shadow_alpha == that2->shadow_alpha && shadow_blur_radius == that2->shadow_blur_radius
                && shadow_color == that2->shadow_color;
 }
+size_t DropShadowImage::hash() const {
+  size_t h = SimpleFilterImage::hash();
+  h = hash_combine(h, offset_x);
+  h = hash_combine(h, offset_y);
+  h = hash_combine(h, shadow_alpha);
+  h = hash_combine(h, shadow_blur_radius);
+  h = hash_combine(h, shadow_color);
+  return h;
+}
 
 // ----------------------------------------------------------------------------- : PackagedImage
 
 Image PackagedImage::generate(const Options& opt) const {
-  // TODO : use opt.width and opt.height?
   // open file from package
   if (!opt.package) throw ScriptError(_("Can only load images in a context where an image is expected"));
-  auto file_stream = opt.package->openIn(filename);
-  Image img;
-  if (image_load_file(img, *file_stream)) {
-    if (img.HasMask()) img.InitAlpha(); // we can't handle masks
-    return img;
+  Image img = load_source(*opt.package, filename, opt);
+  if (img.Ok()) {
+    return downscale_source(img, opt);
   } else {
     throw ScriptError(_("Unable to load image '") + filename + _("' from '" + opt.package->name() + _("'")));
   }
@@ -427,6 +584,11 @@ bool PackagedImage::operator == (const GeneratedImage& that) const {
   const PackagedImage* that2 = dynamic_cast<const PackagedImage*>(&that);
   return that2 && filename == that2->filename;
 }
+size_t PackagedImage::hash() const {
+  size_t h = GeneratedImage::hash();
+  h = hash_combine(h, filename);
+  return h;
+}
 
 // ----------------------------------------------------------------------------- : BuiltInImage
 
@@ -442,6 +604,11 @@ bool BuiltInImage::operator == (const GeneratedImage& that) const {
   const BuiltInImage* that2 = dynamic_cast<const BuiltInImage*>(&that);
   return that2 && name == that2->name;
 }
+size_t BuiltInImage::hash() const {
+  size_t h = GeneratedImage::hash();
+  h = hash_combine(h, name);
+  return h;
+}
 
 // ----------------------------------------------------------------------------- : SymbolToImage
 
@@ -478,6 +645,13 @@ bool SymbolToImage::operator == (const GeneratedImage& that) const {
                    *variation == *that2->variation // custom variation
                   );
 }
+size_t SymbolToImage::hash() const {
+  size_t h = GeneratedImage::hash();
+  h = hash_combine(h, is_local);
+  h = hash_combine(h, filename.toStringForKey());
+  h = hash_combine(h, (size_t)age.get()); // not the variation, equal variations can be different objects
+  return h;
+}
 
 // ----------------------------------------------------------------------------- : ImageValueToImage
 
@@ -487,20 +661,24 @@ ImageValueToImage::ImageValueToImage(const LocalFileName& filename, Age age)
 ImageValueToImage::~ImageValueToImage() {}
 
 Image ImageValueToImage::generate(const Options& opt) const {
-  // TODO : use opt.width and opt.height?
   if (!opt.local_package) throw ScriptError(_("Can only load images in a context where an image is expected"));
   Image image;
   if (!filename.empty()) {
-    auto image_file_stream = opt.local_package->openIn(filename);
-    image_load_file(image, *image_file_stream);
+    image = load_source(*opt.local_package, filename.toStringForKey(), opt);
   }
   if (!image.Ok()) {
     image = Image(max(1,opt.width), max(1,opt.height));
   }
-  return image;
+  return downscale_source(image, opt);
 }
 bool ImageValueToImage::operator == (const GeneratedImage& that) const {
   const ImageValueToImage* that2 = dynamic_cast<const ImageValueToImage*>(&that);
   return that2 && filename == that2->filename
                && age      == that2->age;
 }
+size_t ImageValueToImage::hash() const {
+  size_t h = GeneratedImage::hash();
+  h = hash_combine(h, filename.toStringForKey());
+  h = hash_combine(h, (size_t)age.get());
+  return h;
+}
@@ -29,7 +29,7 @@ public:
   struct Options {
     Options(int width = 0, int height = 0, Package* package = nullptr, Package* local_package = nullptr, PreserveAspect preserve_aspect = ASPECT_STRETCH, bool saturate = false)
       : width(width), height(height), zoom(1.0), angle(0)
-      , preserve_aspect(preserve_aspect), saturate(saturate)
+      , preserve_aspect(preserve_aspect), saturate(saturate), downscale_sources(false)
       , package(package), local_package(local_package)
     {}
     
@@ -39,19 +39,27 @@ public:
     Radians        angle;           ///< Angle to rotate image by afterwards
     PreserveAspect preserve_aspect;
     bool           saturate;
+    bool           downscale_sources; ///< May images loaded from files be scaled down to width*height before they are used?
+                    ///< Only set this if the result is conformed to the options afterwards
     Package* package;       ///< Package to load images from
     Package* local_package; ///< Package to load symbols and ImageValue images from
   };
   
   /// Generate the image, and conform to the options
+  /** Source images are scaled down to the requested size first, so a small version of a
+   *  large image is never generated at full size. */
   Image generateConform(const Options&) const;
   /// Generate the image
+  /** If options.downscale_sources is set, source images can be made smaller than their natural size,
+   *  generators that depend on the pixel size of their input should clear it for their inputs. */
   virtual Image generate(const Options&) const = 0;
   /// How must the image be combined with the background?
   virtual ImageCombine combine() const { return COMBINE_DEFAULT; }
   /// Equality should mean that every pixel in the generated images is the same if the same options are used
   virtual bool operator == (const GeneratedImage& that) const = 0;
   inline  bool operator != (const GeneratedImage& that) const { return !(*this == that); }
+  /// Hash of the structure of the image, images that are equal must have the same hash
+  virtual size_t hash() const;
   
   /// Can this image be generated safely from another thread?
   virtual bool threadSafe() const { return true; }
@@ -78,6 +86,7 @@ public:
   {}
   ImageCombine combine() const override { return image->combine(); }
   bool local() const override { return image->local(); }
+  size_t hash() const override;
 protected:
   GeneratedImageP image;
 };
@@ -108,6 +117,7 @@ public:
   Image generate(const Options& opt) const override;
   ImageCombine combine() const override;
   bool operator == (const GeneratedImage& that) const override;
+  size_t hash() const override;
   bool local() const override { return image1->local() && image2->local(); }
 private:
   GeneratedImageP image1, image2;
@@ -125,6 +135,7 @@ public:
   Image generate(const Options& opt) const override;
   ImageCombine combine() const override;
   bool operator == (const GeneratedImage& that) const override;
+  size_t hash() const override;
   bool local() const override { return light->local() && dark->local() && mask->local(); }
 private:
   GeneratedImageP light, dark, mask;
@@ -141,6 +152,7 @@ public:
   Image generate(const Options& opt) const override;
   ImageCombine combine() const override;
   bool operator == (const GeneratedImage& that) const override;
+  size_t hash() const override;
   bool local() const override { return image1->local() && image2->local(); }
 private:
   GeneratedImageP image1, image2;
@@ -157,6 +169,7 @@ public:
   {}
   Image generate(const Options& opt) const override;
   bool operator == (const GeneratedImage& that) const override;
+  size_t hash() const override;
 private:
   GeneratedImageP mask;
 };
@@ -169,6 +182,7 @@ public:
   {}
   Image generate(const Options& opt) const override;
   bool operator == (const GeneratedImage& that) const override;
+  size_t hash() const override;
 private:
   double alpha;
 };
@@ -184,6 +198,7 @@ public:
   Image generate(const Options& opt) const override;
   ImageCombine combine() const override;
   bool operator == (const GeneratedImage& that) const override;
+  size_t hash() const override;
 private:
   ImageCombine image_combine;
 };
@@ -198,6 +213,7 @@ public:
   {}
   Image generate(const Options& opt) const override;
   bool operator == (const GeneratedImage& that) const override;
+  size_t hash() const override;
 private:
   double amount;
 };
@@ -224,6 +240,7 @@ public:
   {}
   Image generate(const Options& opt) const override;
   bool operator == (const GeneratedImage& that) const override;
+  size_t hash() const override;
 private:
   Color color;
 };
@@ -235,6 +252,7 @@ public:
   {}
   Image generate(const Options& opt) const override;
   bool operator == (const GeneratedImage& that) const override;
+  size_t hash() const override;
 private:
   Color red,green,blue,white;
 };
@@ -269,6 +287,7 @@ public:
   {}
   Image generate(const Options& opt) const override;
   bool operator == (const GeneratedImage& that) const override;
+  size_t hash() const override;
 private:
   Radians angle;
 };
@@ -283,6 +302,7 @@ public:
   {}
   Image generate(const Options& opt) const override;
   bool operator == (const GeneratedImage& that) const override;
+  size_t hash() const override;
 private:
   double border_size;
 };
@@ -297,6 +317,7 @@ public:
   {}
   Image generate(const Options& opt) const override;
   bool operator == (const GeneratedImage& that) const override;
+  size_t hash() const override;
 private:
   double width, height;
   double offset_x, offset_y;
@@ -313,6 +334,7 @@ public:
   {}
   Image generate(const Options& opt) const override;
   bool operator == (const GeneratedImage& that) const override;
+  size_t hash() const override;
 private:
   double offset_x, offset_y;
   double shadow_alpha;
@@ -330,6 +352,7 @@ public:
   {}
   Image generate(const Options& opt) const override;
   bool operator == (const GeneratedImage& that) const override;
+  size_t hash() const override;
 private:
   String filename;
 };
@@ -344,6 +367,7 @@ public:
   {}
   Image generate(const Options& opt) const override;
   bool operator == (const GeneratedImage& that) const override;
+  size_t hash() const override;
 private:
   String name;
 };
@@ -357,6 +381,7 @@ public:
   ~SymbolToImage();
   Image generate(const Options& opt) const override;
   bool operator == (const GeneratedImage& that) const override;
+  size_t hash() const override;
   bool local() const override { return is_local; }
   
   #ifdef __WXGTK__
@@ -379,6 +404,7 @@ public:
   ~ImageValueToImage();
   Image generate(const Options& opt) const override;
   bool operator == (const GeneratedImage& that) const override;
+  size_t hash() const override;
   bool local() const override { return true; }
 private:
   ImageValueToImage(const ImageValueToImage&); // copy ctor
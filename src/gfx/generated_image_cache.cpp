@@ -0,0 +1,92 @@
+//+----------------------------------------------------------------------------+
+//| Description:  Magic Set Editor - Program to make Magic (tm) cards          |
+//| Copyright:    (C) Twan van Laarhoven and the other MSE developers          |
+//| License:      GNU General Public License 2 or later (see file COPYING)     |
+//+----------------------------------------------------------------------------+
+
+// ----------------------------------------------------------------------------- : Includes
+
+#include <util/prec.hpp>
+#include <gfx/generated_image_cache.hpp>
+#include <data/settings.hpp>
+
+GeneratedImageCache generated_image_cache;
+
+// ----------------------------------------------------------------------------- : Key
+
+GeneratedImageCache::Key::Key(const GeneratedImageP& image, const GeneratedImage::Options& options)
+  : image(image)
+  , width(options.width), height(options.height)
+  , zoom(options.zoom), angle(options.angle)
+  , preserve_aspect(options.preserve_aspect), saturate(options.saturate)
+  , package(options.package), local_package(options.local_package)
+{
+  hash = image->hash();
+  hash = hash * 31 + std::hash<int>()(width);
+  hash = hash * 31 + std::hash<int>()(height);
+  hash = hash * 31 + std::hash<double>()(zoom);
+  hash = hash * 31 + std::hash<double>()(angle);
+  hash = hash * 31 + (size_t)preserve_aspect * 2 + saturate;
+  hash = hash * 31 + std::hash<const void*>()(package);
+  hash = hash * 31 + std::hash<const void*>()(local_package);
+}
+
+bool GeneratedImageCache::Key::operator == (const Key& that) const {
+  return hash == that.hash
+      && width == that.width && height == that.height
+      && zoom == that.zoom && angle == that.angle
+      && preserve_aspect == that.preserve_aspect && saturate == that.saturate
+      && package == that.package && local_package == that.local_package
+      && (image == that.image || *image == *that.image);
+}
+
+// ----------------------------------------------------------------------------- : GeneratedImageCache
+
+GeneratedImageCache::GeneratedImageCache()
+  : hits(0), misses(0), evictions(0)
+  , total_size(0)
+{}
+
+Image GeneratedImageCache::get(const GeneratedImageP& image, const GeneratedImage::Options& options, const Generator& generate) {
+  size_t max_size = (size_t)settings.generated_image_cache_size << 20;
+  if (max_size == 0) return generate(options); // disabled
+  Key key(image, options);
+  auto it = index.find(&key);
+  if (it != index.end()) {
+    // move to front
+    entries.splice(entries.begin(), entries, it->second);
+    const Entry& e = entries.front();
+    options.width  = e.width;
+    options.height = e.height;
+    ++hits;
+    return e.image;
+  }
+  ++misses;
+  Image result = generate(options);
+  if (!result.Ok()) return result;
+  size_t size = (size_t)result.GetWidth() * result.GetHeight() * (result.HasAlpha() ? 4 : 3);
+  entries.push_front(Entry{move(key), result, options.width, options.height, size});
+  index[&entries.front().key] = entries.begin();
+  total_size += size;
+  if (total_size > max_size) evict(max_size);
+  return result;
+}
+
+void GeneratedImageCache::evict(size_t max_size) {
+  // least recently used first
+  for (auto it = entries.end() ; it != entries.begin() && total_size > max_size ; ) {
+    --it;
+    const wxObjectRefData* data = it->image.GetRefData();
+    if (data && data->GetRefCount() > 1) continue; // still used by a viewer
+    total_size -= it->size;
+    index.erase(&it->key);
+    it = entries.erase(it);
+    ++evictions;
+  }
+}
+
+void GeneratedImageCache::clear() {
+  index.clear();
+  entries.clear();
+  total_size = 0;
+}
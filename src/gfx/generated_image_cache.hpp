@@ -0,0 +1,88 @@
+//+----------------------------------------------------------------------------+
+//| Description:  Magic Set Editor - Program to make Magic (tm) cards          |
+//| Copyright:    (C) Twan van Laarhoven and the other MSE developers          |
+//| License:      GNU General Public License 2 or later (see file COPYING)     |
+//+----------------------------------------------------------------------------+
+
+#pragma once
+
+// ----------------------------------------------------------------------------- : Includes
+
+#include <util/prec.hpp>
+#include <gfx/generated_image.hpp>
+#include <list>
+#include <functional>
+
+// ----------------------------------------------------------------------------- : GeneratedImageCache
+
+/// A cache of generated images, shared by all cards and viewers
+/** Images are identified by the structure of their GeneratedImage (operator == and hash) and the options
+ *  they are generated with, so a frame that is used by many cards is only generated once.
+ *
+ *  When the cache is larger than settings.generated_image_cache_size, the least recently used images are removed.
+ *  Images that are still referenced outside the cache are kept, removing those would not free any memory.
+ *
+ *  The cache should only be used from the main thread, because the reference counts of images are not thread safe.
+ */
+class GeneratedImageCache {
+public:
+  GeneratedImageCache();
+
+  typedef function<Image (const GeneratedImage::Options&)> Generator;
+
+  /// Find an image in the cache, or generate it with generate(options) and store it
+  /** Like ScriptableImage::generate, sets options.width and options.height to the size of the image.
+   *  The result is shared, it must not be modified in place.
+   */
+  Image get(const GeneratedImageP& image, const GeneratedImage::Options& options, const Generator& generate);
+  /// Remove all images, for instance because packages were reloaded
+  void clear();
+
+  /// Number of cached images
+  inline size_t count() const { return entries.size(); }
+  /// Memory used by the cached images in bytes
+  inline size_t size() const { return total_size; }
+
+  size_t hits;      ///< Number of images found in the cache
+  size_t misses;    ///< Number of images that had to be generated
+  size_t evictions; ///< Number of images removed to limit the size
+
+private:
+  /// An image and the options it was generated with
+  struct Key {
+    GeneratedImageP image;
+    int             width, height;
+    double          zoom;
+    Radians         angle;
+    PreserveAspect  preserve_aspect;
+    bool            saturate;
+    Package*        package;
+    Package*        local_package;
+    size_t          hash;
+
+    Key(const GeneratedImageP& image, const GeneratedImage::Options& options);
+    bool operator == (const Key& that) const;
+  };
+  struct Entry {
+    Key    key;
+    Image  image;
+    int    width, height; ///< Size set by conforming the image to the options
+    size_t size;          ///< Memory used by the image
+  };
+  struct KeyHash {
+    inline size_t operator () (const Key* k) const { return k->hash; }
+  };
+  struct KeyEqual {
+    inline bool operator () (const Key* a, const Key* b) const { return *a == *b; }
+  };
+
+  list<Entry> entries; ///< Most recently used first
+  unordered_map<const Key*, list<Entry>::iterator, KeyHash, KeyEqual> index;
+  size_t total_size;
+
+  /// Remove unreferenced images until the cache is at most max_size bytes
+  void evict(size_t max_size);
+};
+
+/// The global generated image cache
+extern GeneratedImageCache generated_image_cache;
@@ -180,11 +180,14 @@ public:
   inline bool hasSize(const wxSize& compare_size) const { return size == compare_size; }
   /// Is the mask loaded?
   inline bool isLoaded() const { return alpha; }
+  /// Hash of the size and contents of the mask, 0 if it is not loaded
+  size_t hash() const;
   
 private:
   wxSize size; ///< Size of the mask
   Byte* alpha; ///< Data of alpha mask
   mutable int *lefts, *rights; ///< Row sizes
+  mutable size_t content_hash; ///< Hash of the contents, 0 if not computed yet
   
   /// Compute lefts and rights from alpha
   void loadRowSizes() const;
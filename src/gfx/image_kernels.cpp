@@ -0,0 +1,569 @@
+//+----------------------------------------------------------------------------+
+//| Description:  Magic Set Editor - Program to make Magic (tm) cards          |
+//| Copyright:    (C) Twan van Laarhoven and the other MSE developers          |
+//| License:      GNU General Public License 2 or later (see file COPYING)     |
+//+----------------------------------------------------------------------------+
+
+// ----------------------------------------------------------------------------- : Includes
+
+#include <util/prec.hpp>
+#include <gfx/image_kernels.hpp>
+#include <random>
+#include <chrono>
+#include <functional>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+  #define USE_X86_KERNELS 1
+  #include <immintrin.h>
+  #ifdef _MSC_VER
+    #include <intrin.h>
+  #endif
+#else
+  #define USE_X86_KERNELS 0
+#endif
+
+// The vector kernels are compiled for their instruction set, independent of the compiler flags.
+// MSVC doesn't need this.
+#if defined(__GNUC__) || defined(__clang__)
+  #define TARGET_SSE2 __attribute__((target("sse2")))
+  #define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+  #define TARGET_SSE2
+  #define TARGET_AVX2
+#endif
+
+// ----------------------------------------------------------------------------- : Scalar
+
+static void mask_blend_scalar(Byte* a, const Byte* b, const Byte* mask, size_t n) {
+  for (size_t i = 0 ; i < n ; ++i) {
+    a[i] = (a[i] * mask[i] + b[i] * (255 - mask[i])) / 255;
+  }
+}
+
+static void fixed_blend_scalar(Byte* a, const Byte* b, const int* mult, size_t n) {
+  for (size_t i = 0 ; i < n ; ++i) {
+    a[i] = a[i] + mult[i] * (b[i] - a[i]) / 65536;
+  }
+}
+
+static void multiply_scalar(Byte* a, const Byte* f, size_t n) {
+  for (size_t i = 0 ; i < n ; ++i) {
+    a[i] = (a[i] * f[i]) / 255;
+  }
+}
+
+static void multiply_const_scalar(Byte* a, Byte f, size_t n) {
+  for (size_t i = 0 ; i < n ; ++i) {
+    a[i] = (a[i] * f) / 255;
+  }
+}
+
+static void weighted_sum_scalar(Byte* out, const Byte* const* rows, const UInt* weights, size_t count, int shift, size_t n) {
+  for (size_t i = 0 ; i < n ; ++i) {
+    UInt total = 0;
+    for (size_t k = 0 ; k < count ; ++k) {
+      total += rows[k][i] * weights[k];
+    }
+    out[i] = total >> shift;
+  }
+}
+
+static bool combine_scalar(ImageCombine, Byte*, const Byte*, size_t) {
+  return false; // the caller uses the combining functions from combine_image.cpp
+}
+
+static const ImageKernels scalar_kernels = {
+  SIMD_SCALAR, mask_blend_scalar, fixed_blend_scalar, multiply_scalar, multiply_const_scalar, weighted_sum_scalar, combine_scalar
+};
+
+#if USE_X86_KERNELS
+
+// Combine modes with a vector kernel, the others need a division or 32 bit products
+#define FOR_EACH_VECTOR_COMBINE(X) \
+  X(COMBINE_ADD); X(COMBINE_SUBTRACT); X(COMBINE_STAMP); X(COMBINE_DIFFERENCE); X(COMBINE_NEGATION); \
+  X(COMBINE_MULTIPLY); X(COMBINE_DARKEN); X(COMBINE_LIGHTEN); X(COMBINE_SCREEN); X(COMBINE_OVERLAY); \
+  X(COMBINE_HARD_LIGHT); X(COMBINE_SOFT_LIGHT); X(COMBINE_AND); X(COMBINE_OR); X(COMBINE_XOR); \
+  X(COMBINE_SYMMETRIC_OVERLAY)
+
+// ----------------------------------------------------------------------------- : SSE2
+
+// x / 255 for 16 bit lanes with 0 <= x <= 255*255
+TARGET_SSE2 static inline __m128i div255_sse2(__m128i x) {
+  return _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(x, _mm_set1_epi16(1)), _mm_srli_epi16(x, 8)), 8);
+}
+
+// low 32 bits of the product of 32 bit lanes (SSE2 has no _mm_mullo_epi32)
+TARGET_SSE2 static inline __m128i mullo32_sse2(__m128i a, __m128i b) {
+  __m128i even = _mm_mul_epu32(a, b);
+  __m128i odd  = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+  return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0,0,2,0)), _mm_shuffle_epi32(odd, _MM_SHUFFLE(0,0,2,0)));
+}
+
+TARGET_SSE2 static void mask_blend_sse2(Byte* a, const Byte* b, const Byte* mask, size_t n) {
+  const __m128i zero = _mm_setzero_si128(), c255 = _mm_set1_epi16(255);
+  size_t i = 0;
+  for ( ; i + 16 <= n ; i += 16) {
+    __m128i va = _mm_loadu_si128((const __m128i*)(a + i));
+    __m128i vb = _mm_loadu_si128((const __m128i*)(b + i));
+    __m128i vm = _mm_loadu_si128((const __m128i*)(mask + i));
+    __m128i ml = _mm_unpacklo_epi8(vm, zero), mh = _mm_unpackhi_epi8(vm, zero);
+    __m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(va, zero), ml),
+                               _mm_mullo_epi16(_mm_unpacklo_epi8(vb, zero), _mm_sub_epi16(c255, ml)));
+    __m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(va, zero), mh),
+                               _mm_mullo_epi16(_mm_unpackhi_epi8(vb, zero), _mm_sub_epi16(c255, mh)));
+    _mm_storeu_si128((__m128i*)(a + i), _mm_packus_epi16(div255_sse2(lo), div255_sse2(hi)));
+  }
+  mask_blend_scalar(a + i, b + i, mask + i, n - i);
+}
+
+TARGET_SSE2 static void fixed_blend_sse2(Byte* a, const Byte* b, const int* mult, size_t n) {
+  const __m128i zero = _mm_setzero_si128(), round = _mm_set1_epi32(0xFFFF);
+  size_t i = 0;
+  for ( ; i + 8 <= n ; i += 8) {
+    __m128i va = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(a + i)), zero);
+    __m128i vb = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(b + i)), zero);
+    __m128i d  = _mm_sub_epi16(vb, va);
+    // sign extend the differences to 32 bits
+    __m128i d_lo = _mm_srai_epi32(_mm_unpacklo_epi16(d, d), 16);
+    __m128i d_hi = _mm_srai_epi32(_mm_unpackhi_epi16(d, d), 16);
+    __m128i p_lo = mullo32_sse2(_mm_loadu_si128((const __m128i*)(mult + i)),     d_lo);
+    __m128i p_hi = mullo32_sse2(_mm_loadu_si128((const __m128i*)(mult + i + 4)), d_hi);
+    // divide by 65536, rounding towards zero like C++ does
+    p_lo = _mm_srai_epi32(_mm_add_epi32(p_lo, _mm_and_si128(_mm_srai_epi32(p_lo, 31), round)), 16);
+    p_hi = _mm_srai_epi32(_mm_add_epi32(p_hi, _mm_and_si128(_mm_srai_epi32(p_hi, 31), round)), 16);
+    __m128i r = _mm_add_epi16(va, _mm_packs_epi32(p_lo, p_hi));
+    _mm_storel_epi64((__m128i*)(a + i), _mm_packus_epi16(r, r));
+  }
+  fixed_blend_scalar(a + i, b + i, mult + i, n - i);
+}
+
+TARGET_SSE2 static void multiply_sse2(Byte* a, const Byte* f, size_t n) {
+  const __m128i zero = _mm_setzero_si128();
+  size_t i = 0;
+  for ( ; i + 16 <= n ; i += 16) {
+    __m128i va = _mm_loadu_si128((const __m128i*)(a + i));
+    __m128i vf = _mm_loadu_si128((const __m128i*)(f + i));
+    __m128i lo = _mm_mullo_epi16(_mm_unpacklo_epi8(va, zero), _mm_unpacklo_epi8(vf, zero));
+    __m128i hi = _mm_mullo_epi16(_mm_unpackhi_epi8(va, zero), _mm_unpackhi_epi8(vf, zero));
+    _mm_storeu_si128((__m128i*)(a + i), _mm_packus_epi16(div255_sse2(lo), div255_sse2(hi)));
+  }
+  multiply_scalar(a + i, f + i, n - i);
+}
+
+TARGET_SSE2 static void multiply_const_sse2(Byte* a, Byte f, size_t n) {
+  const __m128i zero = _mm_setzero_si128(), vf = _mm_set1_epi16(f);
+  size_t i = 0;
+  for ( ; i + 16 <= n ; i += 16) {
+    __m128i va = _mm_loadu_si128((const __m128i*)(a + i));
+    __m128i lo = _mm_mullo_epi16(_mm_unpacklo_epi8(va, zero), vf);
+    __m128i hi = _mm_mullo_epi16(_mm_unpackhi_epi8(va, zero), vf);
+    _mm_storeu_si128((__m128i*)(a + i), _mm_packus_epi16(div255_sse2(lo), div255_sse2(hi)));
+  }
+  multiply_const_scalar(a + i, f, n - i);
+}
+
+TARGET_SSE2 static void weighted_sum_sse2(Byte* out, const Byte* const* rows, const UInt* weights, size_t count, int shift, size_t n) {
+  const __m128i zero = _mm_setzero_si128(), vshift = _mm_cvtsi32_si128(shift);
+  size_t i = 0;
+  for ( ; i + 16 <= n ; i += 16) {
+    __m128i t0 = zero, t1 = zero, t2 = zero, t3 = zero;
+    for (size_t k = 0 ; k < count ; ++k) {
+      __m128i v  = _mm_loadu_si128((const __m128i*)(rows[k] + i));
+      __m128i w  = _mm_set1_epi16((short)weights[k]);
+      __m128i lo = _mm_unpacklo_epi8(v, zero), hi = _mm_unpackhi_epi8(v, zero);
+      // 32 bit products, from the low and high halves of 16 bit products
+      __m128i lo_l = _mm_mullo_epi16(lo, w), lo_h = _mm_mulhi_epu16(lo, w);
+      __m128i hi_l = _mm_mullo_epi16(hi, w), hi_h = _mm_mulhi_epu16(hi, w);
+      t0 = _mm_add_epi32(t0, _mm_unpacklo_epi16(lo_l, lo_h));
+      t1 = _mm_add_epi32(t1, _mm_unpackhi_epi16(lo_l, lo_h));
+      t2 = _mm_add_epi32(t2, _mm_unpacklo_epi16(hi_l, hi_h));
+      t3 = _mm_add_epi32(t3, _mm_unpackhi_epi16(hi_l, hi_h));
+    }
+    t0 = _mm_srl_epi32(t0, vshift);
+    t1 = _mm_srl_epi32(t1, vshift);
+    t2 = _mm_srl_epi32(t2, vshift);
+    t3 = _mm_srl_epi32(t3, vshift);
+    _mm_storeu_si128((__m128i*)(out + i), _mm_packus_epi16(_mm_packs_epi32(t0, t1), _mm_packs_epi32(t2, t3)));
+  }
+  for ( ; i < n ; ++i) {
+    UInt total = 0;
+    for (size_t k = 0 ; k < count ; ++k) {
+      total += rows[k][i] * weights[k];
+    }
+    out[i] = total >> shift;
+  }
+}
+
+// overlay for 16 bit lanes, the condition is c < 128
+TARGET_SSE2 static inline __m128i overlay_sse2(__m128i a, __m128i b, __m128i c) {
+  const __m128i c255 = _mm_set1_epi16(255);
+  __m128i dark  = _mm_srli_epi16(_mm_mullo_epi16(a, b), 7);
+  __m128i light = _mm_sub_epi16(c255, _mm_srli_epi16(_mm_mullo_epi16(_mm_sub_epi16(c255, a), _mm_sub_epi16(c255, b)), 7));
+  __m128i is_dark = _mm_cmplt_epi16(c, _mm_set1_epi16(128));
+  return _mm_or_si128(_mm_and_si128(is_dark, dark), _mm_andnot_si128(is_dark, light));
+}
+
+// combine two vectors of 16 bit lanes, results outside [0,255] are clipped by the caller
+template <ImageCombine combine>
+TARGET_SSE2 static inline __m128i combine16_sse2(__m128i a, __m128i b) {
+  const __m128i c255 = _mm_set1_epi16(255);
+  switch (combine) {
+    case COMBINE_ADD:        return _mm_add_epi16(a, b);
+    case COMBINE_SUBTRACT:   return _mm_sub_epi16(a, b);
+    case COMBINE_STAMP:      return _mm_add_epi16(_mm_sub_epi16(a, _mm_add_epi16(b, b)), _mm_set1_epi16(256));
+    case COMBINE_DIFFERENCE: return _mm_max_epi16(_mm_sub_epi16(a, b), _mm_sub_epi16(b, a));
+    case COMBINE_NEGATION: {
+      __m128i sum = _mm_add_epi16(a, b);
+      return _mm_min_epi16(sum, _mm_sub_epi16(_mm_set1_epi16(510), sum));
+    }
+    case COMBINE_MULTIPLY:   return div255_sse2(_mm_mullo_epi16(a, b));
+    case COMBINE_DARKEN:     return _mm_min_epi16(a, b);
+    case COMBINE_LIGHTEN:    return _mm_max_epi16(a, b);
+    case COMBINE_SCREEN:     return _mm_sub_epi16(c255, div255_sse2(_mm_mullo_epi16(_mm_sub_epi16(c255, a), _mm_sub_epi16(c255, b))));
+    case COMBINE_OVERLAY:    return overlay_sse2(a, b, a);
+    case COMBINE_HARD_LIGHT: return overlay_sse2(a, b, b);
+    case COMBINE_SOFT_LIGHT: return b;
+    case COMBINE_AND:        return _mm_and_si128(a, b);
+    case COMBINE_OR:         return _mm_or_si128(a, b);
+    case COMBINE_XOR:        return _mm_xor_si128(a, b);
+    case COMBINE_SYMMETRIC_OVERLAY: // overlay(b,a) == hard_light(a,b)
+      return _mm_srli_epi16(_mm_add_epi16(overlay_sse2(a, b, a), overlay_sse2(a, b, b)), 1);
+    default:                 return a;
+  }
+}
+
+template <ImageCombine combine>
+TARGET_SSE2 static void combine_loop_sse2(Byte* a, const Byte* b, size_t n) {
+  const __m128i zero = _mm_setzero_si128();
+  size_t i = 0;
+  for ( ; i + 16 <= n ; i += 16) {
+    __m128i va = _mm_loadu_si128((const __m128i*)(a + i));
+    __m128i vb = _mm_loadu_si128((const __m128i*)(b + i));
+    __m128i lo = combine16_sse2<combine>(_mm_unpacklo_epi8(va, zero), _mm_unpacklo_epi8(vb, zero));
+    __m128i hi = combine16_sse2<combine>(_mm_unpackhi_epi8(va, zero), _mm_unpackhi_epi8(vb, zero));
+    _mm_storeu_si128((__m128i*)(a + i), _mm_packus_epi16(lo, hi));
+  }
+  combine_bytes_scalar(combine, a + i, b + i, n - i);
+}
+
+TARGET_SSE2 static bool combine_sse2(ImageCombine combine, Byte* a, const Byte* b, size_t n) {
+  switch (combine) {
+    #define DISPATCH(comb) case comb: combine_loop_sse2<comb>(a, b, n); return true
+    FOR_EACH_VECTOR_COMBINE(DISPATCH);
+    #undef DISPATCH
+    default: return false;
+  }
+}
+
+static const ImageKernels sse2_kernels = {
+  SIMD_SSE2, mask_blend_sse2, fixed_blend_sse2, multiply_sse2, multiply_const_sse2, weighted_sum_sse2, combine_sse2
+};
+
+// ----------------------------------------------------------------------------- : AVX2
+
+// The AVX2 kernels work on 16 bytes at a time, widened to 16 bit lanes
+
+TARGET_AVX2 static inline __m256i load16_avx2(const Byte* p) {
+  return _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)p));
+}
+
+// store 16 bit lanes as bytes, with unsigned saturation
+TARGET_AVX2 static inline void store16_avx2(Byte* p, __m256i x) {
+  _mm_storeu_si128((__m128i*)p, _mm_packus_epi16(_mm256_castsi256_si128(x), _mm256_extracti128_si256(x, 1)));
+}
+
+TARGET_AVX2 static inline __m256i div255_avx2(__m256i x) {
+  return _mm256_srli_epi16(_mm256_add_epi16(_mm256_add_epi16(x, _mm256_set1_epi16(1)), _mm256_srli_epi16(x, 8)), 8);
+}
+
+TARGET_AVX2 static void mask_blend_avx2(Byte* a, const Byte* b, const Byte* mask, size_t n) {
+  const __m256i c255 = _mm256_set1_epi16(255);
+  size_t i = 0;
+  for ( ; i + 16 <= n ; i += 16) {
+    __m256i vm = load16_avx2(mask + i);
+    __m256i x  = _mm256_add_epi16(_mm256_mullo_epi16(load16_avx2(a + i), vm),
+                                  _mm256_mullo_epi16(load16_avx2(b + i), _mm256_sub_epi16(c255, vm)));
+    store16_avx2(a + i, div255_avx2(x));
+  }
+  mask_blend_scalar(a + i, b + i, mask + i, n - i);
+}
+
+TARGET_AVX2 static void fixed_blend_avx2(Byte* a, const Byte* b, const int* mult, size_t n) {
+  const __m256i round = _mm256_set1_epi32(0xFFFF);
+  size_t i = 0;
+  for ( ; i + 8 <= n ; i += 8) {
+    __m256i va = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(a + i)));
+    __m256i vb = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(b + i)));
+    __m256i p  = _mm256_mullo_epi32(_mm256_loadu_si256((const __m256i*)(mult + i)), _mm256_sub_epi32(vb, va));
+    // divide by 65536, rounding towards zero like C++ does
+    p = _mm256_srai_epi32(_mm256_add_epi32(p, _mm256_and_si256(_mm256_srai_epi32(p, 31), round)), 16);
+    __m256i r = _mm256_add_epi32(va, p);
+    __m128i r16 = _mm_packs_epi32(_mm256_castsi256_si128(r), _mm256_extracti128_si256(r, 1));
+    _mm_storel_epi64((__m128i*)(a + i), _mm_packus_epi16(r16, r16));
+  }
+  fixed_blend_scalar(a + i, b + i, mult + i, n - i);
+}
+
+TARGET_AVX2 static void multiply_avx2(Byte* a, const Byte* f, size_t n) {
+  size_t i = 0;
+  for ( ; i + 16 <= n ; i += 16) {
+    store16_avx2(a + i, div255_avx2(_mm256_mullo_epi16(load16_avx2(a + i), load16_avx2(f + i))));
+  }
+  multiply_scalar(a + i, f + i, n - i);
+}
+
+TARGET_AVX2 static void multiply_const_avx2(Byte* a, Byte f, size_t n) {
+  const __m256i vf = _mm256_set1_epi16(f);
+  size_t i = 0;
+  for ( ; i + 16 <= n ; i += 16) {
+    store16_avx2(a + i, div255_avx2(_mm256_mullo_epi16(load16_avx2(a + i), vf)));
+  }
+  multiply_const_scalar(a + i, f, n - i);
+}
+
+TARGET_AVX2 static void weighted_sum_avx2(Byte* out, const Byte* const* rows, const UInt* weights, size_t count, int shift, size_t n) {
+  const __m128i vshift = _mm_cvtsi32_si128(shift);
+  size_t i = 0;
+  for ( ; i + 16 <= n ; i += 16) {
+    // unpack works within 128 bit halves, t_lo has elements 0-3 and 8-11, t_hi has 4-7 and 12-15
+    __m256i t_lo = _mm256_setzero_si256(), t_hi = _mm256_setzero_si256();
+    for (size_t k = 0 ; k < count ; ++k) {
+      __m256i v = load16_avx2(rows[k] + i);
+      __m256i w = _mm256_set1_epi16((short)weights[k]);
+      __m256i l = _mm256_mullo_epi16(v, w), h = _mm256_mulhi_epu16(v, w);
+      t_lo = _mm256_add_epi32(t_lo, _mm256_unpacklo_epi16(l, h));
+      t_hi = _mm256_add_epi32(t_hi, _mm256_unpackhi_epi16(l, h));
+    }
+    t_lo = _mm256_srl_epi32(t_lo, vshift);
+    t_hi = _mm256_srl_epi32(t_hi, vshift);
+    // packing also works within halves, which restores the order
+    store16_avx2(out + i, _mm256_packs_epi32(t_lo, t_hi));
+  }
+  for ( ; i < n ; ++i) {
+    UInt total = 0;
+    for (size_t k = 0 ; k < count ; ++k) {
+      total += rows[k][i] * weights[k];
+    }
+    out[i] = total >> shift;
+  }
+}
+
+TARGET_AVX2 static inline __m256i overlay_avx2(__m256i a, __m256i b, __m256i c) {
+  const __m256i c255 = _mm256_set1_epi16(255);
+  __m256i dark  = _mm256_srli_epi16(_mm256_mullo_epi16(a, b), 7);
+  __m256i light = _mm256_sub_epi16(c255, _mm256_srli_epi16(_mm256_mullo_epi16(_mm256_sub_epi16(c255, a), _mm256_sub_epi16(c255, b)), 7));
+  __m256i is_dark = _mm256_cmpgt_epi16(_mm256_set1_epi16(128), c);
+  return _mm256_blendv_epi8(light, dark, is_dark);
+}
+
+template <ImageCombine combine>
+TARGET_AVX2 static inline __m256i combine16_avx2(__m256i a, __m256i b) {
+  const __m256i c255 = _mm256_set1_epi16(255);
+  switch (combine) {
+    case COMBINE_ADD:        return _mm256_add_epi16(a, b);
+    case COMBINE_SUBTRACT:   return _mm256_sub_epi16(a, b);
+    case COMBINE_STAMP:      return _mm256_add_epi16(_mm256_sub_epi16(a, _mm256_add_epi16(b, b)), _mm256_set1_epi16(256));
+    case COMBINE_DIFFERENCE: return _mm256_abs_epi16(_mm256_sub_epi16(a, b));
+    case COMBINE_NEGATION: {
+      __m256i sum = _mm256_add_epi16(a, b);
+      return _mm256_min_epi16(sum, _mm256_sub_epi16(_mm256_set1_epi16(510), sum));
+    }
+    case COMBINE_MULTIPLY:   return div255_avx2(_mm256_mullo_epi16(a, b));
+    case COMBINE_DARKEN:     return _mm256_min_epi16(a, b);
+    case COMBINE_LIGHTEN:    return _mm256_max_epi16(a, b);
+    case COMBINE_SCREEN:     return _mm256_sub_epi16(c255, div255_avx2(_mm256_mullo_epi16(_mm256_sub_epi16(c255, a), _mm256_sub_epi16(c255, b))));
+    case COMBINE_OVERLAY:    return overlay_avx2(a, b, a);
+    case COMBINE_HARD_LIGHT: return overlay_avx2(a, b, b);
+    case COMBINE_SOFT_LIGHT: return b;
+    case COMBINE_AND:        return _mm256_and_si256(a, b);
+    case COMBINE_OR:         return _mm256_or_si256(a, b);
+    case COMBINE_XOR:        return _mm256_xor_si256(a, b);
+    case COMBINE_SYMMETRIC_OVERLAY:
+      return _mm256_srli_epi16(_mm256_add_epi16(overlay_avx2(a, b, a), overlay_avx2(a, b, b)), 1);
+    default:                 return a;
+  }
+}
+
+template <ImageCombine combine>
+TARGET_AVX2 static void combine_loop_avx2(Byte* a, const Byte* b, size_t n) {
+  size_t i = 0;
+  for ( ; i + 16 <= n ; i += 16) {
+    store16_avx2(a + i, combine16_avx2<combine>(load16_avx2(a + i), load16_avx2(b + i)));
+  }
+  combine_bytes_scalar(combine, a + i, b + i, n - i);
+}
+
+TARGET_AVX2 static bool combine_avx2(ImageCombine combine, Byte* a, const Byte* b, size_t n) {
+  switch (combine) {
+    #define DISPATCH(comb) case comb: combine_loop_avx2<comb>(a, b, n); return true
+    FOR_EACH_VECTOR_COMBINE(DISPATCH);
+    #undef DISPATCH
+    default: return false;
+  }
+}
+
+static const ImageKernels avx2_kernels = {
+  SIMD_AVX2, mask_blend_avx2, fixed_blend_avx2, multiply_avx2, multiply_const_avx2, weighted_sum_avx2, combine_avx2
+};
+
+// ----------------------------------------------------------------------------- : CPU detection
+
+static bool cpu_supports_sse2() {
+  #if defined(__x86_64__) || defined(_M_X64)
+    return true; // part of the architecture
+  #elif defined(__GNUC__) || defined(__clang__)
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse2");
+  #else
+    int info[4];
+    __cpuid(info, 1);
+    return (info[3] & (1 << 26)) != 0;
+  #endif
+}
+
+static bool cpu_supports_avx2() {
+  #if defined(__GNUC__) || defined(__clang__)
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+  #else
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) return false;
+    __cpuid(info, 1);
+    bool osxsave = (info[2] & (1 << 27)) != 0, avx = (info[2] & (1 << 28)) != 0;
+    if (!osxsave || !avx) return false;
+    if ((_xgetbv(0) & 6) != 6) return false; // the OS must save the ymm registers
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+  #endif
+}
+
+#endif // USE_X86_KERNELS
+
+// ----------------------------------------------------------------------------- : Dispatch
+
+const ImageKernels* image_kernels(SimdLevel level) {
+  switch (level) {
+    case SIMD_SCALAR: return &scalar_kernels;
+    #if USE_X86_KERNELS
+    case SIMD_SSE2:   return cpu_supports_sse2() ? &sse2_kernels : nullptr;
+    case SIMD_AVX2:   return cpu_supports_avx2() ? &avx2_kernels : nullptr;
+    #endif
+    default:          return nullptr;
+  }
+}
+
+static const ImageKernels* select_image_kernels() {
+  int max_level = SIMD_AVX2;
+  String name;
+  if (wxGetEnv(_("MSE_SIMD"), &name)) {
+    if      (name == _("scalar")) max_level = SIMD_SCALAR;
+    else if (name == _("sse2"))   max_level = SIMD_SSE2;
+  }
+  for (int level = max_level ; level > SIMD_SCALAR ; --level) {
+    if (const ImageKernels* kernels = image_kernels((SimdLevel)level)) return kernels;
+  }
+  return &scalar_kernels;
+}
+
+const ImageKernels& image_kernels() {
+  static const ImageKernels* kernels = select_image_kernels();
+  return *kernels;
+}
+
+String simd_level_name(SimdLevel level) {
+  switch (level) {
+    case SIMD_SCALAR: return _("scalar");
+    case SIMD_SSE2:   return _("sse2");
+    case SIMD_AVX2:   return _("avx2");
+    default:          return _("?");
+  }
+}
+
+// ----------------------------------------------------------------------------- : Benchmark
+
+namespace {
+  /// Random test data, with extra weight on the extreme values
+  class TestData {
+  public:
+    TestData() : rng(12345) {}
+    Byte byte() {
+      UInt r = rng() % 8;
+      return r == 0 ? 0 : r == 1 ? 255 : Byte(rng());
+    }
+    vector<Byte> bytes(size_t n) {
+      vector<Byte> v(n);
+      FOR_EACH(b, v) b = byte();
+      return v;
+    }
+    vector<int> mults(size_t n) {
+      vector<int> v(n);
+      FOR_EACH(m, v) {
+        UInt r = rng() % 8;
+        m = r == 0 ? 0 : r == 1 ? 65536 : int(rng() % 65537);
+      }
+      return v;
+    }
+    /// Weights like the ones used by resample_pass: at most 1<<14, summing to 1<<14
+    vector<UInt> weights(size_t count) {
+      vector<UInt> v(count);
+      UInt left = 1 << 14;
+      for (size_t k = 0 ; k + 1 < count ; ++k) {
+        v[k] = rng() % (left + 1);
+        left -= v[k];
+      }
+      if (count > 0) v[count - 1] = left;
+      return v;
+    }
+    std::mt19937 rng;
+  };
+}
+
+String image_kernels_benchmark() {
+  const size_t n = 3 * 512 * 512; // the data of a 512x512 image
+  const int repeat = 20;
+  TestData data;
+  vector<Byte> a = data.bytes(n), b = data.bytes(n), mask = data.bytes(n), out(n);
+  vector<int>  mult = data.mults(n);
+  vector<Byte> row_data[3] = {data.bytes(n), data.bytes(n), data.bytes(n)};
+  const Byte*  rows[3]     = {row_data[0].data(), row_data[1].data(), row_data[2].data()};
+  UInt         weights[3]  = {4000, 8384, 4000};
+  // the benchmarked operations
+  typedef std::function<void (const ImageKernels&)> Operation;
+  auto combine = [&](const ImageKernels& k, ImageCombine c) {
+    if (!k.combine(c, a.data(), b.data(), n)) combine_bytes_scalar(c, a.data(), b.data(), n);
+  };
+  vector<pair<String,Operation>> operations = {
+    {_("mask_blend"),       [&](const ImageKernels& k) { k.mask_blend(a.data(), b.data(), mask.data(), n); }},
+    {_("fixed_blend"),      [&](const ImageKernels& k) { k.fixed_blend(a.data(), b.data(), mult.data(), n); }},
+    {_("multiply"),         [&](const ImageKernels& k) { k.multiply(a.data(), b.data(), n); }},
+    {_("multiply_const"),   [&](const ImageKernels& k) { k.multiply_const(a.data(), 200, n); }},
+    {_("weighted_sum"),     [&](const ImageKernels& k) { k.weighted_sum(out.data(), rows, weights, 3, 14, n); }},
+    {_("combine add"),      [&](const ImageKernels& k) { combine(k, COMBINE_ADD); }},
+    {_("combine multiply"), [&](const ImageKernels& k) { combine(k, COMBINE_MULTIPLY); }},
+    {_("combine overlay"),  [&](const ImageKernels& k) { combine(k, COMBINE_OVERLAY); }},
+  };
+  // table header
+  String result = String::Format(_("%-18s"), _("MB/s"));
+  vector<const ImageKernels*> levels;
+  for (int level = SIMD_SCALAR ; level <= SIMD_AVX2 ; ++level) {
+    if (const ImageKernels* k = image_kernels((SimdLevel)level)) {
+      levels.push_back(k);
+      result += String::Format(_("%10s"), simd_level_name(k->level));
+    }
+  }
+  result += _("\n");
+  // time each operation
+  FOR_EACH(op, operations) {
+    result += String::Format(_("%-18s"), op.first);
+    FOR_EACH_CONST(k, levels) {
+      op.second(*k); // warm up
+      auto start = std::chrono::steady_clock::now();
+      for (int i = 0 ; i < repeat ; ++i) op.second(*k);
+      double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+      result += String::Format(_("%10.0f"), n * repeat / max(seconds, 1e-9) / 1e6);
+    }
+    result += _("\n");
+  }
+  return result;
+}
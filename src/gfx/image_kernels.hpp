@@ -0,0 +1,66 @@
+//+----------------------------------------------------------------------------+
+//| Description:  Magic Set Editor - Program to make Magic (tm) cards          |
+//| Copyright:    (C) Twan van Laarhoven and the other MSE developers          |
+//| License:      GNU General Public License 2 or later (see file COPYING)     |
+//+----------------------------------------------------------------------------+
+
+#pragma once
+
+/** @file gfx/image_kernels.hpp
+ *
+ *  Inner loops of the image processing functions, using vector instructions where available.
+ */
+
+// ----------------------------------------------------------------------------- : Includes
+
+#include <util/prec.hpp>
+#include <gfx/gfx.hpp>
+
+// ----------------------------------------------------------------------------- : Kernels
+
+/// Instruction sets the kernels are implemented for
+enum SimdLevel
+{  SIMD_SCALAR  ///< plain C++, this is the reference implementation
+,  SIMD_SSE2
+,  SIMD_AVX2
+};
+
+/// Loops over bytes that are used by the image processing functions
+/** All implementations give exactly the same results as the scalar one.
+ *  Byte arrays have length n and need not be aligned.
+ */
+struct ImageKernels {
+  SimdLevel level;
+  /// a[i] = (a[i] * mask[i] + b[i] * (255 - mask[i])) / 255
+  void (*mask_blend)(Byte* a, const Byte* b, const Byte* mask, size_t n);
+  /// a[i] = a[i] + mult[i] * (b[i] - a[i]) / 65536, where 0 <= mult[i] <= 65536
+  void (*fixed_blend)(Byte* a, const Byte* b, const int* mult, size_t n);
+  /// a[i] = a[i] * f[i] / 255
+  void (*multiply)(Byte* a, const Byte* f, size_t n);
+  /// a[i] = a[i] * f / 255
+  void (*multiply_const)(Byte* a, Byte f, size_t n);
+  /// out[i] = (sum of weights[k] * rows[k][i] for k < count) >> shift
+  /** The weights must be at most 1<<14, and their sum at most 1<<shift */
+  void (*weighted_sum)(Byte* out, const Byte* const* rows, const UInt* weights, size_t count, int shift, size_t n);
+  /// a[i] = the combination of a[i] and b[i] with the given combine mode
+  /** Returns false if there is no kernel for this mode, then nothing is done */
+  bool (*combine)(ImageCombine combine, Byte* a, const Byte* b, size_t n);
+};
+
+/// The kernels for the best instruction set the processor supports
+/** The MSE_SIMD environment variable ("scalar", "sse2" or "avx2") can select a lower level */
+const ImageKernels& image_kernels();
+
+/// The kernels for a specific instruction set, or nullptr if the processor doesn't support it
+const ImageKernels* image_kernels(SimdLevel level);
+
+/// Name of an instruction set
+String simd_level_name(SimdLevel level);
+
+/// Combine bytes using the plain C++ combining functions (defined in combine_image.cpp)
+void combine_bytes_scalar(ImageCombine combine, Byte* a, const Byte* b, size_t n);
+
+// ----------------------------------------------------------------------------- : Benchmark
+
+/// Measure the speed of all kernels, returns a table of the results
+String image_kernels_benchmark();
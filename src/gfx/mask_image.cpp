@@ -9,11 +9,12 @@
 #include <util/prec.hpp>
 #include <gfx/gfx.hpp>
 #include <util/error.hpp>
+#include <string_view>
 
 // ----------------------------------------------------------------------------- : AlphaMask
 
-AlphaMask::AlphaMask()                 : alpha(nullptr), lefts(nullptr), rights(nullptr) {}
-AlphaMask::AlphaMask(const Image& img) : alpha(nullptr), lefts(nullptr), rights(nullptr) {
+AlphaMask::AlphaMask()                 : alpha(nullptr), lefts(nullptr), rights(nullptr), content_hash(0) {}
+AlphaMask::AlphaMask(const Image& img) : alpha(nullptr), lefts(nullptr), rights(nullptr), content_hash(0) {
   load(img);
 }
 AlphaMask::~AlphaMask() {
@@ -24,6 +25,7 @@ void AlphaMask::clear() {
   delete[] alpha;  alpha  = nullptr;
   delete[] lefts;  lefts  = nullptr;
   delete[] rights; rights = nullptr;
+  content_hash = 0;
 }
 
 void AlphaMask::load(const Image& img) {
@@ -38,6 +40,7 @@ void AlphaMask::load(const Image& img) {
   }
   delete[] lefts;  lefts  = nullptr;
   delete[] rights; rights = nullptr;
+  content_hash = 0;
   // Copy red chanel to alpha
   Byte* from = img.GetData(), *to = alpha;
   for (size_t i = 0 ; i < n ; ++i) {
@@ -46,6 +49,17 @@ void AlphaMask::load(const Image& img) {
 }
 
 
+size_t AlphaMask::hash() const {
+  if (!alpha) return 0;
+  if (!content_hash) {
+    size_t h = std::hash<std::string_view>()(std::string_view((const char*)alpha, size.x * size.y));
+    h = h * 31 + size.x;
+    h = h * 31 + size.y;
+    content_hash = h ? h : 1;
+  }
+  return content_hash;
+}
+
 void AlphaMask::setAlpha(Image& img) const {
   if (!alpha) return;
   set_alpha(img, alpha, size);
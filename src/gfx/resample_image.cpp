@@ -8,6 +8,7 @@
 
 #include <util/prec.hpp>
 #include <gfx/gfx.hpp>
+#include <gfx/image_kernels.hpp>
 #include <util/error.hpp>
 
 // ----------------------------------------------------------------------------- : Resample passes
@@ -34,6 +35,38 @@ void resample_pass(const Image& img_in, Image& img_out, int offset_in, int offse
   if (alpha && !img_out.HasAlpha()) img_out.InitAlpha();
   int out_fact = (length_out << shift) / length_in; // how much to output for 256 input = 1 pixel
   int out_rest = (length_out << shift) % length_in;
+  if (!alpha && line_delta_in == 1 && line_delta_out == 1) {
+    // the lines are next to each other (a vertical pass), so each output pixel of all lines together
+    // is a weighted sum of whole rows of input pixels, which is a single vector kernel call
+    const ImageKernels& kernels = image_kernels();
+    const Byte* in_base  = img_in .GetData() + 3 * offset_in;
+    Byte*       out_base = img_out.GetData() + 3 * offset_out;
+    vector<const Byte*> rows;
+    vector<UInt> weights;
+    int in_pos = 0;
+    UInt in_rem = out_fact + out_rest;
+    for (int x = 0 ; x < length_out ; ++x) {
+      rows.clear();
+      weights.clear();
+      UInt out_rem = 1 << shift;
+      while (out_rem >= in_rem) {
+        // eat a whole input pixel
+        rows.push_back(in_base + 3 * delta_in * in_pos);
+        weights.push_back(in_rem);
+        out_rem -= in_rem;
+        in_rem = out_fact;
+        ++in_pos;
+      }
+      if (out_rem > 0) {
+        // eat a partial input pixel
+        rows.push_back(in_base + 3 * delta_in * in_pos);
+        weights.push_back(out_rem);
+        in_rem -= out_rem;
+      }
+      kernels.weighted_sum(out_base + 3 * delta_out * x, rows.data(), weights.data(), rows.size(), shift, 3 * lines);
+    }
+    return;
+  }
   // for each line
   for (int l = 0 ; l < lines ; ++l) {
     Byte* in  = img_in .GetData() + 3 * (offset_in  + l * line_delta_in);
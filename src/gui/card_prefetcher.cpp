@@ -0,0 +1,116 @@
+//+----------------------------------------------------------------------------+
+//| Description:  Magic Set Editor - Program to make Magic (tm) cards          |
+//| Copyright:    (C) Twan van Laarhoven and the other MSE developers          |
+//| License:      GNU General Public License 2 or later (see file COPYING)     |
+//+----------------------------------------------------------------------------+
+
+// ----------------------------------------------------------------------------- : Includes
+
+#include <util/prec.hpp>
+#include <gui/card_prefetcher.hpp>
+#include <gui/thumbnail_thread.hpp>
+#include <data/set.hpp>
+#include <data/card.hpp>
+#include <data/stylesheet.hpp>
+#include <data/field/choice.hpp>
+#include <data/field/image.hpp>
+#include <gfx/decoded_image_cache.hpp>
+#include <script/context.hpp>
+#include <script/image.hpp>
+#include <script/to_value.hpp>
+
+/// Number of prefetched cards that are remembered
+const size_t PREFETCH_RECENT = 16;
+
+// ----------------------------------------------------------------------------- : CardPrefetchRequest
+
+/// A request to prepare a single card, there is no actual thumbnail
+class CardPrefetchRequest : public ThumbnailRequest {
+public:
+  CardPrefetchRequest(CardPrefetcher* owner, const SetP& set, const CardP& card)
+    : ThumbnailRequest(
+      owner,
+      _("prefetch-") + set->absoluteFilename() + String::Format(_("-%p"), card.get()),
+      wxDateTime::Now())
+    , set(set), card(card), stylesheet(set->stylesheetForP(card))
+  {
+    // Collect what to load while we are in the main thread, the styles and scripts are not touched by the worker.
+    // Evaluating the scripts of choice images is cheap, generating the images is what takes time.
+    Context& ctx = set->getContext(card);
+    FOR_EACH(v, card->data()) {
+      if (ImageValue* iv = dynamic_cast<ImageValue*>(v.get())) {
+        if (!iv->filename.empty()) image_files.push_back(iv->filename.toStringForKey());
+      } else if (ChoiceValue* cv = dynamic_cast<ChoiceValue*>(v.get())) {
+        ChoiceStyle* style = dynamic_cast<ChoiceStyle*>(stylesheet->card_style.at(v->fieldP->index).get());
+        if (!style || !(style->render_style & RENDER_IMAGE)) continue;
+        style->initImage();
+        if (!style->image.isSet()) continue;
+        try {
+          ctx.setVariable(SCRIPT_VAR_input, to_script(cv->value()));
+          GeneratedImageP image = ctx.eval(*style->image.getValidScriptP())->toImage();
+          if (!image || !image->threadSafe()) continue;
+          RealSize size = style->getSize();
+          choice_images.push_back(ChoiceImage{image, (int)size.width, (int)size.height});
+        } catch (...) {} // the viewer will report the error
+      }
+    }
+  }
+
+  Image generate() override {
+    FOR_EACH(file, image_files) {
+      try {
+        decoded_image_cache.get(*set, file);
+      } catch (...) {} // the viewer will report the error if it matters
+    }
+    FOR_EACH(ci, choice_images) {
+      try {
+        // the result is not kept, generated_image_cache is only used from the main thread,
+        // but the files it uses end up in the decoded_image_cache
+        ci.image->generateConform(GeneratedImage::Options(ci.width, ci.height, stylesheet.get(), set.get()));
+      } catch (...) {}
+    }
+    return Image();
+  }
+  void store(const Image&) override {
+    CardPrefetcher* prefetcher = (CardPrefetcher*)owner;
+    prefetcher->recent.push_back(card);
+    if (prefetcher->recent.size() > PREFETCH_RECENT) prefetcher->recent.pop_front();
+  }
+
+private:
+  struct ChoiceImage {
+    GeneratedImageP image;
+    int             width, height;
+  };
+  SetP               set;
+  CardP              card;
+  StyleSheetP        stylesheet;
+  vector<String>     image_files;
+  vector<ChoiceImage> choice_images;
+};
+
+// ----------------------------------------------------------------------------- : CardPrefetcher
+
+CardPrefetcher::~CardPrefetcher() {
+  thumbnail_thread.abort(this);
+}
+
+void CardPrefetcher::prefetch(const SetP& set, const vector<CardP>& cards) {
+  if (!set) return;
+  // requests for cards that are no longer near the selection are not useful
+  thumbnail_thread.abortWaiting(this);
+  FOR_EACH_CONST(card, cards) {
+    if (find(recent.begin(), recent.end(), card) != recent.end()) continue;
+    card->data(); // read the card if it was read lazily
+    thumbnail_thread.request(make_intrusive<CardPrefetchRequest>(this, set, card));
+  }
+}
+
+void CardPrefetcher::done() {
+  thumbnail_thread.done(this);
+}
+
+void CardPrefetcher::abort() {
+  thumbnail_thread.abort(this);
+  recent.clear();
+}
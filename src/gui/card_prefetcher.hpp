@@ -0,0 +1,41 @@
+//+----------------------------------------------------------------------------+
+//| Description:  Magic Set Editor - Program to make Magic (tm) cards          |
+//| Copyright:    (C) Twan van Laarhoven and the other MSE developers          |
+//| License:      GNU General Public License 2 or later (see file COPYING)     |
+//+----------------------------------------------------------------------------+
+
+#pragma once
+
+// ----------------------------------------------------------------------------- : Includes
+
+#include <util/prec.hpp>
+
+DECLARE_POINTER_TYPE(Set);
+DECLARE_POINTER_TYPE(Card);
+
+// ----------------------------------------------------------------------------- : CardPrefetcher
+
+/// Prepares cards that are likely to be shown next in the background
+/** For each card the values are read (if the set is read lazily),
+ *  the images of the card and the choice images of its stylesheet are loaded in the thumbnail thread.
+ *  The results end up in the decoded_image_cache, so showing the card later doesn't have to wait for decoding images.
+ *
+ *  Recently prefetched cards are remembered, so moving the selection back and forth doesn't prefetch them again.
+ *  When the selection moves on, requests that have not started yet are dropped.
+ */
+class CardPrefetcher {
+public:
+  ~CardPrefetcher();
+
+  /// Prefetch the given cards, requests for other cards that have not started yet are dropped
+  /** Should be called from the main thread */
+  void prefetch(const SetP& set, const vector<CardP>& cards);
+  /// Finish completed requests, should be called regularly (on idle)
+  void done();
+  /// Drop all requests, for instance because the set changes
+  void abort();
+
+private:
+  deque<CardP> recent; ///< Recently prefetched cards, most recent last
+  friend class CardPrefetchRequest;
+};
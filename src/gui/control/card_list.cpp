@@ -55,6 +55,7 @@ CardListBase::~CardListBase() {
 
 void CardListBase::onBeforeChangeSet() {
   storeColumns();
+  prefetcher.abort();
 }
 void CardListBase::onChangeSet() {
   rebuild();
@@ -121,6 +122,20 @@ void CardListBase::sendEvent(int type) {
   CardSelectEvent ev(type);
   ev.SetEventObject(this);
   ProcessEvent(ev);
+  if (type == EVENT_CARD_SELECT) prefetchNeighbours();
+}
+
+void CardListBase::prefetchNeighbours() {
+  // only the card list that selects the card being edited, otherwise the lists in dialogs would prefetch as well
+  if (!allowModify() || !set || selected_item_pos < 0) return;
+  long count = (long)sorted_list.size();
+  vector<CardP> cards;
+  for (long d = 1 ; d <= (long)settings.prefetch_cards ; ++d) {
+    // the card after the selection is the most likely to be shown next
+    if (selected_item_pos + d < count) cards.push_back(getCard(selected_item_pos + d));
+    if (selected_item_pos - d >= 0)    cards.push_back(getCard(selected_item_pos - d));
+  }
+  if (!cards.empty()) prefetcher.prefetch(set, cards);
 }
 
 void CardListBase::getSelection(vector<CardP>& out) const {
@@ -186,16 +201,16 @@ bool CardListBase::doDelete() {
 // Comparison object for comparing cards
 bool CardListBase::compareItems(void* a, void* b) const {
   FieldP sort_field = column_fields[sort_by_column];
-  ValueP va = reinterpret_cast<Card*>(a)->data[sort_field];
-  ValueP vb = reinterpret_cast<Card*>(b)->data[sort_field];
+  ValueP va = reinterpret_cast<Card*>(a)->listValue(sort_field);
+  ValueP vb = reinterpret_cast<Card*>(b)->listValue(sort_field);
   assert(va && vb);
   // compare sort keys
   int cmp = smart_compare( va->getSortKey(), vb->getSortKey() );
   if (cmp != 0) return cmp < 0;
   // equal values, compare alternate sort key
   if (alternate_sort_field) {
-    ValueP va = reinterpret_cast<Card*>(a)->data[alternate_sort_field];
-    ValueP vb = reinterpret_cast<Card*>(b)->data[alternate_sort_field];
+    ValueP va = reinterpret_cast<Card*>(a)->listValue(alternate_sort_field);
+    ValueP vb = reinterpret_cast<Card*>(b)->listValue(alternate_sort_field);
     int cmp = smart_compare( va->getSortKey(), vb->getSortKey() );
     if (cmp != 0) return cmp < 0;
   }
@@ -309,7 +324,7 @@ String CardListBase::OnGetItemText(long pos, long col) const {
     // wx may give us non existing columns!
     return wxEmptyString;
   }
-  ValueP val = getCard(pos)->data[column_fields[col]];
+  ValueP val = getCard(pos)->listValue(column_fields[col]);
   if (val) return val->toString();
   else     return wxEmptyString;
 }
@@ -405,6 +420,10 @@ void CardListBase::onItemActivate(wxListEvent& ev) {
   sendEvent(EVENT_CARD_ACTIVATE);
 }
 
+void CardListBase::onIdle(wxIdleEvent&) {
+  prefetcher.done();
+}
+
 // ----------------------------------------------------------------------------- : CardListBase : Event table
 
 BEGIN_EVENT_TABLE(CardListBase, ItemList)
@@ -415,4 +434,5 @@ BEGIN_EVENT_TABLE(CardListBase, ItemList)
   EVT_MOTION          (          CardListBase::onDrag)
   EVT_MENU          (ID_SELECT_COLUMNS,  CardListBase::onSelectColumns)
   EVT_CONTEXT_MENU            (                   CardListBase::onContextMenu)
+  EVT_IDLE                    (                   CardListBase::onIdle)
 END_EVENT_TABLE  ()
@@ -12,6 +12,7 @@
 #include <gui/control/item_list.hpp>
 #include <data/card.hpp>
 #include <data/set.hpp>
+#include <gui/card_prefetcher.hpp>
 
 DECLARE_POINTER_TYPE(ChoiceField);
 DECLARE_POINTER_TYPE(Field);
@@ -128,6 +129,10 @@ private:
   
   mutable wxListItemAttr item_attr; // for OnGetItemAttr
   
+  CardPrefetcher prefetcher; ///< Prepares the cards around the selected card
+  /// Prefetch the cards before and after the selected card, if this list can select cards for editing
+  void prefetchNeighbours();
+  
 public:
   /// Open a dialog for selecting columns to be shown
   void selectColumns();
@@ -145,5 +150,7 @@ private:
   void onChar            (wxKeyEvent&);
   void onDrag            (wxMouseEvent&);
   void onContextMenu     (wxContextMenuEvent&);
+protected:
+  void onIdle            (wxIdleEvent&);
 };
 
@@ -91,7 +91,7 @@ private:
 int ImageCardList::OnGetItemImage(long pos) const {
   if (image_field) {
     // Image = thumbnail of first image field of card
-    ImageValue& val = static_cast<ImageValue&>(*getCard(pos)->data[image_field]);
+    ImageValue& val = static_cast<ImageValue&>(*getCard(pos)->data()[image_field]);
     if (val.filename.empty()) return -1; // no image
     // is there already a thumbnail?
     map<String,int>::const_iterator it = thumbnails.find(val.filename.toStringForKey());
@@ -105,8 +105,9 @@ int ImageCardList::OnGetItemImage(long pos) const {
   return -1;
 }
 
-void ImageCardList::onIdle(wxIdleEvent&) {
+void ImageCardList::onIdle(wxIdleEvent& ev) {
   thumbnail_thread.done(this);
+  CardListBase::onIdle(ev);
 }
 
 
@@ -89,6 +89,7 @@ void KeywordList::onAction(const Action& action, bool undone) {
 
 void KeywordList::updateUsageStatistics() {
   usage_statistics.clear();
+  set->readAllCards(); // usage is not stored in the set file
   FOR_EACH_CONST(card, set->cards) {
     for (KeywordUsageStatistics::const_iterator it = card->keyword_usage.begin() ; it != card->keyword_usage.end() ; ++it) {
       usage_statistics[it->second]++;
@@ -13,6 +13,8 @@
 #include <gui/util.hpp>
 #include <util/io/package_manager.hpp>
 #include <util/window_id.hpp>
+#include <gfx/generated_image_cache.hpp>
+#include <gfx/decoded_image_cache.hpp>
 #include <data/installer.hpp>
 #include <data/settings.hpp>
 #include <gfx/gfx.hpp>
@@ -331,6 +333,8 @@ void PackagesWindow::onOk(wxCommandEvent& ev) {
     );
   // Clear package list
   package_manager.reset();
+  generated_image_cache.clear();
+  decoded_image_cache.clear();
   // Download installers
   int package_pos = 0, step = 0;
   FOR_EACH(ip, installable_packages) {
@@ -31,6 +31,8 @@
 #include <gui/util.hpp>
 #include <util/io/package_manager.hpp>
 #include <util/window_id.hpp>
+#include <gfx/generated_image_cache.hpp>
+#include <gfx/decoded_image_cache.hpp>
 #include <data/game.hpp>
 #include <data/set.hpp>
 #include <data/card.hpp>
@@ -311,6 +313,10 @@ void SetWindow::onChangeSet() {
   // make sure there is always at least one card
   // some things need this
   if (set->cards.empty()) set->cards.push_back(make_intrusive<Card>(*set->game));
+  // dependent scripts are updated while idle, see onIdle
+  set->setBackgroundUpdates(settings.background_script_updates);
+  // saving only appends the changed files
+  set->setCompactionThreshold(settings.save_compaction_threshold);
   // all panels view the same set
   FOR_EACH(p, panels) {
     p->setSet(set);
@@ -458,6 +464,7 @@ bool SetWindow::askSaveAndContinue() {
   int save = ask_save_changes(this, _LABEL_1_("save changes", set->short_name), _TITLE_("save changes"));
   if (save == wxYES) {
     // save the set
+    set->updateDelayed();
     try {
       if (set->needSaveAs()) {
         // need save as
@@ -586,6 +593,7 @@ void SetWindow::onFileOpen(wxCommandEvent&) {
 }
 
 void SetWindow::onFileSave(wxCommandEvent& ev) {
+  set->updateDelayed(); // values must be up to date before writing them
   if (set->needSaveAs()) {
     onFileSaveAs(ev);
   } else {
@@ -600,6 +608,7 @@ void SetWindow::onFileSaveAs(wxCommandEvent&) {
   wxFileDialog dlg(this, _TITLE_("save_set"), settings.default_set_dir, clean_filename(set->short_name), export_formats(*set->game), wxFD_SAVE | wxFD_OVERWRITE_PROMPT);
   if (dlg.ShowModal() == wxID_OK) {
     settings.default_set_dir = dlg.GetDirectory();
+    set->updateDelayed();
     export_set(*set, dlg.GetPath(), dlg.GetFilterIndex());
     updateTitle(); // title may depend on filename
   }
@@ -610,6 +619,7 @@ void SetWindow::onFileSaveAsDirectory(wxCommandEvent&) {
   if (dlg.ShowModal() == wxID_OK) {
     String filename = dlg.GetPath();
     settings.default_set_dir = dlg.GetDirectory();
+    set->updateDelayed();
     set->saveAs(filename, true, true);
     settings.addRecentFile(filename);
     set->actions.setSavePoint();
@@ -664,6 +674,7 @@ void SetWindow::onFileExportImage(wxCommandEvent&) {
                              wxFD_SAVE | wxFD_OVERWRITE_PROMPT, this);
   if (!name.empty()) {
     settings.default_export_dir = wxPathOnly(name);
+    set->updateDelayed();
     export_image(set, card, name);
   }
 }
@@ -671,6 +682,7 @@ void SetWindow::onFileExportImage(wxCommandEvent&) {
 void SetWindow::onFileExportImages(wxCommandEvent&) {
   ExportCardSelectionChoices choices;
   selectionChoices(choices);
+  set->updateDelayed();
   ImagesExportWindow wnd(this, set, choices);
   wnd.ShowModal();
 }
@@ -678,15 +690,18 @@ void SetWindow::onFileExportImages(wxCommandEvent&) {
 void SetWindow::onFileExportHTML(wxCommandEvent&) {
   ExportCardSelectionChoices choices;
   selectionChoices(choices);
+  set->updateDelayed();
   HtmlExportWindow wnd(this, set, choices);
   wnd.ShowModal();
 }
 
 void SetWindow::onFileExportApprentice(wxCommandEvent&) {
+  set->updateDelayed();
   export_apprentice(this, set);
 }
 
 void SetWindow::onFileExportMWS(wxCommandEvent&) {
+  set->updateDelayed();
   export_mws(this, set);
 }
 
@@ -708,12 +723,14 @@ void SetWindow::onFileCheckUpdates(wxCommandEvent&) {
 void SetWindow::onFilePrint(wxCommandEvent&) {
   ExportCardSelectionChoices choices;
   selectionChoices(choices);
+  set->updateDelayed();
   print_set(this, set, choices);
 }
 
 void SetWindow::onFilePrintPreview(wxCommandEvent&) {
   ExportCardSelectionChoices choices;
   selectionChoices(choices);
+  set->updateDelayed();
   print_preview(this, set, choices);
 }
 
@@ -730,6 +747,8 @@ void SetWindow::onFileReload(wxCommandEvent&) {
     if (card_it != set->cards.end()) card_pos = card_it - set->cards.begin();
   }
   package_manager.reset(); // unload all packages
+  generated_image_cache.clear(); // images from the old packages
+  decoded_image_cache.clear();
   settings.read();         // reload settings
   setSet(import_set(filename));
   // reselect card
@@ -854,6 +873,10 @@ void SetWindow::onMenuOpen(wxMenuEvent& ev) {
 
 void SetWindow::onIdle(wxIdleEvent& ev) {
   // Stuff that must be done in the main thread
+  // Update scripts depending on recent edits, a little at a time so the window stays responsive
+  if (set && set->updatePending(20)) {
+    ev.RequestMore();
+  }
 #if USE_UPDATE_CHECKER
   show_update_dialog(this);
 #endif
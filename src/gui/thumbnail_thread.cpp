@@ -224,6 +224,19 @@ void ThumbnailThread::abort(void* owner) {
   mutex.Unlock();
 }
 
+void ThumbnailThread::abortWaiting(void* owner) {
+  assert(wxThread::IsMain());
+  wxMutexLocker lock(mutex);
+  for (size_t i = 0 ; i < open_requests.size() ; ) {
+    if (open_requests[i]->owner == owner) {
+      request_names.erase(open_requests[i]);
+      open_requests.erase(open_requests.begin() + i, open_requests.begin() + i + 1);
+    } else {
+      ++i;
+    }
+  }
+}
+
 void ThumbnailThread::abortAll() {
   assert(wxThread::IsMain());
   mutex.Lock();
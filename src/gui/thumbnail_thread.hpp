@@ -61,6 +61,9 @@ public:
   bool done(void* owner);
   /// Abort all thumbnail requests for the given owner
   void abort(void* owner);
+  /// Abort the thumbnail requests for the given owner that have not been started yet
+  /** Unlike abort this doesn't wait for a request that is in progress, it will still be stored */
+  void abortWaiting(void* owner);
   /// Abort all computations
   /** *must* be called at application exit */
   void abortAll();
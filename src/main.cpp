@@ -15,6 +15,10 @@
 #include <data/locale.hpp>
 #include <data/installer.hpp>
 #include <data/format/formats.hpp>
+#include <script/register_vm.hpp>
+#include <script/optimizer.hpp>
+#include <gfx/image_kernels.hpp>
+#include <gfx/font_metrics.hpp>
 #include <cli/cli_main.hpp>
 #include <cli/text_io_handler.hpp>
 #include <gui/welcome_window.hpp>
@@ -27,6 +31,7 @@
 #include <wx/wfstream.h>
 #include <wx/txtstrm.h>
 #include <wx/socket.h>
+#include <wx/thread.h>
 
 ScriptValueP export_set(SetP const& set, vector<CardP> const& cards, ExportTemplateP const& exp, String const& outname);
 
@@ -90,6 +95,14 @@ int MSE::OnRun() {
     wxFileSystem::AddHandler(new wxInternetFSHandler); // needed for update checker
     wxSocketBase::Initialize();
     init_script_variables();
+    String engine;
+    if (wxGetEnv(_("MSE_SCRIPT_ENGINE"), &engine) && !parse_script_engine(engine, script_engine)) {
+      queue_message(MESSAGE_WARNING, _("Unknown script engine in MSE_SCRIPT_ENGINE: ") + engine);
+    }
+    String optimize;
+    if (wxGetEnv(_("MSE_OPTIMIZE_SCRIPTS"), &optimize)) {
+      optimize_scripts = optimize != _("0");
+    }
     init_file_formats();
     cli.init();
     package_manager.init();
@@ -190,9 +203,11 @@ int MSE::OnRun() {
           cli << _("\n\n  ") << BRIGHT << _("--export") << NORMAL << PARAM << _(" TEMPLATE SETFILE ") << NORMAL << _(" [") << PARAM << _("OUTFILE") << NORMAL << _("]");
           cli << _("\n         \tExport a set using an export template.");
           cli << _("\n         \tIf no output filename is specified, the result is written to stdout.");
-          cli << _("\n\n  ") << BRIGHT << _("--export-images") << NORMAL << PARAM << _(" FILE") << NORMAL << _(" [") << PARAM << _("IMAGE") << NORMAL << _("]");
+          cli << _("\n\n  ") << BRIGHT << _("--export-images") << NORMAL << PARAM << _(" FILE") << NORMAL << _(" [") << PARAM << _("IMAGE") << NORMAL << _("] [")
+                             << BRIGHT << _("-j") << NORMAL << _(", ") << BRIGHT << _("--jobs") << NORMAL << PARAM << _(" N") << NORMAL << _("]");
           cli << _("\n         \tExport the cards in a set to image files,");
           cli << _("\n         \tIMAGE is the same format as for 'export all card images'.");
+          cli << _("\n         \tUse ") << BRIGHT << _("-j") << NORMAL << _(" or ") << BRIGHT << _("--jobs") << NORMAL << _(" to write the images with N threads, 0 for one per processor.");
           cli << _("\n\n  ") << BRIGHT << _("--cli") << NORMAL << _(" [")
                              << PARAM << _("FILE") << NORMAL << _("] [")
                              << BRIGHT << _("--quiet") << NORMAL << _("] [")
@@ -200,6 +215,11 @@ int MSE::OnRun() {
           cli << _("\n         \tStart the command line interface for performing commands on the set file.");
           cli << _("\n         \tUse ") << BRIGHT << _("-q") << NORMAL << _(" or ") << BRIGHT << _("--quiet") << NORMAL << _(" to supress the startup banner and prompts.");
           cli << _("\n         \tUse ") << BRIGHT << _("-raw") << NORMAL << _(" for raw output mode.");
+          cli << _("\n\n  ") << BRIGHT << _("--benchmark-image-kernels") << NORMAL << _(", ")
+                             << BRIGHT << _("--benchmark-reader") << NORMAL << _(", ")
+                             << BRIGHT << _("--benchmark-writer") << NORMAL << _(", ")
+                             << BRIGHT << _("--benchmark-text-layout") << NORMAL;
+          cli << _("\n         \tMeasure the speed of the image kernels, reading and writing a large set file, or measuring text.");
           cli << _("\n\nRaw output mode is intended for use by other programs:");
           cli << _("\n    - The only output is only in response to commands.");
           cli << _("\n    - For each command a single 'record' is written to the standard output.");
@@ -240,10 +260,24 @@ int MSE::OnRun() {
             return EXIT_FAILURE;
           }
           SetP set = import_set(args[1]);
+          // options, and the output filename, which is the first other argument
+          String out;
+          int jobs = 1;
+          for (size_t i = 2; i < args.size(); ++i) {
+            if (args[i] == _("--jobs") || args[i] == _("-j")) {
+              long n;
+              if (i + 1 >= args.size() || !args[i+1].ToLong(&n) || n < 0) {
+                handle_error(Error(_("Invalid number of jobs for --jobs: ") + (i + 1 < args.size() ? args[i+1] : String())));
+                return EXIT_FAILURE;
+              }
+              jobs = n == 0 ? max(1, wxThread::GetCPUCount()) : (int)n;
+              ++i; // skip the number
+            } else if (out.empty() && !starts_with(args[i], _("-"))) {
+              out = args[i];
+            }
+          }
+          if (out.empty()) out = settings.gameSettingsFor(*set->game).images_export_filename;
           // path
-          String out = args.size() >= 3 && !starts_with(args[2], _("--"))
-            ? args[2]
-            : settings.gameSettingsFor(*set->game).images_export_filename;
           String path = _(".");
           size_t pos = out.find_last_of(_("/\\"));
           if (pos != String::npos) {
@@ -253,7 +287,23 @@ int MSE::OnRun() {
             out = out.substr(pos + 1);
           }
           // export
-          export_images(set, set->cards, path, out, CONFLICT_NUMBER_OVERWRITE);
+          export_images(set, set->cards, path, out, CONFLICT_NUMBER_OVERWRITE, jobs);
+          return EXIT_SUCCESS;
+        } else if (arg == _("--benchmark-image-kernels")) {
+          cli << image_kernels_benchmark();
+          cli.flush();
+          return EXIT_SUCCESS;
+        } else if (arg == _("--benchmark-reader")) {
+          cli << reader_benchmark();
+          cli.flush();
+          return EXIT_SUCCESS;
+        } else if (arg == _("--benchmark-writer")) {
+          cli << writer_benchmark();
+          cli.flush();
+          return EXIT_SUCCESS;
+        } else if (arg == _("--benchmark-text-layout")) {
+          cli << text_layout_benchmark();
+          cli.flush();
           return EXIT_SUCCESS;
         } else if (args[0] == _("--export")) {
           if (args.size() < 2) {
@@ -136,7 +136,7 @@ void DataViewer::setCard(const CardP& card, bool refresh) {
   this->card = card;
   stylesheet = new_stylesheet;
   setStyles(stylesheet, stylesheet->card_style, &stylesheet->extra_card_style);
-  setData(card->data, &card->extraDataFor(*stylesheet));
+  setData(card->data(), &card->extraDataFor(*stylesheet));
   onChangeSize();
 }
 
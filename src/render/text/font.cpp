@@ -28,22 +28,26 @@ void FontTextElement::getCharInfo(RotatedDC& dc, double scale, vector<CharInfo>&
   // font
   dc.SetFont(*font, scale);
   // find sizes & breaks
-  double prev_width = 0;
+  vector<double> widths;
   size_t line_start = start; // start of the current line
-  for (size_t i = start ; i < end ; ++i) {
-    Char c = content.GetChar(i - this->start);
-    if (c == _('\n')) {
+  for (size_t i = start ; i <= end ; ++i) {
+    bool newline = i < end && content.GetChar(i - this->start) == _('\n');
+    if (i < end && !newline) continue;
+    // measure the line up to here, character widths come from the font_metrics_cache
+    if (i > line_start) {
+      widths.resize(i - line_start);
+      double height = dc.GetCharWidths(content, line_start - this->start, i - this->start, widths.data());
+      for (size_t j = line_start ; j < i ; ++j) {
+        out.push_back(CharInfo(
+                         RealSize(widths[j - line_start], height),
+                         content.GetChar(j - this->start) == _(' ') ? LineBreak::SPACE : LineBreak::MAYBE,
+                         draw_as == DRAW_ACTIVE // from <soft> tag
+                     ));
+      }
+    }
+    if (newline) {
       out.push_back(CharInfo(RealSize(0, dc.GetCharHeight()), break_style, draw_as == DRAW_ACTIVE));
       line_start = i + 1;
-      prev_width = 0;
-    } else {
-      RealSize s = dc.GetTextExtent(content.substr(line_start - this->start, i - line_start + 1));
-      out.push_back(CharInfo(
-                       RealSize(s.width - prev_width, s.height),
-                       c == _(' ') ? LineBreak::SPACE : LineBreak::MAYBE,
-                       draw_as == DRAW_ACTIVE // from <soft> tag
-                   ));
-      prev_width = s.width;
     }
   }
 }
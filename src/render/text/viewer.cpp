@@ -8,7 +8,11 @@
 
 #include <util/prec.hpp>
 #include <render/text/viewer.hpp>
+#include <gfx/gfx.hpp>
+#include <script/profiler.hpp> // for PROFILER
 #include <algorithm>
+#include <list>
+#include <mutex>
 
 // ----------------------------------------------------------------------------- : Line
 
@@ -64,6 +68,116 @@ size_t TextViewer::Line::posToIndex(double x) const {
   else                      return it2 - positions.begin() + start; // it2 is closer
 }
 
+// ----------------------------------------------------------------------------- : TextLayoutCache
+
+/// Maximum number of layouts in the cache
+const size_t TEXT_LAYOUT_CACHE_SIZE = 1000;
+
+/// Everything the layout of a text depends on
+/** The same text in the same style and box is laid out the same way, for instance on another card,
+ *  so the style is described by the values of its properties, not by its identity.
+ */
+struct TextLayoutKey {
+  String         text;
+  vector<double> numbers; ///< Size of the box, zoom and the numeric properties of the style
+  vector<String> names;   ///< Fonts of the style
+  const void*    symbol_font;
+  size_t         mask_hash;
+  size_t         hash;
+  
+  TextLayoutKey(RotatedDC& dc, const String& text, const TextStyle& style, double start_scale)
+    : text(text), symbol_font(style.symbol_font.font.get())
+    , mask_hash(style.mask.getFromCache().hash())
+  {
+    RealSize box = dc.getInternalSize(), zoom = dc.trS(RealSize(1,1));
+    const Font& font = style.font;
+    numbers = {
+      box.width, box.height, zoom.width, zoom.height, dc.getFontSizeStep(), start_scale,
+      font.size, font.scale_down_to, font.max_stretch, (double)font.flags, (double)font.underline,
+      style.symbol_font.size, style.symbol_font.scale_down_to, (double)style.symbol_font.alignment,
+      (double)style.always_symbol, (double)style.allow_formating, (double)style.alignment,
+      style.padding_left,  style.padding_left_min,  style.padding_right,  style.padding_right_min,
+      style.padding_top,   style.padding_top_min,   style.padding_bottom, style.padding_bottom_min,
+      style.line_height_soft, style.line_height_hard, style.line_height_line,
+      style.line_height_soft_max, style.line_height_hard_max, style.line_height_line_max,
+      style.paragraph_height, (double)style.direction, (double)style.field().multi_line,
+    };
+    names = {font.name, font.italic_name, font.weight, font.style, style.symbol_font.name};
+    hash = std::hash<std::wstring>()(text.ToStdWstring());
+    FOR_EACH(n, numbers) hash = hash * 31 + std::hash<double>()(n);
+    FOR_EACH(n, names)   hash = hash * 31 + std::hash<std::wstring>()(n.ToStdWstring());
+    hash = hash * 31 + mask_hash;
+  }
+  
+  bool operator == (const TextLayoutKey& that) const {
+    return hash == that.hash && text == that.text && numbers == that.numbers && names == that.names
+        && symbol_font == that.symbol_font && mask_hash == that.mask_hash;
+  }
+};
+
+/// The lines of laid out texts, shared by all TextViewers
+/** Preparing a text viewer for a text that was laid out before, with the same style and box, only copies the lines.
+ *  This is common when many cards use the same text, or when a card is redrawn after an unrelated change.
+ */
+class TextLayoutCache {
+public:
+  TextLayoutCache() : hits(0), misses(0) {}
+  
+  /// Find the lines and scale of a layout, returns false if it is not in the cache
+  bool find(const TextLayoutKey& key, vector<TextViewer::Line>& lines_out, double& scale_out) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = index.find(&key);
+    if (it == index.end()) {
+      ++misses;
+      return false;
+    }
+    ++hits;
+    entries.splice(entries.begin(), entries, it->second);
+    lines_out = entries.front().lines;
+    scale_out = entries.front().scale;
+    return true;
+  }
+  /// Add a layout, removes the least recently used layout if the cache is full
+  void insert(TextLayoutKey&& key, const vector<TextViewer::Line>& lines, double scale) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (index.find(&key) != index.end()) return; // another viewer was faster
+    entries.push_front(Entry{move(key), lines, scale});
+    index[&entries.front().key] = entries.begin();
+    while (entries.size() > TEXT_LAYOUT_CACHE_SIZE) {
+      index.erase(&entries.back().key);
+      entries.pop_back();
+    }
+  }
+  
+  TextLayoutCacheInfo info() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return TextLayoutCacheInfo{entries.size(), hits, misses};
+  }
+  
+private:
+  struct Entry {
+    TextLayoutKey            key;
+    vector<TextViewer::Line> lines;
+    double                   scale;
+  };
+  struct KeyHash {
+    inline size_t operator () (const TextLayoutKey* k) const { return k->hash; }
+  };
+  struct KeyEqual {
+    inline bool operator () (const TextLayoutKey* a, const TextLayoutKey* b) const { return *a == *b; }
+  };
+  mutable std::mutex mutex;
+  list<Entry> entries; ///< Most recently used first
+  unordered_map<const TextLayoutKey*, list<Entry>::iterator, KeyHash, KeyEqual> index;
+  size_t hits, misses;
+};
+
+static TextLayoutCache text_layout_cache;
+
+TextLayoutCacheInfo text_layout_cache_info() {
+  return text_layout_cache.info();
+}
+
 // ----------------------------------------------------------------------------- : TextViewer
 
 // can't be declared in header because we need to know sizeof(Line)
@@ -390,6 +504,17 @@ TextLayoutP TextViewer::extractLayoutInfo() const {
 }
 
 void TextViewer::prepareLines(RotatedDC& dc, const String& text, TextStyle& style, Context& ctx) {
+  // a scripted alignment can depend on the layout, the layout cache doesn't know about that
+  bool use_cache = !style.alignment.isScripted();
+  optional<TextLayoutKey> key;
+  if (use_cache) {
+    key.emplace(dc, text, style, scale);
+    if (text_layout_cache.find(*key, lines, scale)) {
+      style.layout = extractLayoutInfo();
+      return;
+    }
+  }
+  
   vector<CharInfo> chars;
   prepareLinesTryScales(dc, text, style, chars);
   assert(!lines.empty());
@@ -423,6 +548,8 @@ void TextViewer::prepareLines(RotatedDC& dc, const String& text, TextStyle& styl
 
   // make layout available to scripts
   style.layout = extractLayoutInfo();
+  
+  if (key) text_layout_cache.insert(move(*key), lines, scale);
 }
 
 // bound on max_scale, given that scale fits and produces the given lines
@@ -442,7 +569,34 @@ inline double bound_on_min_scale(RotatedDC& dc, const TextStyle& style, const ve
   return scale * tot_height / height;
 }
 
+// the scale at which the characters would take up the area of the box, given their size at scale
+/* Text shrinks in both directions, so the area goes with the square of the scale.
+ * Lines are not filled completely, so the text usually fits at a slightly smaller scale. */
+inline double predicted_scale(RotatedDC& dc, const TextStyle& style, const vector<CharInfo>& chars, double scale) {
+  RealSize box = dc.getInternalSize();
+  double box_area = (box.width  - style.padding_left - style.padding_right)
+                  * (box.height - style.padding_top  - style.padding_bottom);
+  double text_area = 0;
+  FOR_EACH_CONST(c, chars) {
+    text_area += c.size.width * c.size.height;
+  }
+  if (box_area <= 0 || text_area <= 0) return scale;
+  return scale * sqrt(box_area / text_area);
+}
+
+// do two lists of characters give the same layout?
+/* Fonts come in whole point sizes, so nearby scales often give exactly the same characters */
+inline bool same_char_info(const vector<CharInfo>& a, const vector<CharInfo>& b) {
+  if (a.size() != b.size()) return false;
+  for (size_t i = 0 ; i < a.size() ; ++i) {
+    if (a[i].size.width != b[i].size.width || a[i].size.height != b[i].size.height ||
+        a[i].break_after != b[i].break_after || a[i].soft != b[i].soft) return false;
+  }
+  return true;
+}
+
 void TextViewer::prepareLinesTryScales(RotatedDC& dc, const String& text, const TextStyle& style, vector<CharInfo>& chars) {
+  PROFILER(_("fit text box"));
   // Bounds
   double min_scale = elements.minScale();
   double scale_step = max(0.01,elements.scaleStep());
@@ -513,32 +667,55 @@ void TextViewer::prepareLinesTryScales(RotatedDC& dc, const String& text, const
   //    c. 0 < min_scale <= real_scale < max_scale <= 1.0+epsilon
   //    d. lines and chars give the best fitting positioning, at best_scale
   //    try: e. min_scale <= best_scale
+  
+  // The first probe is the scale at which the text would fill the box, instead of the middle
+  double guess = predicted_scale(dc, style, chars, best_scale);
+  vector<CharInfo> chars_fail; // characters of the last probe that didn't fit
     
   // go binary search!
   while(min_scale + scale_step < max_scale) {
-    scale = (min_scale + max_scale) / 2;
-    vector<Line> lines_try;
+    if (guess > min_scale + scale_step && guess < max_scale - scale_step) {
+      scale = guess;
+    } else {
+      scale = (min_scale + max_scale) / 2;
+    }
+    guess = 0;
     vector<CharInfo> chars_try;
     elements.getCharInfo(dc, scale, chars_try);
-    fits = prepareLinesAtScale(dc, chars_try, style, false, lines_try);
-    if (fits) {
-      min_scale = scale;
-      max_scale = min(max_scale, bound_on_max_scale(dc,style,lines_try,scale));
-      best_scale = scale; // invariant d
-      swap(lines,lines_try); 
-      swap(chars,chars_try);
-    } else {
+    // the same characters as an earlier probe give the same lines, no need to lay them out again
+    if (same_char_info(chars_try, chars)) {
+      fits = true;
+    } else if (same_char_info(chars_try, chars_fail)) {
       max_scale = scale;
-      min_scale = max(min_scale, bound_on_min_scale(dc,style,lines_try,scale));
-      // the above can break pseudo invariant e
+      continue;
+    } else {
+      vector<Line> lines_try;
+      fits = prepareLinesAtScale(dc, chars_try, style, false, lines_try);
+      if (fits) {
+        swap(lines,lines_try);
+        swap(chars,chars_try);
+      } else {
+        max_scale = scale;
+        min_scale = max(min_scale, bound_on_min_scale(dc,style,lines_try,scale));
+        // the above can break pseudo invariant e
+        swap(chars_fail,chars_try);
+        continue;
+      }
     }
+    // fits, lines and chars are for this scale
+    min_scale = scale;
+    max_scale = min(max_scale, bound_on_max_scale(dc,style,lines,scale));
+    best_scale = scale; // invariant d
   }
   if (best_scale != min_scale) {
     // we'd better update lines, e doesn't hold
     scale = min_scale;
-    chars.clear();
-    elements.getCharInfo(dc, scale, chars);
-    fits = prepareLinesAtScale(dc, chars, style, false, lines);
+    vector<CharInfo> chars_min;
+    elements.getCharInfo(dc, scale, chars_min);
+    if (!same_char_info(chars_min, chars)) {
+      swap(chars, chars_min);
+      fits = prepareLinesAtScale(dc, chars, style, false, lines);
+    }
   }
   scale = min_scale;
 }
@@ -555,6 +732,7 @@ RealSize TextViewer::fitLineWidth(Line& line, RotatedDC& dc, const TextStyle& st
 }
 
 bool TextViewer::prepareLinesAtScale(RotatedDC& dc, const vector<CharInfo>& chars, const TextStyle& style, bool stop_if_too_long, vector<Line>& lines) const {
+  PROFILER(_("layout text at scale"));
   // Try to layout the text at the current scale
   lines.clear();
 
@@ -160,4 +160,14 @@ private:
   double lineRight(RotatedDC& dc, const TextStyle& style, double y) const;
 };
 
+// ----------------------------------------------------------------------------- : TextLayoutCache
+
+/// Statistics of the cache of text layouts that is shared by all TextViewers
+struct TextLayoutCacheInfo {
+  size_t count;  ///< Number of cached layouts
+  size_t hits;   ///< Number of times a text was prepared from the cache
+  size_t misses; ///< Number of times a text had to be laid out
+};
+TextLayoutCacheInfo text_layout_cache_info();
+
 
@@ -17,6 +17,9 @@
 
 Context::Context()
   : level(0)
+  , register_depth(0)
+  , memo_level(0)
+  , memo_impure(false)
 {}
 
 // ----------------------------------------------------------------------------- : Evaluate
@@ -38,6 +41,11 @@ ScriptValueP Context::eval(const Script& script, bool useScope) {
   if (level > 500) {
     throw ScriptError(_("Stack overflow"));
   }
+  if (script_engine == SCRIPT_ENGINE_REGISTER) {
+    if (const RegisterCode* code = script.registerCode()) {
+      return evalRegister(script, *code, useScope);
+    }
+  }
   
   size_t stack_size = stack.size();
   size_t scope = useScope ? openScope() : 0;
@@ -96,6 +104,7 @@ ScriptValueP Context::eval(const Script& script, bool useScope) {
         
         // Get a variable
         case I_GET_VAR: {
+          noteRead((Variable)i.data);
           ScriptValueP value = variables[i.data].value;
           if (!value) throw ScriptErrorNoVariable(variable_to_string((Variable)i.data));
           stack.push_back(value);
@@ -165,7 +174,7 @@ ScriptValueP Context::eval(const Script& script, bool useScope) {
             #endif
             // get function and call.
             // there is no need to open a new scope for this function, since we already did so for the arguments
-            stack.back() = stack.back()->eval(*this, false);
+            stack.back() = callFunction(stack.back(), new_scope.get());
             // finish profiling
             #if USE_SCRIPT_PROFILING
               //profile_add(function, timer.time());
@@ -280,15 +289,16 @@ void Context::setVariable(Variable name, const ScriptValueP& value) {
 }
 
 ScriptValueP Context::getVariable(const String& name) {
-  ScriptValueP value = variables[string_to_variable(name)].value;
+  ScriptValueP value = getVariableOpt(string_to_variable(name));
   if (!value) throw ScriptErrorNoVariable(name);
   return value;
 }
 
 ScriptValueP Context::getVariableOpt(const String& name) {
-  return variables[string_to_variable(name)].value;
+  return getVariableOpt(string_to_variable(name));
 }
 ScriptValueP Context::getVariable(Variable var) {
+  noteRead(var);
   if (variables[var].value) return variables[var].value;
   throw ScriptErrorNoVariable(variable_to_string(var));
 }
@@ -297,11 +307,13 @@ ScriptValueP Context::getVariableInScopeOpt(Variable var) {
   else                               return ScriptValueP();
 }
 int Context::getVariableScope(Variable var) {
+  noteRead(var);
   if (variables[var].value) return level - variables[var].level;
   else                      return -1;
 }
 
 Variable Context::lookupVariableValue(const ScriptValueP& value) {
+  memo_impure = true; // looks at all variables
   const vector<VariableValue>& vars = variables.get();
   for (size_t i = 0 ; i < vars.size() ; ++i) {
     if (vars[i].value == value) {
@@ -331,6 +343,79 @@ ScriptValueP Context::makeClosure(const ScriptValueP& fun) {
   else        return closure;
 }
 
+ScriptValueP Context::callFunction(const ScriptValueP& fun, const LocalScope* call_scope) {
+  if (!call_scope || !fun->isPure()) {
+    memo_impure = true; // the function might have side effects
+    return fun->eval(*this, false);
+  }
+  // the arguments are the bindings in the call scope
+  MemoKey key(fun);
+  for (size_t i = call_scope->getScope() ; i < shadowed.size() ; ++i) {
+    Variable var = shadowed[i].variable;
+    const ScriptValueP& value = variables[var].value;
+    if (!is_memo_value(value)) {
+      memo_impure = true;
+      return fun->eval(*this, false);
+    }
+    key.addArgument(var, value);
+  }
+  key.finish();
+  // have we seen this call before?
+  if (const ScriptMemo::Entry* entry = memo.find(key)) {
+    bool same_reads = true;
+    FOR_EACH_CONST(r, entry->reads) {
+      if (!memo_value_equal(variables[r.first].value, r.second)) {
+        same_reads = false;
+        break;
+      }
+    }
+    if (same_reads) {
+      #if USE_SCRIPT_PROFILING
+        Profiler::current().memo_hits += 1;
+      #endif
+      // the reads also count for memoized calls that are in progress
+      FOR_EACH_CONST(r, entry->reads) noteRead(r.first);
+      return entry->result;
+    }
+  }
+  #if USE_SCRIPT_PROFILING
+    Profiler::current().memo_misses += 1;
+  #endif
+  // call, keeping track of variables that are read from outside the call
+  unsigned int old_level  = memo_level;
+  bool         old_impure = memo_impure;
+  size_t       reads_begin = memo_reads.size();
+  memo_level  = level;
+  memo_impure = false;
+  ScriptValueP result;
+  try {
+    result = fun->eval(*this, false);
+  } catch (...) {
+    memo_level  = old_level;
+    memo_impure = true;
+    if (memo_level == 0) memo_reads.clear();
+    throw;
+  }
+  bool impure = memo_impure || !is_memo_value(result);
+  memo_level  = old_level;
+  memo_impure = old_impure || memo_impure;
+  // remember the result
+  if (!impure) {
+    vector<pair<Variable,ScriptValueP>> reads;
+    for (size_t i = reads_begin ; i < memo_reads.size() && !impure ; ++i) {
+      Variable var = memo_reads[i];
+      if (find_if(reads.begin(), reads.end(), [var](const pair<Variable,ScriptValueP>& r) { return r.first == var; }) != reads.end()) continue;
+      const ScriptValueP& value = variables[var].value;
+      if (!is_memo_value(value)) impure = true;
+      reads.push_back(make_pair(var, value));
+    }
+    if (!impure) memo.insert(move(key), result, move(reads));
+  }
+  // the reads stay in memo_reads, they also count for the enclosing memoized call
+  if (memo_level == 0) memo_reads.clear();
+  return result;
+}
+
 
 size_t Context::openScope() {
   level += 1;
@@ -9,8 +9,11 @@
 // ----------------------------------------------------------------------------- : Includes
 
 #include <script/script.hpp>
+#include <script/register_vm.hpp>
+#include <script/memo.hpp>
 
 class Dependency;
+class LocalScope;
 
 // ----------------------------------------------------------------------------- : VectorIntMap
 
@@ -62,7 +65,7 @@ public:
   /// Get the value of a variable, throws if it not set
   ScriptValueP getVariable(Variable var);
   /// Get the value of a variable, returns ScriptValue() if it is not set
-  inline ScriptValueP getVariableOpt(Variable var) { return variables[var].value; }
+  inline ScriptValueP getVariableOpt(Variable var) { noteRead(var); return variables[var].value; }
   /// Get the value of a variable only if it was set in the current scope, returns ScriptValue() if it is not set
   ScriptValueP getVariableInScopeOpt(Variable var);
   /// In what scope was the variable set?
@@ -74,6 +77,12 @@ public:
   /// Make a closure of the function with the direct parameters of the current call
   ScriptValueP makeClosure(const ScriptValueP& fun);
   
+  /// Call a function, its arguments have been set in call_scope
+  /** If the function is pure, the result of the call is memoized.
+   *  call_scope can be nullptr if the arguments are not in a scope of their own, then nothing is memoized.
+   */
+  ScriptValueP callFunction(const ScriptValueP& fun, const LocalScope* call_scope);
+  
 public:
   
   /// Open a new scope
@@ -108,6 +117,23 @@ private:
     /// The opened scopes, for sanity checking
     vector<size_t> scopes;
   #endif
+  /// Registers for the register engine, one frame per nested evalRegister call
+  vector<vector<Slot>> register_frames;
+  /// Number of evalRegister calls in progress
+  unsigned int register_depth;
+  /// Results of calls to pure functions
+  ScriptMemo memo;
+  /// Scope level of the innermost memoized call in progress, 0 if there is none
+  unsigned int memo_level;
+  /// Did the memoized calls in progress do something that prevents memoization?
+  bool memo_impure;
+  /// Variables from outside the memoized calls in progress that were read
+  vector<Variable> memo_reads;
+  
+  /// Note that a variable is read, for memoization
+  inline void noteRead(Variable var) {
+    if (variables[var].level < memo_level) memo_reads.push_back(var);
+  }
   
   // utility types for dependency analysis
   struct Jump;
@@ -122,6 +148,11 @@ private:
   /// Make a closure with n arguments
   void makeClosure(size_t n, const Instruction*& instr);
   
+  /// Evaluate a script using the register engine
+  ScriptValueP evalRegister(const Script& script, const RegisterCode& code, bool openScope);
+  /// Release the values held by the registers of the innermost evalRegister call
+  void releaseRegisters(const RegisterCode& code);
+  
   /// Get a variable name givin its value, returns (Variable)-1 if not found (slow!)
   Variable lookupVariableValue(const ScriptValueP& value);
   friend class ScriptCompose;
@@ -132,6 +163,8 @@ class LocalScope {
 public:
   inline LocalScope(Context& ctx) : ctx(ctx), scope(ctx.openScope()) {}
   inline ~LocalScope() { ctx.closeScope(scope); }
+  /// The number of shadowed bindings before this scope, as returned by Context::openScope
+  inline size_t getScope() const { return scope; }
 private:
   Context& ctx;
   size_t scope;
@@ -87,7 +87,7 @@ String format_input(const String& format, const ScriptValue& input) {
   }
 }
 
-SCRIPT_FUNCTION(to_string) {
+SCRIPT_FUNCTION_PURE(to_string) {
   SCRIPT_PARAM_C(ScriptValueP, input);
   ScriptValueP format = ctx.getVariable(SCRIPT_VAR_format);
   try {
@@ -103,7 +103,7 @@ SCRIPT_FUNCTION(to_string) {
   }
 }
 
-SCRIPT_FUNCTION(to_int) {
+SCRIPT_FUNCTION_PURE(to_int) {
   ScriptValueP input = ctx.getVariable(SCRIPT_VAR_input);
   ScriptType t = input->type();
   try {
@@ -132,7 +132,7 @@ SCRIPT_FUNCTION(to_int) {
   }
 }
 
-SCRIPT_FUNCTION(to_real) {
+SCRIPT_FUNCTION_PURE(to_real) {
   ScriptValueP input = ctx.getVariable(SCRIPT_VAR_input);
   ScriptType t = input->type();
   try {
@@ -158,7 +158,7 @@ SCRIPT_FUNCTION(to_real) {
   }
 }
 
-SCRIPT_FUNCTION(to_number) {
+SCRIPT_FUNCTION_PURE(to_number) {
   ScriptValueP input = ctx.getVariable(SCRIPT_VAR_input);
   ScriptType t = input->type();
   try {
@@ -189,7 +189,7 @@ SCRIPT_FUNCTION(to_number) {
   }
 }
 
-SCRIPT_FUNCTION(to_boolean) {
+SCRIPT_FUNCTION_PURE(to_boolean) {
   ScriptValueP input = ctx.getVariable(SCRIPT_VAR_input);
   try {
     ScriptType t = input->type();
@@ -205,7 +205,7 @@ SCRIPT_FUNCTION(to_boolean) {
   }
 }
 
-SCRIPT_FUNCTION(to_color) {
+SCRIPT_FUNCTION_PURE(to_color) {
   try {
     SCRIPT_PARAM_C(Color, input);
     SCRIPT_RETURN(input);
@@ -223,19 +223,19 @@ SCRIPT_FUNCTION(to_date) {
   }
 }
 
-SCRIPT_FUNCTION(to_code) {
+SCRIPT_FUNCTION_PURE(to_code) {
   SCRIPT_PARAM_C(ScriptValueP, input);
   SCRIPT_RETURN(input->toCode());
 }
 
-SCRIPT_FUNCTION(type_name) {
+SCRIPT_FUNCTION_PURE(type_name) {
   SCRIPT_PARAM_C(ScriptValueP, input);
   SCRIPT_RETURN(input->typeName());
 }
 
 // ----------------------------------------------------------------------------- : Math
 
-SCRIPT_FUNCTION(abs) {
+SCRIPT_FUNCTION_PURE(abs) {
   ScriptValueP input = ctx.getVariable(SCRIPT_VAR_input);
   ScriptType t = input->type();
   if (t == SCRIPT_DOUBLE) {
@@ -263,47 +263,47 @@ SCRIPT_FUNCTION(random_boolean) {
 }
 
 
-SCRIPT_FUNCTION(sin) {
+SCRIPT_FUNCTION_PURE(sin) {
   SCRIPT_PARAM_C(double, input);
   SCRIPT_RETURN(sin(input));
 }
-SCRIPT_FUNCTION(cos) {
+SCRIPT_FUNCTION_PURE(cos) {
   SCRIPT_PARAM_C(double, input);
   SCRIPT_RETURN(cos(input));
 }
-SCRIPT_FUNCTION(tan) {
+SCRIPT_FUNCTION_PURE(tan) {
   SCRIPT_PARAM_C(double, input);
   SCRIPT_RETURN(tan(input));
 }
-SCRIPT_FUNCTION(sin_deg) {
+SCRIPT_FUNCTION_PURE(sin_deg) {
   SCRIPT_PARAM_C(double, input);
   SCRIPT_RETURN(sin(deg_to_rad(input)));
 }
-SCRIPT_FUNCTION(cos_deg) {
+SCRIPT_FUNCTION_PURE(cos_deg) {
   SCRIPT_PARAM_C(double, input);
   SCRIPT_RETURN(cos(deg_to_rad(input)));
 }
-SCRIPT_FUNCTION(tan_deg) {
+SCRIPT_FUNCTION_PURE(tan_deg) {
   SCRIPT_PARAM_C(double, input);
   SCRIPT_RETURN(tan(deg_to_rad(input)));
 }
-SCRIPT_FUNCTION(exp) {
+SCRIPT_FUNCTION_PURE(exp) {
   SCRIPT_PARAM_C(double, input);
   SCRIPT_RETURN(exp(input));
 }
-SCRIPT_FUNCTION(log) {
+SCRIPT_FUNCTION_PURE(log) {
   SCRIPT_PARAM_C(double, input);
   SCRIPT_RETURN(log(input));
 }
-SCRIPT_FUNCTION(log10) {
+SCRIPT_FUNCTION_PURE(log10) {
   SCRIPT_PARAM_C(double, input);
   SCRIPT_RETURN(log(input) / log(10.0));
 }
-SCRIPT_FUNCTION(sqrt) {
+SCRIPT_FUNCTION_PURE(sqrt) {
   SCRIPT_PARAM_C(double, input);
   SCRIPT_RETURN(sqrt(input));
 }
-SCRIPT_FUNCTION(pow) {
+SCRIPT_FUNCTION_PURE(pow) {
   SCRIPT_PARAM_C(double, input);
   SCRIPT_PARAM(double, exponent);
   SCRIPT_RETURN(pow(input,exponent));
@@ -312,37 +312,37 @@ SCRIPT_FUNCTION(pow) {
 // ----------------------------------------------------------------------------- : String stuff
 
 // convert a string to upper case
-SCRIPT_FUNCTION(to_upper) {
+SCRIPT_FUNCTION_PURE(to_upper) {
   SCRIPT_PARAM_C(String, input);
   SCRIPT_RETURN(input.Upper());
 }
 
 // convert a string to lower case
-SCRIPT_FUNCTION(to_lower) {
+SCRIPT_FUNCTION_PURE(to_lower) {
   SCRIPT_PARAM_C(String, input);
   SCRIPT_RETURN(input.Lower());
 }
 
 // convert a string to title case
-SCRIPT_FUNCTION(to_title) {
+SCRIPT_FUNCTION_PURE(to_title) {
   SCRIPT_PARAM_C(String, input);
   SCRIPT_RETURN(capitalize(input.Lower()));
 }
 
 // reverse a string
-SCRIPT_FUNCTION(reverse) {
+SCRIPT_FUNCTION_PURE(reverse) {
   SCRIPT_PARAM_C(String, input);
   SCRIPT_RETURN(reverse_string(input));
 }
 
 // remove leading and trailing whitespace from a string
-SCRIPT_FUNCTION(trim) {
+SCRIPT_FUNCTION_PURE(trim) {
   SCRIPT_PARAM_C(String, input);
   SCRIPT_RETURN(trim(input));
 }
 
 // extract a substring
-SCRIPT_FUNCTION(substring) {
+SCRIPT_FUNCTION_PURE(substring) {
   SCRIPT_PARAM_C(String, input);
   SCRIPT_PARAM_DEFAULT_C(int, begin, 0);
   SCRIPT_PARAM_DEFAULT_C(int, end,   INT_MAX);
@@ -358,25 +358,25 @@ SCRIPT_FUNCTION(substring) {
 }
 
 // does a string contain a substring?
-SCRIPT_FUNCTION(contains) {
+SCRIPT_FUNCTION_PURE(contains) {
   SCRIPT_PARAM_C(String, input);
   SCRIPT_PARAM_C(String, match);
   SCRIPT_RETURN(input.find(match) != String::npos);
 }
 
-SCRIPT_FUNCTION(format) {
+SCRIPT_FUNCTION_PURE(format) {
   SCRIPT_PARAM_C(String, format);
   SCRIPT_PARAM_C(ScriptValueP, input);
   SCRIPT_RETURN(format_input(format,*input));
 }
 
-SCRIPT_FUNCTION(curly_quotes) {
+SCRIPT_FUNCTION_PURE(curly_quotes) {
   SCRIPT_PARAM_C(String, input);
   SCRIPT_RETURN(curly_quotes(input,true));
 }
 
 // regex escape a string
-SCRIPT_FUNCTION(regex_escape) {
+SCRIPT_FUNCTION_PURE(regex_escape) {
   SCRIPT_PARAM_C(String, input);
   SCRIPT_RETURN(regex_escape(input));
 }
@@ -389,7 +389,7 @@ void sort_string(String& input) {
   input.clear();
   for (auto c : chars) input += c;
 }
-SCRIPT_FUNCTION(sort_text) {
+SCRIPT_FUNCTION_PURE(sort_text) {
   SCRIPT_PARAM_C(String, input);
   SCRIPT_OPTIONAL_PARAM_C(String, order) {
     SCRIPT_RETURN(spec_sort(order, input));
@@ -436,14 +436,14 @@ SCRIPT_FUNCTION(tag_contents) {
   SCRIPT_RETURN(replace_tag_contents(input, tag, contents, ctx));
 }
 
-SCRIPT_FUNCTION(remove_tag) {
+SCRIPT_FUNCTION_PURE(remove_tag) {
   SCRIPT_PARAM_C(String, input);
   SCRIPT_PARAM_C(String, tag);
   assert_tagged(input, false);
   SCRIPT_RETURN(remove_tag(input, tag));
 }
 
-SCRIPT_FUNCTION(remove_tags) {
+SCRIPT_FUNCTION_PURE(remove_tags) {
   SCRIPT_PARAM_C(String, input);
   assert_tagged(input, false);
   SCRIPT_RETURN(untag_no_escape(input));
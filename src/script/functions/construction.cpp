@@ -31,8 +31,8 @@ SCRIPT_FUNCTION(new_card) {
     assert(key);
     String name = key->toString();
     // find value to update
-    IndexMap<FieldP,ValueP>::const_iterator value_it = new_card->data.find(name);
-    if (value_it == new_card->data.end()) {
+    IndexMap<FieldP,ValueP>::const_iterator value_it = new_card->data().find(name);
+    if (value_it == new_card->data().end()) {
       throw ScriptError(format_string(_("Card doesn't have a field named '%s'"),name));
     }
     Value* value = value_it->get();
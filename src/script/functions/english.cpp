@@ -133,19 +133,19 @@ String do_english_num(String input, String(*fun)(int)) {
   }
 }
 
-SCRIPT_FUNCTION(english_number) {
+SCRIPT_FUNCTION_PURE(english_number) {
   SCRIPT_PARAM_C(String, input);
   SCRIPT_RETURN(do_english_num(input, english_number));
 }
-SCRIPT_FUNCTION(english_number_a) {
+SCRIPT_FUNCTION_PURE(english_number_a) {
   SCRIPT_PARAM_C(String, input);
   SCRIPT_RETURN(do_english_num(input, english_number_a));
 }
-SCRIPT_FUNCTION(english_number_multiple) {
+SCRIPT_FUNCTION_PURE(english_number_multiple) {
   SCRIPT_PARAM_C(String, input);
   SCRIPT_RETURN(do_english_num(input, english_number_multiple));
 }
-SCRIPT_FUNCTION(english_number_ordinal) {
+SCRIPT_FUNCTION_PURE(english_number_ordinal) {
   SCRIPT_PARAM_C(String, input);
   SCRIPT_RETURN(do_english_num(input, english_ordinal));
 }
@@ -210,11 +210,11 @@ String do_english(String input, String(*fun)(const String&)) {
   }
 }
 
-SCRIPT_FUNCTION(english_singular) {
+SCRIPT_FUNCTION_PURE(english_singular) {
   SCRIPT_PARAM_C(String, input);
   SCRIPT_RETURN(do_english(input, english_singular));
 }
-SCRIPT_FUNCTION(english_plural) {
+SCRIPT_FUNCTION_PURE(english_plural) {
   SCRIPT_PARAM_C(String, input);
   SCRIPT_RETURN(do_english(input, english_plural));
 }
@@ -325,7 +325,7 @@ String process_english_hints(const String& str) {
   return ret;
 }
 
-SCRIPT_FUNCTION(process_english_hints) {
+SCRIPT_FUNCTION_PURE(process_english_hints) {
   SCRIPT_PARAM_C(String, input);
   assert_tagged(input);
   SCRIPT_RETURN(process_english_hints(input));
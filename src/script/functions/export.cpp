@@ -358,7 +358,7 @@ SCRIPT_FUNCTION(to_bbcode) {
 // ----------------------------------------------------------------------------- : Text
 
 // convert a tagged string to plain text
-SCRIPT_FUNCTION(to_text) {
+SCRIPT_FUNCTION_PURE(to_text) {
   SCRIPT_PARAM_C(String, input);
   SCRIPT_RETURN(untag_hide_sep(input));
 }
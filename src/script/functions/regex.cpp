@@ -110,7 +110,7 @@ struct RegexReplacer {
   }
 };
 
-SCRIPT_FUNCTION_WITH_SIMPLIFY(replace_text) {
+SCRIPT_FUNCTION_PURE_WITH_SIMPLIFY(replace_text) {
   // construct replacer
   RegexReplacer replacer;
   replacer.match = from_script<ScriptRegexP>(ctx.getVariable(SCRIPT_VAR_match), SCRIPT_VAR_match);
@@ -151,7 +151,7 @@ SCRIPT_FUNCTION_SIMPLIFY_CLOSURE(replace_text) {
 
 // ----------------------------------------------------------------------------- : Rules : regex filter
 
-SCRIPT_FUNCTION_WITH_SIMPLIFY(filter_text) {
+SCRIPT_FUNCTION_PURE_WITH_SIMPLIFY(filter_text) {
   SCRIPT_PARAM_C(String, input);
   SCRIPT_PARAM_C(ScriptRegexP, match);
   SCRIPT_OPTIONAL_PARAM_C_(ScriptRegexP, in_context);
@@ -183,7 +183,7 @@ SCRIPT_FUNCTION_SIMPLIFY_CLOSURE(filter_text) {
 
 // ----------------------------------------------------------------------------- : Rules : regex break
 
-SCRIPT_FUNCTION_WITH_SIMPLIFY(break_text) {
+SCRIPT_FUNCTION_PURE_WITH_SIMPLIFY(break_text) {
   SCRIPT_PARAM_C(String, input);
   SCRIPT_PARAM_C(ScriptRegexP, match);
   SCRIPT_OPTIONAL_PARAM_C_(ScriptRegexP, in_context);
@@ -209,7 +209,7 @@ SCRIPT_FUNCTION_SIMPLIFY_CLOSURE(break_text) {
 
 // ----------------------------------------------------------------------------- : Rules : regex split
 
-SCRIPT_FUNCTION_WITH_SIMPLIFY(split_text) {
+SCRIPT_FUNCTION_PURE_WITH_SIMPLIFY(split_text) {
   SCRIPT_PARAM_C(String, input);
   SCRIPT_PARAM_C(ScriptRegexP, match);
   SCRIPT_PARAM_DEFAULT(bool, include_empty, true);
@@ -241,7 +241,7 @@ SCRIPT_FUNCTION_SIMPLIFY_CLOSURE(split_text) {
 
 // ----------------------------------------------------------------------------- : Rules : regex match
 
-SCRIPT_FUNCTION_WITH_SIMPLIFY(match_text) {
+SCRIPT_FUNCTION_PURE_WITH_SIMPLIFY(match_text) {
   SCRIPT_PARAM_C(String, input);
   SCRIPT_PARAM_C(ScriptRegexP, match);
   SCRIPT_RETURN(match->matches(input));
@@ -36,6 +36,16 @@
  */
 #define SCRIPT_FUNCTION(name) SCRIPT_FUNCTION_AUX(name,;)
 
+/// Macro to declare a new pure script function
+/** A pure function has no side effects, and its result depends only on its parameters.
+ *  Calls to pure functions are memoized, see Context::callFunction.
+ */
+#define SCRIPT_FUNCTION_PURE(name) SCRIPT_FUNCTION_AUX(name, SCRIPT_PURE)
+
+/// Declaration that marks a script function class as pure
+#define SCRIPT_PURE \
+    bool isPure() const override { return true; }
+
 /// Macro to declare a new script function with custom dependency handling
 #define SCRIPT_FUNCTION_WITH_DEP(name) \
     SCRIPT_FUNCTION_AUX(name, ScriptValueP dependencies(Context&, const Dependency&) const override;)
@@ -46,6 +56,9 @@
 /// Macro to declare a new script function with custom closure simplification
 #define SCRIPT_FUNCTION_WITH_SIMPLIFY(name) \
     SCRIPT_FUNCTION_AUX(name, ScriptValueP simplifyClosure(ScriptClosure&) const override;)
+/// Macro to declare a new pure script function with custom closure simplification
+#define SCRIPT_FUNCTION_PURE_WITH_SIMPLIFY(name) \
+    SCRIPT_FUNCTION_AUX(name, SCRIPT_PURE ScriptValueP simplifyClosure(ScriptClosure&) const override;)
 
 #define SCRIPT_FUNCTION_SIMPLIFY_CLOSURE(name) \
     ScriptValueP ScriptBuiltIn_##name::simplifyClosure(ScriptClosure& closure) const
@@ -13,6 +13,7 @@
 #include <util/dynamic_arg.hpp>
 #include <util/io/package.hpp>
 #include <gfx/generated_image.hpp>
+#include <gfx/generated_image_cache.hpp>
 #include <data/field/image.hpp>
 
 // ----------------------------------------------------------------------------- : ScriptableImage
@@ -25,7 +26,10 @@ Image ScriptableImage::generate(const GeneratedImage::Options& options) const {
     //       We could return a blank one, but the thumbnail code does want an invalid
     //       image in case of errors.
     //       This allows the caller to catch errors.
-    image = value->generate(options);
+    //       The result is conformed below, so source images can be made smaller right away.
+    GeneratedImage::Options sub_options(options);
+    sub_options.downscale_sources = true;
+    image = value->generate(sub_options);
   } else {
     // error, return blank image
     Image i(1,1);
@@ -36,6 +40,13 @@ Image ScriptableImage::generate(const GeneratedImage::Options& options) const {
   return conform_image(image, options);
 }
 
+Image ScriptableImage::generateShared(const GeneratedImage::Options& options) const {
+  if (!isReady()) return generate(options);
+  return generated_image_cache.get(value, options, [this](const GeneratedImage::Options& opt) {
+    return generate(opt);
+  });
+}
+
 ImageCombine ScriptableImage::combine() const {
   if (!isReady()) return COMBINE_DEFAULT;
   return value->combine();
@@ -137,7 +148,7 @@ void CachedScriptableImage::generateCached(const GeneratedImage::Options& option
   Radians a = options.angle;
   const_cast<GeneratedImage::Options&>(options).angle = 0;
   // generate
-  cached_i = generate(options);
+  cached_i = generateShared(options);
   assert(cached_i.Ok());
   const_cast<GeneratedImage::Options&>(options).angle = cached_angle = a;
   *size = cached_size = RealSize(options.width, options.height);
@@ -147,7 +158,11 @@ void CachedScriptableImage::generateCached(const GeneratedImage::Options& option
     mask_opts.width  = cached_i.GetWidth();
     mask_opts.height = cached_i.GetHeight();
     mask_opts.angle  = 0;
-    mask->get(mask_opts).setAlpha(cached_i);
+    const AlphaMask& alpha_mask = mask->get(mask_opts);
+    if (alpha_mask.isLoaded()) {
+      cached_i = cached_i.Copy(); // don't change the shared image
+      alpha_mask.setAlpha(cached_i);
+    }
   }
   if (options.angle != 0) {
     // hack(part2) do the actual rotation now
@@ -213,7 +228,7 @@ void CachedScriptableMask::getNoCache(const GeneratedImage::Options& img_options
   if (script.isBlank()) {
     other_mask.clear();
   } else {
-    Image image = script.generate(img_options);
+    Image image = script.generateShared(img_options);
     other_mask.load(image);
   }
 }
@@ -38,6 +38,9 @@ public:
   
   /// Generate an image.
   Image generate(const GeneratedImage::Options& options) const;
+  /// Generate an image, or find it in the generated_image_cache.
+  /** The result can be shared with other images, it must not be modified in place. */
+  Image generateShared(const GeneratedImage::Options& options) const;
   /// How should images be combined with the background?
   ImageCombine combine() const;
   
@@ -0,0 +1,122 @@
+//+----------------------------------------------------------------------------+
+//| Description:  Magic Set Editor - Program to make Magic (tm) cards          |
+//| Copyright:    (C) Twan van Laarhoven and the other MSE developers          |
+//| License:      GNU General Public License 2 or later (see file COPYING)     |
+//+----------------------------------------------------------------------------+
+
+// ----------------------------------------------------------------------------- : Includes
+
+#include <util/prec.hpp>
+#include <script/memo.hpp>
+#include <script/register_vm.hpp> // for is_plain_number
+#include <gfx/color.hpp>
+
+// ----------------------------------------------------------------------------- : Memo values
+
+bool is_memo_value(const ScriptValueP& value) {
+  if (!value) return true;
+  switch (value->type()) {
+    case SCRIPT_NIL: case SCRIPT_COLOR: case SCRIPT_REGEX:
+      return true;
+    case SCRIPT_INT: case SCRIPT_BOOL: case SCRIPT_DOUBLE:
+      return is_plain_number(*value);
+    case SCRIPT_STRING:
+      return is_plain_string(*value);
+    case SCRIPT_FUNCTION:
+      return value->isPure();
+    default:
+      return false;
+  }
+}
+
+bool memo_value_equal(const ScriptValueP& a, const ScriptValueP& b) {
+  if (a == b) return true;
+  if (!a || !b) return false;
+  ScriptType at = a->type();
+  if (at != b->type()) return false;
+  switch (at) {
+    case SCRIPT_NIL:    return true;
+    case SCRIPT_INT:    return a->toInt()    == b->toInt();
+    case SCRIPT_BOOL:   return a->toBool()   == b->toBool();
+    case SCRIPT_DOUBLE: return a->toDouble() == b->toDouble();
+    case SCRIPT_STRING: return a->toString() == b->toString();
+    case SCRIPT_COLOR:  return a->toColor()  == b->toColor();
+    default:            return false; // compare by identity
+  }
+}
+
+static size_t memo_value_hash(const ScriptValueP& value) {
+  if (!value) return 0;
+  switch (value->type()) {
+    case SCRIPT_NIL:    return 1;
+    case SCRIPT_INT:    return std::hash<int>()(value->toInt());
+    case SCRIPT_BOOL:   return value->toBool() ? 3 : 2;
+    case SCRIPT_DOUBLE: return std::hash<double>()(value->toDouble());
+    case SCRIPT_STRING: return std::hash<String>()(value->toString());
+    case SCRIPT_COLOR: {
+      Color c = value->toColor();
+      return (size_t)c.r << 24 | (size_t)c.g << 16 | (size_t)c.b << 8 | (size_t)c.a;
+    }
+    default:            return std::hash<const void*>()(value.get());
+  }
+}
+
+// ----------------------------------------------------------------------------- : MemoKey
+
+void MemoKey::addArgument(Variable var, const ScriptValueP& value) {
+  arguments.push_back(make_pair(var, value));
+}
+
+void MemoKey::finish() {
+  // named arguments can be passed in any order
+  sort(arguments.begin(), arguments.end(), [](const pair<Variable,ScriptValueP>& a, const pair<Variable,ScriptValueP>& b) {
+    return a.first < b.first;
+  });
+  hash = std::hash<const void*>()(function.get());
+  FOR_EACH_CONST(a, arguments) {
+    hash = hash * 31 + (size_t)a.first;
+    hash = hash * 31 + memo_value_hash(a.second);
+  }
+}
+
+bool MemoKey::operator == (const MemoKey& that) const {
+  if (hash != that.hash || function != that.function || arguments.size() != that.arguments.size()) return false;
+  for (size_t i = 0 ; i < arguments.size() ; ++i) {
+    if (arguments[i].first != that.arguments[i].first) return false;
+    if (!memo_value_equal(arguments[i].second, that.arguments[i].second)) return false;
+  }
+  return true;
+}
+
+// ----------------------------------------------------------------------------- : ScriptMemo
+
+ScriptMemo::ScriptMemo(size_t capacity)
+  : capacity(capacity)
+{}
+
+const ScriptMemo::Entry* ScriptMemo::find(const MemoKey& key) {
+  auto it = index.find(&key);
+  if (it == index.end()) return nullptr;
+  // move to front
+  entries.splice(entries.begin(), entries, it->second);
+  return &entries.front();
+}
+
+void ScriptMemo::insert(MemoKey&& key, const ScriptValueP& result, vector<pair<Variable,ScriptValueP>>&& reads) {
+  auto it = index.find(&key);
+  if (it != index.end()) {
+    // replace an outdated entry
+    Entry& e = *it->second;
+    e.result = result;
+    e.reads  = move(reads);
+    entries.splice(entries.begin(), entries, it->second);
+    return;
+  }
+  entries.push_front(Entry{move(key), result, move(reads)});
+  index[&entries.front().key] = entries.begin();
+  // forget the least recently used entry
+  if (entries.size() > capacity) {
+    index.erase(&entries.back().key);
+    entries.pop_back();
+  }
+}
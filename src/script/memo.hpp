@@ -0,0 +1,83 @@
+//+----------------------------------------------------------------------------+
+//| Description:  Magic Set Editor - Program to make Magic (tm) cards          |
+//| Copyright:    (C) Twan van Laarhoven and the other MSE developers          |
+//| License:      GNU General Public License 2 or later (see file COPYING)     |
+//+----------------------------------------------------------------------------+
+
+#pragma once
+
+// ----------------------------------------------------------------------------- : Includes
+
+#include <util/prec.hpp>
+#include <script/script.hpp>
+#include <list>
+
+// ----------------------------------------------------------------------------- : Memo values
+
+/// Can a value be an argument or a result of a memoized function call?
+/** These are values that are compared by value (plain numbers and strings, colors),
+ *  and immutable values that are compared by identity (regular expressions, pure functions).
+ *  A null pointer (an unset variable) also counts.
+ */
+bool is_memo_value(const ScriptValueP& value);
+/// Are two memo values the same?
+bool memo_value_equal(const ScriptValueP& a, const ScriptValueP& b);
+
+/// Is a value a plain string? (defined in value.cpp)
+/** Other values of type SCRIPT_STRING can have members that are not part of their string value */
+bool is_plain_string(const ScriptValue& value);
+
+// ----------------------------------------------------------------------------- : MemoKey
+
+/// A call of a pure function: the function and the values of its arguments
+class MemoKey {
+public:
+  MemoKey(const ScriptValueP& function) : function(function), hash(0) {}
+
+  ScriptValueP                        function;
+  vector<pair<Variable,ScriptValueP>> arguments; ///< Sorted by variable
+  size_t                              hash;
+
+  /// Add an argument, the value must be a memo value
+  void addArgument(Variable var, const ScriptValueP& value);
+  /// Done adding arguments, sort them and compute the hash
+  void finish();
+
+  bool operator == (const MemoKey& that) const;
+};
+
+// ----------------------------------------------------------------------------- : ScriptMemo
+
+/// Results of calls to pure functions
+/** Only the most recently used calls are remembered.
+ *  Besides its arguments, a function call can read variables from outside the call,
+ *  a remembered result can only be used if those variables still have the same value.
+ */
+class ScriptMemo {
+public:
+  ScriptMemo(size_t capacity = 1024);
+
+  struct Entry {
+    MemoKey                             key;
+    ScriptValueP                        result;
+    vector<pair<Variable,ScriptValueP>> reads; ///< Variables read from outside the call, and their values
+  };
+
+  /// Find a previous call, returns nullptr if it is not remembered
+  const Entry* find(const MemoKey& key);
+  /// Remember the result of a call, forgetting the least recently used call if needed
+  void insert(MemoKey&& key, const ScriptValueP& result, vector<pair<Variable,ScriptValueP>>&& reads);
+
+  inline size_t size() const { return entries.size(); }
+
+private:
+  struct KeyHash {
+    inline size_t operator () (const MemoKey* k) const { return k->hash; }
+  };
+  struct KeyEqual {
+    inline bool operator () (const MemoKey* a, const MemoKey* b) const { return *a == *b; }
+  };
+  size_t capacity;
+  list<Entry> entries; ///< Most recently used first
+  unordered_map<const MemoKey*, list<Entry>::iterator, KeyHash, KeyEqual> index;
+};
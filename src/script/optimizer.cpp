@@ -0,0 +1,369 @@
+//+----------------------------------------------------------------------------+
+//| Description:  Magic Set Editor - Program to make Magic (tm) cards          |
+//| Copyright:    (C) Twan van Laarhoven and the other MSE developers          |
+//| License:      GNU General Public License 2 or later (see file COPYING)     |
+//+----------------------------------------------------------------------------+
+
+// ----------------------------------------------------------------------------- : Includes
+
+#include <util/prec.hpp>
+#include <script/optimizer.hpp>
+#include <script/to_value.hpp>
+#include <util/error.hpp>
+
+std::atomic<bool> optimize_scripts(true);
+ScriptOptimizerStats script_optimizer_stats;
+
+// Defined in context.cpp
+void instrUnary     (UnaryInstructionType      i, ScriptValueP& a);
+void instrBinary    (BinaryInstructionType     i, ScriptValueP& a, const ScriptValueP& b);
+void instrTernary   (TernaryInstructionType    i, ScriptValueP& a, const ScriptValueP& b, const ScriptValueP& c);
+void instrQuaternary(QuaternaryInstructionType i, ScriptValueP& a, const ScriptValueP& b, const ScriptValueP& c, const ScriptValueP& d);
+
+// ----------------------------------------------------------------------------- : Utility
+
+/// Does an instruction have an address as its data?
+static bool is_jump(InstructionType t) {
+  return t == I_JUMP || t == I_JUMP_IF_NOT || t == I_JUMP_SC_AND || t == I_JUMP_SC_OR
+      || t == I_LOOP || t == I_LOOP_WITH_KEY;
+}
+
+/// Is an instruction followed by I_NOPs holding argument names?
+static bool has_arguments(InstructionType t) {
+  return t == I_CALL || t == I_TAILCALL || t == I_CLOSURE;
+}
+
+/// Can a constant take part in constant folding?
+/** Simple instructions on these values don't depend on the context they are evaluated in */
+static bool is_simple_constant(const ScriptValueP& v) {
+  switch (v->type()) {
+    case SCRIPT_NIL: case SCRIPT_INT: case SCRIPT_BOOL: case SCRIPT_DOUBLE:
+    case SCRIPT_STRING: case SCRIPT_COLOR:
+      return true;
+    default:
+      return false;
+  }
+}
+
+/// Can a binary instruction be folded?
+static bool is_foldable_binary(BinaryInstructionType i, const ScriptValueP& b) {
+  switch (i) {
+    case I_MEMBER: case I_ITERATOR_R: case I_OR_ELSE:
+      return false;
+    case I_DIV: case I_MOD:
+      // don't divide by zero at parse time
+      return (b->type() == SCRIPT_INT    && b->toInt()    != 0)
+          || (b->type() == SCRIPT_DOUBLE && b->toDouble() != 0);
+    default:
+      return true;
+  }
+}
+
+// ----------------------------------------------------------------------------- : ScriptOptimizer
+
+/// Optimizes the instructions of a single script.
+/** Instructions are first marked as removed, all addresses are updated when compacting at the end.
+ *  An address that points to a removed instruction refers to the first live instruction after it.
+ */
+class ScriptOptimizer {
+public:
+  ScriptOptimizer(Script& script)
+    : instrs(script.getInstructions())
+    , constants(script.getConstants())
+  {}
+
+  void run();
+
+private:
+  vector<Instruction>&  instrs;
+  vector<ScriptValueP>& constants;
+  vector<bool>          removed; ///< Instructions that will be removed
+  vector<int>           targets; ///< Number of jumps to each live instruction
+
+  /// Are all addresses valid? Scripts with parse errors might not be
+  bool valid() const;
+  /// The first live instruction at or after pos
+  size_t live(size_t pos) const;
+  /// The first live instruction after pos
+  inline size_t next(size_t pos) const { return live(pos + 1); }
+
+  void findTargets();
+  /// Fold constants and remove useless instruction pairs
+  bool fold();
+  /// Fold the instructions at positions p[0..k-1] (constants) and op
+  bool foldConstants(const size_t* p, size_t k, size_t op);
+  /// Replace jumps to jumps by a single jump
+  bool threadJumps();
+  /// Remove instructions that can never be executed
+  bool removeUnreachable();
+  /// Actually remove the removed instructions, and unused constants
+  void compact();
+};
+
+bool ScriptOptimizer::valid() const {
+  size_t n = instrs.size();
+  for (size_t pos = 0 ; pos < n ; ++pos) {
+    const Instruction& i = instrs[pos];
+    if (is_jump(i.instr) && i.data > n) return false;
+    if (has_arguments(i.instr) && pos + i.data >= n) return false;
+  }
+  return true;
+}
+
+size_t ScriptOptimizer::live(size_t pos) const {
+  while (pos < instrs.size() && removed[pos]) ++pos;
+  return pos;
+}
+
+void ScriptOptimizer::findTargets() {
+  size_t n = instrs.size();
+  targets.assign(n + 1, 0);
+  for (size_t pos = live(0) ; pos < n ; pos = next(pos)) {
+    if (is_jump(instrs[pos].instr)) {
+      targets[live(instrs[pos].data)] += 1;
+    }
+  }
+}
+
+void ScriptOptimizer::run() {
+  removed.assign(instrs.size(), false);
+  if (instrs.empty() || !valid()) return;
+  bool changed;
+  do {
+    findTargets();
+    changed = fold();
+    changed = threadJumps() || changed;
+    changed = removeUnreachable() || changed;
+  } while (changed);
+  compact();
+}
+
+// ----------------------------------------------------------------------------- : Folding
+
+// Note: fold never removes an instruction that is the target of a jump,
+// so the targets remain valid during a single pass.
+bool ScriptOptimizer::fold() {
+  bool changed = false;
+  size_t n = instrs.size();
+  for (size_t a = live(0) ; a < n ; a = next(a)) {
+    // I_DUP; I_POP  -->  nothing
+    if (instrs[a].instr == I_DUP) {
+      size_t b = next(a);
+      if (b < n && instrs[b].instr == I_POP && targets[a] == 0 && targets[b] == 0) {
+        removed[a] = removed[b] = true;
+        changed = true;
+      }
+      continue;
+    }
+    if (instrs[a].instr != I_PUSH_CONST) continue;
+    // a sequence of constants, followed by an instruction op
+    size_t p[4];
+    size_t k = 0, op = a;
+    while (k < 4 && op < n && instrs[op].instr == I_PUSH_CONST && (k == 0 || targets[op] == 0)) {
+      p[k++] = op;
+      op = next(op);
+    }
+    if (op >= n || targets[op] != 0) continue;
+    Instruction i = instrs[op];
+    size_t arity = i.instr == I_UNARY      ? 1
+                 : i.instr == I_BINARY     ? 2
+                 : i.instr == I_TERNARY    ? 3
+                 : i.instr == I_QUATERNARY ? 4 : 0;
+    if (arity > 0) {
+      if (arity == k && foldConstants(p, k, op)) changed = true;
+      continue;
+    }
+    if (k != 1 || targets[a] != 0) continue;
+    // a single constant, used by a control flow instruction
+    const ScriptValueP& c = constants[instrs[a].data];
+    bool is_bool = c->type() == SCRIPT_BOOL;
+    if (i.instr == I_POP) {
+      // push x; pop  -->  nothing
+      removed[a] = removed[op] = true;
+      changed = true;
+    } else if (i.instr == I_JUMP_IF_NOT && is_bool) {
+      // push true;  jnz x  -->  nothing
+      // push false; jnz x  -->  jump x
+      removed[a] = true;
+      if (c->toBool()) removed[op] = true;
+      else             instrs[op].instr = I_JUMP;
+      changed = true;
+    } else if ((i.instr == I_JUMP_SC_AND || i.instr == I_JUMP_SC_OR) && is_bool) {
+      // push c; jump sc x  -->  nothing       (if not jumping, c is popped)
+      //                    -->  push c; jump x  (if jumping, c is kept)
+      bool jumps = c->toBool() == (i.instr == I_JUMP_SC_OR);
+      if (jumps) {
+        instrs[op].instr = I_JUMP;
+      } else {
+        removed[a] = removed[op] = true;
+      }
+      changed = true;
+    }
+  }
+  return changed;
+}
+
+bool ScriptOptimizer::foldConstants(const size_t* p, size_t k, size_t op) {
+  ScriptValueP args[4];
+  for (size_t j = 0 ; j < k ; ++j) {
+    args[j] = constants[instrs[p[j]].data];
+    if (!is_simple_constant(args[j])) return false;
+  }
+  Instruction i = instrs[op];
+  ScriptValueP result = args[0];
+  try {
+    switch (i.instr) {
+      case I_UNARY:
+        if (i.instr1 == I_ITERATOR_C) return false;
+        instrUnary(i.instr1, result);
+        break;
+      case I_BINARY:
+        if (!is_foldable_binary(i.instr2, args[1])) return false;
+        instrBinary(i.instr2, result, args[1]);
+        break;
+      case I_TERNARY:
+        instrTernary(i.instr3, result, args[1], args[2]);
+        break;
+      case I_QUATERNARY:
+        instrQuaternary(i.instr4, result, args[1], args[2], args[3]);
+        break;
+      default:
+        return false;
+    }
+  } catch (const Error&) {
+    return false; // the error should happen when the script is run
+  }
+  if (!is_simple_constant(result)) return false;
+  // replace by a single constant
+  constants.push_back(result);
+  instrs[p[0]].data = (unsigned int)constants.size() - 1;
+  for (size_t j = 1 ; j < k ; ++j) removed[p[j]] = true;
+  removed[op] = true;
+  return true;
+}
+
+// ----------------------------------------------------------------------------- : Jumps
+
+bool ScriptOptimizer::threadJumps() {
+  bool changed = false;
+  size_t n = instrs.size();
+  for (size_t j = live(0) ; j < n ; j = next(j)) {
+    Instruction& i = instrs[j];
+    if (!is_jump(i.instr)) continue;
+    size_t t = live(i.data);
+    // follow jumps to jumps.
+    // a short-circuiting jump to the same kind of jump will also jump, since the top of the stack is unchanged
+    for (size_t hops = 0 ; t < n && t != j && hops < n ; ++hops) {
+      const Instruction& ti = instrs[t];
+      if (ti.instr == I_JUMP || (ti.instr == i.instr && (i.instr == I_JUMP_SC_AND || i.instr == I_JUMP_SC_OR))) {
+        t = live(ti.data);
+      } else {
+        break;
+      }
+    }
+    if (t != i.data) {
+      i.data = (unsigned int)t;
+      changed = true;
+    }
+    // a jump to the next instruction does nothing
+    if (i.instr == I_JUMP && t == next(j)) {
+      removed[j] = true;
+      changed = true;
+    }
+  }
+  return changed;
+}
+
+bool ScriptOptimizer::removeUnreachable() {
+  size_t n = instrs.size();
+  vector<bool> reachable(n, false);
+  vector<size_t> todo;
+  auto reach = [&](size_t pos) {
+    pos = live(pos);
+    if (pos < n && !reachable[pos]) {
+      reachable[pos] = true;
+      todo.push_back(pos);
+    }
+  };
+  reach(0);
+  while (!todo.empty()) {
+    size_t pos = todo.back(); todo.pop_back();
+    const Instruction& i = instrs[pos];
+    if (i.instr == I_JUMP) {
+      reach(i.data);
+    } else if (is_jump(i.instr)) {
+      reach(i.data);
+      reach(pos + 1);
+    } else if (has_arguments(i.instr)) {
+      for (size_t arg = 1 ; arg <= i.data ; ++arg) {
+        reachable[pos + arg] = true;
+      }
+      reach(pos + 1 + i.data);
+    } else {
+      reach(pos + 1);
+    }
+  }
+  bool changed = false;
+  for (size_t pos = 0 ; pos < n ; ++pos) {
+    if (!removed[pos] && !reachable[pos]) {
+      removed[pos] = true;
+      changed = true;
+    }
+  }
+  return changed;
+}
+
+// ----------------------------------------------------------------------------- : Compacting
+
+void ScriptOptimizer::compact() {
+  size_t n = instrs.size();
+  // new addresses
+  vector<unsigned int> new_pos(n + 1);
+  unsigned int count = 0;
+  for (size_t pos = 0 ; pos < n ; ++pos) {
+    new_pos[pos] = count;
+    if (!removed[pos]) ++count;
+  }
+  new_pos[n] = count;
+  // move instructions, and constants that are still used
+  vector<Instruction>  new_instrs;
+  vector<ScriptValueP> new_constants;
+  vector<int>          new_constant_pos(constants.size(), -1);
+  new_instrs.reserve(count);
+  for (size_t pos = 0 ; pos < n ; ++pos) {
+    if (removed[pos]) continue;
+    Instruction i = instrs[pos];
+    if (is_jump(i.instr)) {
+      i.data = new_pos[i.data];
+    } else if (i.instr == I_PUSH_CONST || i.instr == I_MEMBER_C) {
+      int& c = new_constant_pos[i.data];
+      if (c < 0) {
+        c = (int)new_constants.size();
+        new_constants.push_back(constants[i.data]);
+      }
+      i.data = (unsigned int)c;
+    }
+    new_instrs.push_back(i);
+    // don't touch the argument names
+    if (has_arguments(i.instr)) {
+      for (size_t arg = 1 ; arg <= i.data ; ++arg) {
+        new_instrs.push_back(instrs[pos + arg]);
+      }
+      pos += i.data;
+    }
+  }
+  instrs.swap(new_instrs);
+  constants.swap(new_constants);
+}
+
+// ----------------------------------------------------------------------------- : optimize_script
+
+size_t optimize_script(Script& script) {
+  size_t before = script.getInstructions().size();
+  ScriptOptimizer(script).run();
+  size_t after = script.getInstructions().size();
+  script_optimizer_stats.scripts             += 1;
+  script_optimizer_stats.instructions_before += before;
+  script_optimizer_stats.instructions_after  += after;
+  return before - after;
+}
@@ -0,0 +1,34 @@
+//+----------------------------------------------------------------------------+
+//| Description:  Magic Set Editor - Program to make Magic (tm) cards          |
+//| Copyright:    (C) Twan van Laarhoven and the other MSE developers          |
+//| License:      GNU General Public License 2 or later (see file COPYING)     |
+//+----------------------------------------------------------------------------+
+
+#pragma once
+
+// ----------------------------------------------------------------------------- : Includes
+
+#include <util/prec.hpp>
+#include <script/script.hpp>
+#include <atomic>
+
+// ----------------------------------------------------------------------------- : Optimizer
+
+/// Optimize a script produced by the parser
+/** Performs constant folding, removes dead code and useless instruction pairs,
+ *  and threads jumps to jumps.
+ *  Returns the number of instructions removed.
+ */
+size_t optimize_script(Script& script);
+
+/// Should the parser optimize scripts?
+/** Atomic, because scripts are also parsed outside the main thread */
+extern std::atomic<bool> optimize_scripts;
+
+/// Statistics on all scripts optimized so far
+struct ScriptOptimizerStats {
+  std::atomic<size_t> scripts{0};             ///< Number of scripts optimized
+  std::atomic<size_t> instructions_before{0}; ///< Total number of instructions before optimization
+  std::atomic<size_t> instructions_after{0};  ///< Total number of instructions after optimization
+};
+extern ScriptOptimizerStats script_optimizer_stats;
@@ -10,6 +10,7 @@
 #include <script/script.hpp>
 #include <script/parser.hpp>
 #include <script/to_value.hpp>
+#include <script/optimizer.hpp>
 #include <util/error.hpp>
 #include <util/tagged_string.hpp>
 #include <util/io/package_manager.hpp> // for "include file" semi hack
@@ -416,6 +417,7 @@ ScriptP parse(const String& s, Packaged* package, bool string_mode, vector<Scrip
   if (type == EXPR_FAILED) {
     return ScriptP();
   } else {
+    if (optimize_scripts) optimize_script(*script);
     return script;
   }
 }
@@ -456,6 +458,7 @@ ExprType parseExpr(TokenIterator& input, Script& script, Precedence minPrec) {
       input.add_error(_("Warning: last statement of a function should be an expression, that is, it should return a result in all cases."));
     }
     expectToken(input, _("}"), &token);
+    if (optimize_scripts) optimize_script(*subScript);
     script.addInstruction(I_PUSH_CONST, subScript);
   } else if (token == _("[")) {
     // [] = list or map literal
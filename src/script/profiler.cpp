@@ -8,6 +8,7 @@
 
 #include <util/prec.hpp>
 #include <script/profiler.hpp>
+#include <thread>
 
 #if USE_SCRIPT_PROFILING
 
@@ -35,7 +36,7 @@ void Timer::exclude_time() {
   start -= delta_delta;
 }
 
-ProfileTime Timer::delta = 0;
+thread_local ProfileTime Timer::delta = 0;
 
 // ----------------------------------------------------------------------------- : FunctionProfile
 
@@ -61,8 +62,10 @@ void profile_aggregate(FunctionProfile& parent, int level, int max_level, size_t
   if (!fpp) {
     fpp = make_intrusive<FunctionProfile>(p.name);
   }
-  fpp->time_ticks += p.time_ticks;
-  fpp->calls      += p.calls;
+  fpp->time_ticks  += p.time_ticks;
+  fpp->calls       += p.calls;
+  fpp->memo_hits   += p.memo_hits;
+  fpp->memo_misses += p.memo_misses;
   // recurse
   if (level == 0) {
     profile_aggregate(parent, level, max_level, p);
@@ -85,7 +88,11 @@ const FunctionProfile& profile_aggregated(int max_level) {
 
 // ----------------------------------------------------------------------------- : Profiler
 
-FunctionProfile* Profiler::function = &profile_root;
+// profiles of other threads go into a root of their own, so threads don't modify each others profiles
+static const std::thread::id profiler_main_thread = std::this_thread::get_id();
+static thread_local FunctionProfile profile_thread_root(_("thread"));
+thread_local FunctionProfile* Profiler::function =
+  std::this_thread::get_id() == profiler_main_thread ? &profile_root : &profile_thread_root;
 
 // Enter a function
 Profiler::Profiler(Timer& timer, Variable function_name)
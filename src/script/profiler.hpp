@@ -66,7 +66,7 @@ public:
   inline void exclude_time();
 private:
   ProfileTime start;
-  static ProfileTime delta; ///< Time excluded
+  static thread_local ProfileTime delta; ///< Time excluded
 };
 
 // ----------------------------------------------------------------------------- : FunctionProfile
@@ -75,13 +75,15 @@ private:
 class FunctionProfile : public IntrusivePtrBase<FunctionProfile> {
 public:
   FunctionProfile(const String& name)
-    : name(name), time_ticks(0), time_ticks_max(0), calls(0)
+    : name(name), time_ticks(0), time_ticks_max(0), calls(0), memo_hits(0), memo_misses(0)
   {}
 
   String      name;
   ProfileTime time_ticks;
   ProfileTime time_ticks_max;
   int         calls;
+  int         memo_hits;   ///< Number of calls with a memoized result
+  int         memo_misses; ///< Number of calls that could be memoized, but were not
   
   /// for each id, called children
   /** we (ab)use the fact that all pointers are even to store both pointers and ids */
@@ -94,6 +96,8 @@ public:
   inline double total_time() const { return time_ticks / (double)timer_resolution(); }
   inline double avg_time() const { return total_time() / calls; }
   inline double max_time() const { return time_ticks_max / (double)timer_resolution(); }
+  /// Fraction of memoizable calls that used a memoized result
+  inline double memo_hit_rate() const { return memo_hits / (double)max(1, memo_hits + memo_misses); }
 };
 
 /// The root profile
@@ -118,9 +122,11 @@ public:
   Profiler(Timer& timer, void* function_object, const String& function_name);
   /// Log the fact that the function is left
   ~Profiler();
+  /// The profile of the function we are currently in
+  static inline FunctionProfile& current() { return *function; }
 private:
   Timer&                  timer;
-  static FunctionProfile* function; ///< function we are in
+  static thread_local FunctionProfile* function; ///< function we are in, other threads than the main thread are not shown
   FunctionProfile*        parent;
 };
 
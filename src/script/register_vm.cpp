@@ -0,0 +1,526 @@
+//+----------------------------------------------------------------------------+
+//| Description:  Magic Set Editor - Program to make Magic (tm) cards          |
+//| Copyright:    (C) Twan van Laarhoven and the other MSE developers          |
+//| License:      GNU General Public License 2 or later (see file COPYING)     |
+//+----------------------------------------------------------------------------+
+
+// ----------------------------------------------------------------------------- : Includes
+
+#include <util/prec.hpp>
+#include <script/register_vm.hpp>
+#include <script/context.hpp>
+#include <script/to_value.hpp>
+#include <script/profiler.hpp>
+#include <util/error.hpp>
+
+// ----------------------------------------------------------------------------- : Engine selection
+
+ScriptEngine script_engine = SCRIPT_ENGINE_STACK;
+
+bool parse_script_engine(const String& name, ScriptEngine& out) {
+  if (name == _("stack")) {
+    out = SCRIPT_ENGINE_STACK;
+  } else if (name == _("register")) {
+    out = SCRIPT_ENGINE_REGISTER;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+String script_engine_name(ScriptEngine engine) {
+  return engine == SCRIPT_ENGINE_REGISTER ? _("register") : _("stack");
+}
+
+// ----------------------------------------------------------------------------- : Slot
+
+const ScriptValueP& Slot::box() {
+  switch (type) {
+    case SLOT_INT:    boxed = to_script(i); break;
+    case SLOT_DOUBLE: boxed = to_script(d); break;
+    case SLOT_BOOL:   boxed = to_script(b); break;
+    case SLOT_BOXED:  return boxed;
+  }
+  type = SLOT_BOXED;
+  return boxed;
+}
+
+SlotType Slot::unbox() {
+  if (type == SLOT_BOXED) {
+    // objects that only look like numbers keep their members, and their behaviour in 'or else'
+    if (!boxed || !is_plain_number(*boxed)) return SLOT_BOXED;
+    switch (boxed->type()) {
+      case SCRIPT_INT:    setInt(boxed->toInt());       break;
+      case SCRIPT_DOUBLE: setDouble(boxed->toDouble()); break;
+      case SCRIPT_BOOL:   setBool(boxed->toBool());     break;
+      default:            return SLOT_BOXED;
+    }
+    boxed.reset();
+  }
+  return type;
+}
+
+// ----------------------------------------------------------------------------- : Compiling
+
+unique_ptr<RegisterCode> RegisterCode::compile(const Script& script) {
+  const vector<Instruction>& instrs = script.instructions;
+  size_t n = instrs.size();
+  if (n == 0) return nullptr;
+  // Determine the stack depth before each instruction.
+  // Scripts from the parser are structured, so every position is reached with a single depth;
+  // if that is not the case we give up, and the stack engine is used instead.
+  vector<int> depth(n + 1, -1);
+  vector<size_t> todo;
+  int max_depth = 0;
+  auto reach = [&](size_t pos, int d) {
+    if (pos > n || d < 0) return false;
+    if (depth[pos] == -1) {
+      depth[pos] = d;
+      max_depth = max(max_depth, d);
+      if (pos < n) todo.push_back(pos);
+      return true;
+    }
+    return depth[pos] == d;
+  };
+  reach(0, 0);
+  while (!todo.empty()) {
+    size_t pos = todo.back(); todo.pop_back();
+    Instruction i = instrs[pos];
+    int d    = depth[pos];
+    int data = (int)i.data;
+    bool ok  = false;
+    switch (i.instr) {
+      case I_NOP:
+        ok = reach(pos + 1, d); break;
+      case I_PUSH_CONST: case I_GET_VAR:
+        ok = reach(pos + 1, d + 1); break;
+      case I_DUP:
+        ok = d >= data + 1 && reach(pos + 1, d + 1); break;
+      case I_JUMP:
+        ok = reach(i.data, d); break;
+      case I_JUMP_IF_NOT:
+        ok = d >= 1 && reach(pos + 1, d - 1) && reach(i.data, d - 1); break;
+      case I_JUMP_SC_AND: case I_JUMP_SC_OR:
+        ok = d >= 1 && reach(pos + 1, d - 1) && reach(i.data, d); break;
+      case I_SET_VAR: case I_MEMBER_C: case I_UNARY:
+        ok = d >= 1 && reach(pos + 1, d); break;
+      case I_LOOP:
+        ok = d >= 2 && reach(pos + 1, d + 1) && reach(i.data, d - 1); break;
+      case I_LOOP_WITH_KEY:
+        ok = d >= 2 && reach(pos + 1, d + 2) && reach(i.data, d - 1); break;
+      case I_MAKE_OBJECT:
+        ok = d >= 2 * data && reach(pos + 1, d - 2 * data + 1); break;
+      case I_CALL: case I_TAILCALL: case I_CLOSURE:
+        // the argument names follow the instruction
+        ok = d >= data + 1 && reach(pos + 1 + data, d - data); break;
+      case I_BINARY:
+        ok = d >= 2 && reach(pos + 1, d - 1); break;
+      case I_TERNARY:
+        ok = d >= 3 && reach(pos + 1, d - 2); break;
+      case I_QUATERNARY:
+        ok = d >= 4 && reach(pos + 1, d - 3); break;
+      case I_POP:
+        ok = d >= 1 && reach(pos + 1, d - 1); break;
+    }
+    if (!ok) return nullptr;
+  }
+  // the script should leave exactly one value, the result
+  if (depth[n] != 1) return nullptr;
+
+  unique_ptr<RegisterCode> code = make_unique<RegisterCode>();
+  code->registers = (unsigned int)max_depth;
+  code->instructions.resize(n);
+  for (size_t pos = 0 ; pos < n ; ++pos) {
+    code->instructions[pos].instr = instrs[pos];
+    code->instructions[pos].reg   = depth[pos] < 0 ? 0 : (unsigned int)depth[pos]; // unreachable instructions are never executed
+  }
+  // constants
+  code->constants.resize(script.constants.size());
+  code->names.resize(script.constants.size());
+  for (size_t c = 0 ; c < script.constants.size() ; ++c) {
+    code->constants[c].set(script.constants[c]);
+    code->constants[c].unbox();
+  }
+  try {
+    FOR_EACH_CONST(i, instrs) {
+      if (i.instr == I_MEMBER_C) {
+        code->names[i.data] = script.constants[i.data]->toString();
+      }
+    }
+  } catch (const Error&) {
+    return nullptr; // let the stack engine report the error when it is executed
+  }
+  return code;
+}
+
+const RegisterCode* Script::registerCode() const {
+  RegisterCode* code = register_code.load(std::memory_order_acquire);
+  if (!code) {
+    unique_ptr<RegisterCode> new_code = RegisterCode::compile(*this);
+    if (!new_code) new_code = make_unique<RegisterCode>(); // remember that compilation failed
+    if (register_code.compare_exchange_strong(code, new_code.get())) {
+      code = new_code.release();
+    } // otherwise another thread beat us to it, and code now holds its result
+  }
+  if (code->instructions.size() != instructions.size()) {
+    return nullptr; // compilation failed, or the script was modified afterwards
+  }
+  return code;
+}
+
+// ----------------------------------------------------------------------------- : Typed instructions
+
+// Defined in context.cpp
+void instrUnary     (UnaryInstructionType      i, ScriptValueP& a);
+void instrBinary    (BinaryInstructionType     i, ScriptValueP& a, const ScriptValueP& b);
+void instrTernary   (TernaryInstructionType    i, ScriptValueP& a, const ScriptValueP& b, const ScriptValueP& c);
+void instrQuaternary(QuaternaryInstructionType i, ScriptValueP& a, const ScriptValueP& b, const ScriptValueP& c, const ScriptValueP& d);
+// Defined in value.cpp
+bool approx_equal(double a, double b);
+
+inline bool slot_to_bool(Slot& s) {
+  return s.type == SLOT_BOOL ? s.b : s.box()->toBool();
+}
+
+// Perform a unary instruction on unboxed values, store the result in a
+// Returns false if the values are not of the right type, in which case nothing is changed
+static bool instrUnaryTyped(UnaryInstructionType i, Slot& a) {
+  if (i == I_ITERATOR_C) return false;
+  SlotType at = a.unbox();
+  if (i == I_NEGATE && at == SLOT_INT) {
+    a.i = -a.i;
+  } else if (i == I_NEGATE && at == SLOT_DOUBLE) {
+    a.d = -a.d;
+  } else if (i == I_NOT && at == SLOT_BOOL) {
+    a.b = !a.b;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+// Perform a binary instruction on unboxed values, store the result in a.
+// Returns false if the values are not of the right type, in which case nothing is changed.
+// The results must be exactly the same as those of instrBinary.
+static bool instrBinaryTyped(BinaryInstructionType i, Slot& a, Slot& b) {
+  if (i == I_MEMBER || i == I_ITERATOR_R) return false;
+  SlotType at = a.unbox();
+  if (i == I_OR_ELSE && at != SLOT_BOXED) return true; // a is not an error
+  SlotType bt = b.unbox();
+  if (at == SLOT_BOXED || bt == SLOT_BOXED) return false;
+  bool ints = at == SLOT_INT && bt == SLOT_INT;
+  bool nums = (at == SLOT_INT || at == SLOT_DOUBLE) && (bt == SLOT_INT || bt == SLOT_DOUBLE);
+  bool bools = at == SLOT_BOOL && bt == SLOT_BOOL;
+  double ad = at == SLOT_INT ? a.i : a.d;
+  double bd = bt == SLOT_INT ? b.i : b.d;
+  switch (i) {
+    case I_ADD:
+      if (ints)      a.setInt(a.i + b.i);
+      else if (nums) a.setDouble(ad + bd);
+      else return false;
+      return true;
+    case I_SUB:
+      if (ints)      a.setInt(a.i - b.i);
+      else if (nums) a.setDouble(ad - bd);
+      else return false;
+      return true;
+    case I_MUL:
+      if (ints)      a.setInt(a.i * b.i);
+      else if (nums) a.setDouble(ad * bd);
+      else return false;
+      return true;
+    case I_FDIV:
+      if (nums) a.setDouble(ad / bd);
+      else return false;
+      return true;
+    case I_DIV:
+      if (ints)      a.setInt(a.i / b.i);
+      else if (nums) a.setInt((int)(ad / bd));
+      else return false;
+      return true;
+    case I_MOD:
+      if (ints)      a.setInt(a.i % b.i);
+      else if (nums) a.setDouble(fmod(ad, bd));
+      else return false;
+      return true;
+    case I_POW:
+      if (!nums) return false;
+      if (bt == SLOT_INT) {
+        int bi = b.i;
+        if (at == SLOT_DOUBLE) {
+          double aa = a.d;
+          if      (bi == 0) a.setInt(1);
+          else if (bi == 1) a.setDouble(aa);
+          else if (bi == 2) a.setDouble(aa * aa);
+          else if (bi == 3) a.setDouble(aa * aa * aa);
+          else              a.setDouble(pow(aa,bi));
+        } else {
+          int aa = a.i;
+          if      (bi == 0) a.setInt(1);
+          else if (bi == 1) a.setInt(aa);
+          else if (bi == 2) a.setInt(aa * aa);
+          else if (bi == 3) a.setInt(aa * aa * aa);
+          else              a.setDouble(pow((double)aa,bi));
+        }
+      } else {
+        a.setDouble(pow(ad, bd));
+      }
+      return true;
+    case I_AND: if (!bools) return false; a.setBool(a.b && b.b); return true;
+    case I_OR:  if (!bools) return false; a.setBool(a.b || b.b); return true;
+    case I_XOR: if (!bools) return false; a.setBool(a.b != b.b); return true;
+    case I_EQ: case I_NEQ: {
+      bool eq;
+      if      (ints)  eq = a.i == b.i;
+      else if (bools) eq = a.b == b.b;
+      else if (nums)  eq = approx_equal(ad, bd);
+      else return false;
+      a.setBool(i == I_EQ ? eq : !eq);
+      return true;
+    }
+    case I_LT:
+      if (ints)      a.setBool(a.i < b.i);
+      else if (nums) a.setBool(ad < bd);
+      else return false;
+      return true;
+    case I_GT:
+      if (ints)      a.setBool(a.i > b.i);
+      else if (nums) a.setBool(ad > bd);
+      else return false;
+      return true;
+    case I_LE:
+      if (ints)      a.setBool(a.i <= b.i);
+      else if (nums) a.setBool(ad <= bd);
+      else return false;
+      return true;
+    case I_GE:
+      if (ints)      a.setBool(a.i >= b.i);
+      else if (nums) a.setBool(ad >= bd);
+      else return false;
+      return true;
+    case I_MIN:
+      if (ints)      a.setInt(min(a.i, b.i));
+      else if (nums) a.setDouble(min(ad, bd));
+      else return false;
+      return true;
+    case I_MAX:
+      if (ints)      a.setInt(max(a.i, b.i));
+      else if (nums) a.setDouble(max(ad, bd));
+      else return false;
+      return true;
+    default:
+      return false;
+  }
+}
+
+// ----------------------------------------------------------------------------- : Evaluating
+
+ScriptValueP Context::evalRegister(const Script& script, const RegisterCode& code, bool useScope) {
+  // Registers for this call.
+  // Frames are reused by later calls at the same depth. The vector of frames can grow during
+  // nested calls, but the registers themselves don't move.
+  unsigned int frame = register_depth++;
+  if (register_frames.size() <= frame) register_frames.resize(frame + 1);
+  if (register_frames[frame].size() < code.registers) register_frames[frame].resize(code.registers);
+  Slot* r = register_frames[frame].data();
+
+  size_t scope = useScope ? openScope() : 0;
+  try {
+    const RegisterCode::Instr* begin = &code.instructions[0];
+    const RegisterCode::Instr* instr = begin;
+    const RegisterCode::Instr* end   = begin + code.instructions.size();
+
+    while (instr < end) {
+      Instruction i = instr->instr;
+      Slot* top = r + instr->reg; // first free register
+      ++instr;
+      // If a scope is created, destroy it at end of block.
+      unique_ptr<LocalScope> new_scope;
+
+      switch (i.instr) {
+        case I_NOP: break;
+        case I_PUSH_CONST: {
+          *top = code.constants[i.data];
+          break;
+        }
+        case I_JUMP: {
+          instr = begin + i.data;
+          break;
+        }
+        case I_JUMP_IF_NOT: {
+          if (!slot_to_bool(top[-1])) instr = begin + i.data;
+          break;
+        }
+        case I_JUMP_SC_AND: {
+          if (!slot_to_bool(top[-1])) instr = begin + i.data;
+          break;
+        }
+        case I_JUMP_SC_OR: {
+          if (slot_to_bool(top[-1])) instr = begin + i.data;
+          break;
+        }
+
+        case I_GET_VAR: {
+          noteRead((Variable)i.data);
+          const ScriptValueP& value = variables[i.data].value;
+          if (!value) throw ScriptErrorNoVariable(variable_to_string((Variable)i.data));
+          top->set(value);
+          break;
+        }
+        case I_SET_VAR: {
+          setVariable((Variable)i.data, top[-1].box());
+          break;
+        }
+
+        case I_MEMBER_C: {
+          top[-1].set(top[-1].box()->getMember(code.names[i.data]));
+          break;
+        }
+        case I_LOOP: {
+          ScriptValueP val = top[-2].box()->next();
+          if (val) {
+            top->set(std::move(val));
+          } else {
+            top[-2] = std::move(top[-1]); // remove iterator
+            instr = begin + i.data;
+          }
+          break;
+        }
+        case I_LOOP_WITH_KEY: {
+          ScriptValueP key;
+          ScriptValueP val = top[-2].box()->next(&key);
+          if (val) {
+            top[0].set(std::move(val));
+            top[1].set(std::move(key));
+          } else {
+            top[-2] = std::move(top[-1]); // remove iterator
+            instr = begin + i.data;
+          }
+          break;
+        }
+        case I_MAKE_OBJECT: {
+          Slot* first = top - 2 * i.data;
+          ScriptCustomCollectionP ret(new ScriptCustomCollection());
+          for (unsigned int j = 0 ; j < i.data ; ++j) {
+            const ScriptValueP& key = first[2 * j].box();
+            const ScriptValueP& val = first[2 * j + 1].box();
+            if (key != script_nil) { // valid key
+              ret->key_value[key->toString()] = val;
+            } else {
+              ret->value.push_back(val);
+            }
+          }
+          first->set(ScriptValueP(ret));
+          break;
+        }
+
+        case I_CALL:
+          new_scope.reset(new LocalScope(*this)); //new scope
+        case I_TAILCALL: {
+          // prepare arguments, their names are in the I_NOP instructions that follow
+          for (unsigned int j = 0 ; j < i.data ; ++j) {
+            setVariable((Variable)instr[i.data - j - 1].instr.data, top[-1 - (int)j].box());
+          }
+          instr += i.data; // skip arguments
+          Slot& fun = top[-1 - (int)i.data];
+          // position in the original script, for error messages
+          const Instruction* instr_orig = &script.instructions[0] + (instr - begin);
+          try {
+            #if USE_SCRIPT_PROFILING
+              Timer timer;
+              const Instruction* instr_bt = script.backtraceSkip(instr_orig - i.data - 2, i.data);
+              Variable function = instr_bt && instr_bt->instr == I_GET_VAR
+                                ? (Variable)instr_bt->data
+                                : (Variable)-1;
+              Profiler prof(timer, function);
+            #endif
+            fun.set(callFunction(fun.box(), new_scope.get()));
+          } catch (const Error& e) {
+            // try to determine what named function was called, see Context::eval
+            const Instruction* instr_bt = script.backtraceSkip(instr_orig - i.data - 2, i.data);
+            if (instr_bt) {
+              throw ScriptError(_ERROR_2_("in function", e.what(), script.instructionName(instr_bt)));
+            } else {
+              throw e; // rethrow
+            }
+          }
+          break;
+        }
+
+        case I_CLOSURE: {
+          Slot& fun = top[-1 - (int)i.data];
+          intrusive_ptr<ScriptClosure> closure(new ScriptClosure(fun.box()));
+          for (unsigned int j = 0 ; j < i.data ; ++j) {
+            closure->addBinding((Variable)instr[i.data - j - 1].instr.data, top[-1 - (int)j].box());
+          }
+          instr += i.data; // skip arguments
+          ScriptValueP simplified = closure->simplify();
+          if (simplified) {
+            fun.set(std::move(simplified));
+          } else {
+            fun.set(ScriptValueP(closure));
+          }
+          break;
+        }
+
+        case I_UNARY: {
+          Slot& a = top[-1];
+          if (!instrUnaryTyped(i.instr1, a)) {
+            a.box();
+            instrUnary(i.instr1, a.boxed);
+          }
+          break;
+        }
+        case I_BINARY: {
+          Slot& a = top[-2];
+          Slot& b = top[-1];
+          if (!instrBinaryTyped(i.instr2, a, b)) {
+            a.box();
+            instrBinary(i.instr2, a.boxed, b.box());
+          }
+          break;
+        }
+        case I_TERNARY: {
+          Slot& a = top[-3];
+          a.box();
+          instrTernary(i.instr3, a.boxed, top[-2].box(), top[-1].box());
+          break;
+        }
+        case I_QUATERNARY: {
+          Slot& a = top[-4];
+          a.box();
+          instrQuaternary(i.instr4, a.boxed, top[-3].box(), top[-2].box(), top[-1].box());
+          break;
+        }
+        case I_POP: {
+          top[-1].boxed.reset();
+          break;
+        }
+        case I_DUP: {
+          *top = top[-1 - (int)i.data];
+          break;
+        }
+      }
+    }
+
+    // Function return
+    if (useScope) closeScope(scope);
+    ScriptValueP result = r[0].box();
+    releaseRegisters(code);
+    return result;
+
+  } catch (...) {
+    // cleanup after an exception
+    if (useScope) closeScope(scope);
+    releaseRegisters(code);
+    throw;
+  }
+}
+
+void Context::releaseRegisters(const RegisterCode& code) {
+  register_depth -= 1;
+  Slot* r = register_frames[register_depth].data();
+  for (unsigned int j = 0 ; j < code.registers ; ++j) {
+    r[j].boxed.reset();
+  }
+}
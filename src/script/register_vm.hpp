@@ -0,0 +1,93 @@
+//+----------------------------------------------------------------------------+
+//| Description:  Magic Set Editor - Program to make Magic (tm) cards          |
+//| Copyright:    (C) Twan van Laarhoven and the other MSE developers          |
+//| License:      GNU General Public License 2 or later (see file COPYING)     |
+//+----------------------------------------------------------------------------+
+
+#pragma once
+
+// ----------------------------------------------------------------------------- : Includes
+
+#include <util/prec.hpp>
+#include <script/script.hpp>
+
+// ----------------------------------------------------------------------------- : Engine selection
+
+/// The ways in which Context::eval can execute a script
+enum ScriptEngine
+{  SCRIPT_ENGINE_STACK     ///< Interpret the instructions on a stack of boxed values
+,  SCRIPT_ENGINE_REGISTER  ///< Use the RegisterCode of a script, with unboxed registers
+};
+
+/// The engine used by Context::eval
+/** Can be changed at any time, to compare the output and speed of the engines.
+ *  Scripts that can not be compiled to RegisterCode always use the stack engine.
+ */
+extern ScriptEngine script_engine;
+
+/// Parse the name of a script engine, returns false if the name is unknown
+bool parse_script_engine(const String& name, ScriptEngine& out);
+/// Name of a script engine
+String script_engine_name(ScriptEngine engine);
+
+// ----------------------------------------------------------------------------- : Slot
+
+/// Is a value a plain integer, double or boolean? (defined in value.cpp)
+/** Other values can have the type of a number, such as objects with a number as their default member */
+bool is_plain_number(const ScriptValue& value);
+
+/// Type of the value in a Slot
+enum SlotType
+{  SLOT_BOXED   ///< value is in Slot::boxed
+,  SLOT_INT
+,  SLOT_DOUBLE
+,  SLOT_BOOL
+};
+
+/// A register of the register machine
+/** Integers, doubles and booleans are stored unboxed, so arithmetic and comparisons
+ *  don't have to allocate ScriptValues or touch reference counts.
+ */
+struct Slot {
+  SlotType type = SLOT_BOXED;
+  union {
+    int    i;
+    double d;
+    bool   b;
+  };
+  ScriptValueP boxed; ///< Only used if type == SLOT_BOXED
+
+  inline void set(const ScriptValueP& v)  { type = SLOT_BOXED;  boxed = v; }
+  inline void set(ScriptValueP&& v)       { type = SLOT_BOXED;  boxed = std::move(v); }
+  inline void setInt(int v)               { type = SLOT_INT;    i = v; }
+  inline void setDouble(double v)         { type = SLOT_DOUBLE; d = v; }
+  inline void setBool(bool v)             { type = SLOT_BOOL;   b = v; }
+
+  /// Get the value as a ScriptValue, the slot itself keeps the boxed value
+  const ScriptValueP& box();
+  /// Unbox a plain int/double/bool ScriptValue in place
+  /** Returns the type of the unboxed value, or SLOT_BOXED for other values */
+  SlotType unbox();
+};
+
+// ----------------------------------------------------------------------------- : RegisterCode
+
+/// A script compiled for the register machine
+/** Every stack position of the stack machine becomes a register. Because the stack depth at
+ *  each instruction is known statically, the operands of an instruction are fixed registers,
+ *  so no pushing and popping is needed at runtime.
+ */
+class RegisterCode {
+public:
+  /// Compile a script, returns nullptr if the stack depth can not be determined statically
+  static unique_ptr<RegisterCode> compile(const Script& script);
+
+  struct Instr {
+    Instruction  instr; ///< The original instruction
+    unsigned int reg;   ///< The first free register before executing this instruction (i.e. the stack depth)
+  };
+  vector<Instr>  instructions; ///< One per instruction of the script, so addresses are the same
+  vector<Slot>   constants;    ///< Constants of the script, unboxed where possible
+  vector<String> names;        ///< Constants converted to strings, for I_MEMBER_C
+  unsigned int   registers = 0;///< Number of registers needed
+};
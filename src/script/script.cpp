@@ -10,6 +10,7 @@
 #include <script/script.hpp>
 #include <script/context.hpp>
 #include <script/to_value.hpp>
+#include <script/register_vm.hpp>
 #include <util/error.hpp>
 
 // ----------------------------------------------------------------------------- : Variables
@@ -82,6 +83,10 @@ void init_script_variables() {
 
 // ----------------------------------------------------------------------------- : Script
 
+Script::~Script() {
+  delete register_code.load();
+}
+
 ScriptType Script::type() const {
   return SCRIPT_FUNCTION;
 }
@@ -150,7 +155,7 @@ Addr Script::getLabel() const {
   return Addr{ (unsigned int)instructions.size() };
 }
 
-#ifdef _DEBUG // debugging
+// ----------------------------------------------------------------------------- : Debugging
 
 String Script::dumpScript() const {
   String ret;
@@ -194,8 +199,10 @@ String Script::dumpInstr(unsigned int pos, Instruction i) const {
         case I_ADD:      ret += _("+");      break;
         case I_SUB:      ret += _("-");      break;
         case I_MUL:      ret += _("*");      break;
-        case I_DIV:      ret += _("/");      break;
+        case I_FDIV:     ret += _("/");      break;
+        case I_DIV:      ret += _("div");    break;
         case I_MOD:      ret += _("mod");    break;
+        case I_POW:      ret += _("^");      break;
         case I_AND:      ret += _("and");    break;
         case I_OR:      ret += _("or");      break;
         case I_XOR:      ret += _("xor");    break;
@@ -205,6 +212,8 @@ String Script::dumpInstr(unsigned int pos, Instruction i) const {
         case I_GT:      ret += _(">");      break;
         case I_LE:      ret += _("<=");      break;
         case I_GE:      ret += _(">=");      break;
+        case I_MIN:      ret += _("min");    break;
+        case I_MAX:      ret += _("max");    break;
         case I_OR_ELSE:    ret += _("or else");  break;
       }
       break;
@@ -214,7 +223,7 @@ String Script::dumpInstr(unsigned int pos, Instruction i) const {
       }
       break;
     case I_QUATERNARY:  ret += _("quaternary\t");
-      switch (i.instr3) {
+      switch (i.instr4) {
         case I_RGBA:    ret += _("rgba");    break;
       }
       break;
@@ -241,8 +250,6 @@ String Script::dumpInstr(unsigned int pos, Instruction i) const {
   return ret;
 }
 
-#endif
-
 
 // ----------------------------------------------------------------------------- : Backtracing
 
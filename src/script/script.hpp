@@ -12,6 +12,7 @@
 #include <script/value.hpp>
 
 DECLARE_POINTER_TYPE(Script);
+class RegisterCode;
 
 // ----------------------------------------------------------------------------- : Instructions
 
@@ -169,6 +170,7 @@ void init_script_variables();
  */
 class Script : public ScriptValue {
 public:
+  ~Script();
   
   ScriptType type() const override;
   String typeName() const override;
@@ -204,12 +206,20 @@ public:
   String dumpInstr(unsigned int pos, Instruction i) const;
 
   ScriptValueP eval(Context& ctx, bool openScope = true) const override;
+  
+  /// The script compiled for the register engine, compiled on first use
+  /** Returns nullptr if the script can not be compiled.
+   *  The script should not be modified after this function is called.
+   */
+  const RegisterCode* registerCode() const;
 
 private:
   /// Data of the instructions that make up this script
   vector<Instruction>  instructions;
   /// Constant values that can be referred to from the script
   vector<ScriptValueP> constants;
+  /// Cached result of registerCode()
+  mutable std::atomic<RegisterCode*> register_code{nullptr};
   
   /// Do a backtrace for error messages.
   /** Starting from instr, move backwards until the nett stack effect
@@ -221,5 +231,6 @@ private:
   String instructionName(const Instruction* instr) const;
   
   friend class Context;
+  friend class RegisterCode;
 };
 
@@ -0,0 +1,268 @@
+//+----------------------------------------------------------------------------+
+//| Description:  Magic Set Editor - Program to make Magic (tm) cards          |
+//| Copyright:    (C) Twan van Laarhoven and the other MSE developers          |
+//| License:      GNU General Public License 2 or later (see file COPYING)     |
+//+----------------------------------------------------------------------------+
+
+// ----------------------------------------------------------------------------- : Includes
+
+#include <util/prec.hpp>
+#include <script/script_cache.hpp>
+#include <script/parser.hpp>
+#include <script/optimizer.hpp>
+#include <script/to_value.hpp>
+#include <util/io/package_manager.hpp>
+#include <data/settings.hpp>
+#include <util/version.hpp>
+#include <wx/wfstream.h>
+#include <wx/mstream.h>
+#include <wx/datstrm.h>
+
+IMPLEMENT_DYNAMIC_ARG(ScriptCache*, loading_script_cache, nullptr);
+
+extern ScriptValueP script_warning;
+extern ScriptValueP script_warning_if_neq;
+
+/// Version of the file format, change when the instructions or constants change
+const int SCRIPT_CACHE_FORMAT = 1;
+
+// ----------------------------------------------------------------------------- : Writing scripts
+
+enum ConstantTag
+{  CONST_NIL
+,  CONST_INT
+,  CONST_BOOL
+,  CONST_DOUBLE
+,  CONST_STRING
+,  CONST_COLOR
+,  CONST_SCRIPT
+,  CONST_WARNING
+,  CONST_WARNING_IF_NEQ
+};
+
+/// Does the data of an instruction refer to a variable?
+/** Variable numbers differ between runs, so variables are stored by name */
+static inline bool has_variable(InstructionType t) {
+  return t == I_GET_VAR || t == I_SET_VAR || t == I_NOP;
+}
+
+static bool write_script(wxDataOutputStream& out, Script& script);
+
+static bool write_constant(wxDataOutputStream& out, const ScriptValueP& c) {
+  switch (c->type()) {
+    case SCRIPT_NIL:    out.Write8(CONST_NIL); break;
+    case SCRIPT_INT:    out.Write8(CONST_INT);    out.Write32((wxUint32)c->toInt()); break;
+    case SCRIPT_BOOL:   out.Write8(CONST_BOOL);   out.Write8(c->toBool()); break;
+    case SCRIPT_DOUBLE: {
+      double d = c->toDouble();
+      wxUint64 bits;
+      memcpy(&bits, &d, sizeof(bits));
+      out.Write8(CONST_DOUBLE);
+      out.Write64(bits);
+      break;
+    }
+    case SCRIPT_STRING: out.Write8(CONST_STRING); out.WriteString(c->toString()); break;
+    case SCRIPT_COLOR:  out.Write8(CONST_COLOR);  out.Write32(c->toColor().packed); break;
+    case SCRIPT_FUNCTION: {
+      if (c == script_warning) {
+        out.Write8(CONST_WARNING);
+      } else if (c == script_warning_if_neq) {
+        out.Write8(CONST_WARNING_IF_NEQ);
+      } else if (Script* script = dynamic_cast<Script*>(c.get())) {
+        out.Write8(CONST_SCRIPT);
+        return write_script(out, *script);
+      } else {
+        return false;
+      }
+      break;
+    }
+    default:
+      return false; // can't store this value
+  }
+  return true;
+}
+
+static bool write_script(wxDataOutputStream& out, Script& script) {
+  vector<Instruction>& instrs = script.getInstructions();
+  // variables
+  map<unsigned int, unsigned int> variable_index;
+  vector<unsigned int> variables;
+  FOR_EACH(i, instrs) {
+    if (has_variable(i.instr) && variable_index.insert(make_pair(i.data, (unsigned int)variables.size())).second) {
+      variables.push_back(i.data);
+    }
+  }
+  out.Write32((wxUint32)variables.size());
+  FOR_EACH(v, variables) {
+    out.WriteString(variable_to_string((Variable)v));
+  }
+  // instructions
+  out.Write32((wxUint32)instrs.size());
+  FOR_EACH(i, instrs) {
+    unsigned int data = has_variable(i.instr) ? variable_index[i.data] : i.data;
+    out.Write32((wxUint32)i.instr | (wxUint32)data << 6);
+  }
+  // constants
+  vector<ScriptValueP>& constants = script.getConstants();
+  out.Write32((wxUint32)constants.size());
+  FOR_EACH(c, constants) {
+    if (!write_constant(out, c)) return false;
+  }
+  return true;
+}
+
+// ----------------------------------------------------------------------------- : Reading scripts
+
+static ScriptP read_script(wxDataInputStream& in, wxInputStream& stream, int depth);
+
+static ScriptValueP read_constant(wxDataInputStream& in, wxInputStream& stream, int depth) {
+  switch (in.Read8()) {
+    case CONST_NIL:    return script_nil;
+    case CONST_INT:    return to_script((int)in.Read32());
+    case CONST_BOOL:   return to_script(in.Read8() != 0);
+    case CONST_DOUBLE: {
+      wxUint64 bits = in.Read64();
+      double d;
+      memcpy(&d, &bits, sizeof(d));
+      return to_script(d);
+    }
+    case CONST_STRING: return to_script(in.ReadString());
+    case CONST_COLOR: {
+      Color c;
+      c.packed = in.Read32();
+      return to_script(c);
+    }
+    case CONST_SCRIPT:         return read_script(in, stream, depth + 1);
+    case CONST_WARNING:        return script_warning;
+    case CONST_WARNING_IF_NEQ: return script_warning_if_neq;
+    default:                   return ScriptValueP();
+  }
+}
+
+static ScriptP read_script(wxDataInputStream& in, wxInputStream& stream, int depth) {
+  if (depth > 100) return ScriptP();
+  ScriptP script = make_intrusive<Script>();
+  // variables
+  size_t variable_count = in.Read32();
+  if (!stream.IsOk() || variable_count > (size_t)stream.GetLength()) return ScriptP();
+  vector<Variable> variables;
+  for (size_t i = 0 ; i < variable_count ; ++i) {
+    variables.push_back(string_to_variable(in.ReadString()));
+  }
+  // instructions
+  size_t instr_count = in.Read32();
+  if (!stream.IsOk() || instr_count > (size_t)stream.GetLength()) return ScriptP();
+  vector<Instruction>& instrs = script->getInstructions();
+  instrs.resize(instr_count);
+  FOR_EACH(i, instrs) {
+    wxUint32 x = in.Read32();
+    i.instr = (InstructionType)(x & 63);
+    i.data  = x >> 6;
+    if (has_variable(i.instr)) {
+      if (i.data >= variables.size()) return ScriptP();
+      i.data = variables[i.data];
+    }
+  }
+  // constants
+  size_t constant_count = in.Read32();
+  if (!stream.IsOk() || constant_count > (size_t)stream.GetLength()) return ScriptP();
+  vector<ScriptValueP>& constants = script->getConstants();
+  for (size_t i = 0 ; i < constant_count ; ++i) {
+    ScriptValueP c = read_constant(in, stream, depth);
+    if (!c) return ScriptP();
+    constants.push_back(c);
+  }
+  FOR_EACH(i, instrs) {
+    if ((i.instr == I_PUSH_CONST || i.instr == I_MEMBER_C) && i.data >= constants.size()) return ScriptP();
+  }
+  return stream.IsOk() ? script : ScriptP();
+}
+
+// ----------------------------------------------------------------------------- : ScriptCache
+
+ScriptCache::ScriptCache(const Packaged& package)
+  : hits(0), misses(0)
+  , changed(false)
+{
+  modified = PackageHeaderIndex::modificationTime(package.absoluteFilename());
+  if (modified.empty()) return;
+  // one file per package
+  String dir = user_settings_dir() + _("cache");
+  if (!wxDirExists(dir)) wxMkdir(dir);
+  dir += _("/scripts");
+  if (!wxDirExists(dir)) wxMkdir(dir);
+  size_t hash = std::hash<std::wstring>()(package.absoluteFilename().ToStdWstring());
+  filename = dir + _("/") + package.relativeFilename() + String::Format(_("-%llx"), (unsigned long long)hash);
+  load();
+}
+
+void ScriptCache::load() {
+  if (!wxFileExists(filename)) return;
+  wxFileInputStream stream(filename);
+  if (!stream.IsOk()) return;
+  wxDataInputStream in(stream);
+  // the cache is only valid for the same package and the same program
+  if (in.ReadString() != _("MSE script cache") || (int)in.Read32() != SCRIPT_CACHE_FORMAT) return;
+  if (in.ReadString() != app_version.toString() || in.ReadString() != modified) return;
+  if ((in.Read8() != 0) != optimize_scripts) return;
+  size_t count = in.Read32();
+  for (size_t i = 0 ; i < count && stream.IsOk() ; ++i) {
+    String key = in.ReadString();
+    size_t size = in.Read32();
+    if (!stream.IsOk() || size > (size_t)stream.GetLength()) break;
+    vector<char>& data = scripts[key];
+    data.resize(size);
+    in.Read8((wxUint8*)data.data(), size);
+  }
+  if (!stream.IsOk()) scripts.clear(); // damaged file
+}
+
+ScriptP ScriptCache::parse(const String& source, Packaged* package, bool string_mode, vector<ScriptParseError>& errors_out) {
+  if (modified.empty()) return ::parse(source, package, string_mode, errors_out);
+  String key = (string_mode ? _("s") : _("c")) + source;
+  auto it = scripts.find(key);
+  if (it != scripts.end()) {
+    wxMemoryInputStream stream(it->second.data(), it->second.size());
+    wxDataInputStream in(stream);
+    ScriptP script = read_script(in, stream, 0);
+    if (script) {
+      errors_out.clear();
+      ++hits;
+      return script;
+    }
+    scripts.erase(it);
+  }
+  ++misses;
+  ScriptP script = ::parse(source, package, string_mode, errors_out);
+  if (script && errors_out.empty() && source.find(_("include_file")) == String::npos) {
+    // scripts with include_file depend on other files, don't cache them
+    wxMemoryOutputStream stream;
+    wxDataOutputStream out(stream);
+    if (write_script(out, *script)) {
+      vector<char>& data = scripts[key];
+      data.resize((size_t)stream.GetLength());
+      stream.CopyTo(data.data(), data.size());
+      changed = true;
+    }
+  }
+  return script;
+}
+
+void ScriptCache::flush() {
+  if (!changed) return;
+  changed = false;
+  wxFileOutputStream stream(filename);
+  if (!stream.IsOk()) return; // failure is not an error, the scripts will be parsed next time
+  wxDataOutputStream out(stream);
+  out.WriteString(_("MSE script cache"));
+  out.Write32(SCRIPT_CACHE_FORMAT);
+  out.WriteString(app_version.toString());
+  out.WriteString(modified);
+  out.Write8(optimize_scripts);
+  out.Write32((wxUint32)scripts.size());
+  FOR_EACH(s, scripts) {
+    out.WriteString(s.first);
+    out.Write32((wxUint32)s.second.size());
+    out.Write8((const wxUint8*)s.second.data(), s.second.size());
+  }
+}
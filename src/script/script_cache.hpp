@@ -0,0 +1,52 @@
+//+----------------------------------------------------------------------------+
+//| Description:  Magic Set Editor - Program to make Magic (tm) cards          |
+//| Copyright:    (C) Twan van Laarhoven and the other MSE developers          |
+//| License:      GNU General Public License 2 or later (see file COPYING)     |
+//+----------------------------------------------------------------------------+
+
+#pragma once
+
+// ----------------------------------------------------------------------------- : Includes
+
+#include <util/prec.hpp>
+#include <util/dynamic_arg.hpp>
+#include <script/script.hpp>
+
+class Packaged;
+class ScriptParseError;
+
+// ----------------------------------------------------------------------------- : ScriptCache
+
+/// The compiled scripts of a package, stored on disk so they don't have to be parsed again
+/** The instructions and constants of the scripts are stored in a binary file in the cache directory.
+ *  Scripts are identified by their source code, so a changed script is simply not found.
+ *  The whole file is discarded when the package or the program version changes,
+ *  so scripts that are no longer used don't pile up.
+ *
+ *  Scripts that include other files or that have parse errors are not cached,
+ *  neither are scripts with constants that can't be stored.
+ */
+class ScriptCache {
+public:
+  /// Load the cache for a package
+  ScriptCache(const Packaged& package);
+
+  /// Parse a script, or take it from the cache. Like ::parse
+  ScriptP parse(const String& source, Packaged* package, bool string_mode, vector<ScriptParseError>& errors_out);
+  /// Write the cache to disk, if scripts were added
+  void flush();
+
+  size_t hits;   ///< Number of scripts found in the cache
+  size_t misses; ///< Number of scripts that had to be parsed
+
+private:
+  String filename; ///< File the cache is stored in
+  String modified; ///< Modification time of the package, empty if unknown, then nothing is cached
+  unordered_map<String, vector<char>> scripts; ///< Compiled scripts, by string mode and source code
+  bool changed;
+
+  void load();
+};
+
+/// The script cache used for scripts in the package that is being read, if any
+DECLARE_DYNAMIC_ARG(ScriptCache*, loading_script_cache);
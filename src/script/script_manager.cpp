@@ -78,6 +78,7 @@ Context& SetScriptContext::getContext(const CardP& card) {
 
 SetScriptManager::SetScriptManager(Set& set)
   : SetScriptContext(set)
+  , background_updates(false)
   , delay(0)
 {
   // add as an action listener for the set, so we receive actions
@@ -95,6 +96,7 @@ void SetScriptManager::onInit(const StyleSheetP& stylesheet, Context& ctx) {
     // find script dependencies
     initDependencies(ctx, *set.game);
     initDependencies(ctx, *stylesheet);
+    field_rank.clear(); // the dependency graph might have changed
   } catch (const Error& e) {
     handle_error(e);
   }
@@ -141,6 +143,8 @@ void SetScriptManager::initDependencies(Context& ctx, StyleSheet& stylesheet) {
 
 void SetScriptManager::onAction(const Action& action, bool undone) {
   TYPE_CASE(action, ValueAction) {
+    // keywords only have to be expanded again in the edited part of a text
+    WITH_DYNAMIC_ARG(value_being_edited, dynamic_cast<const TextValueAction*>(&action) ? action.valueP.get() : nullptr);
     if (action.card) {
       updateValue(*action.valueP, action.card);
       return;
@@ -172,7 +176,7 @@ void SetScriptManager::onAction(const Action& action, bool undone) {
       FOR_EACH_CONST(step, action.action.steps) {
         const CardP& card = step.item;
         Context& ctx = getContext(card);
-        FOR_EACH(v, card->data) {
+        FOR_EACH(v, card->data()) {
           v->update(ctx);
         }
       }
@@ -244,17 +248,24 @@ void SetScriptManager::updateDelayed() {
     updateAllDependend(set.game->dependent_scripts_keywords);
   }
   delay = 0;
+  updateAllPending();
 }
 
 void SetScriptManager::updateValue(Value& value, const CardP& card) {
   Age starting_age; // the start of the update process
-  deque<ToUpdate> to_update;
+  UpdateQueue to_update;
   // execute script for initial changed value
   value.update(getContext(card));
   #ifdef LOG_UPDATES
     wxLogDebug(_("Start:     %s"), value.fieldP->name);
   #endif
   // update dependent scripts
+  if (background_updates) {
+    // later, merging with work that is still queued
+    pending_start = starting_age;
+    alsoUpdate(pending, value.fieldP->dependent_scripts, card);
+    return;
+  }
   alsoUpdate(to_update, value.fieldP->dependent_scripts, card);
   updateRecursive(to_update, starting_age);
   #ifdef LOG_UPDATES
@@ -279,8 +290,9 @@ void SetScriptManager::updateAll() {
   }
   // update card data of all cards
   FOR_EACH(card, set.cards) {
+    if (!card->isRead()) continue; // the values in the file are still up to date, see LazyCards
     Context& ctx = getContext(card);
-    FOR_EACH(v, card->data) {
+    FOR_EACH(v, card->data()) {
       try {
         #if USE_SCRIPT_PROFILING
           Timer t;
@@ -294,28 +306,53 @@ void SetScriptManager::updateAll() {
   }
   // update things that depend on the card list
   updateAllDependend(set.game->dependent_scripts_cards);
+  updateAllPending();
   #ifdef LOG_UPDATES
     wxLogDebug(_("-------------------------------\n"));
   #endif
 }
 
 void SetScriptManager::updateAllDependend(const vector<Dependency>& dependent_scripts, const CardP& card) {
-  deque<ToUpdate> to_update;
+  if (background_updates) {
+    pending_start = Age();
+    alsoUpdate(pending, dependent_scripts, card);
+    return;
+  }
+  UpdateQueue to_update;
   Age starting_age;
   alsoUpdate(to_update, dependent_scripts, card);
   updateRecursive(to_update, starting_age);
 }
 
-void SetScriptManager::updateRecursive(deque<ToUpdate>& to_update, Age starting_age) {
-  if (to_update.empty()) return;
+bool SetScriptManager::updatePending(long max_time) {
+  if (pending.queue.empty()) return false;
+  set.clearOrderCache(); // there may have been other actions since the previous batch
+  wxStopWatch timer;
+  do {
+    ToUpdate u = pending.queue.top();
+    pending.queue.pop();
+    pending.dirty.erase(u.value);
+    updateToUpdate(u, pending, pending_start);
+  } while (!pending.queue.empty() && timer.Time() < max_time);
+  return !pending.queue.empty();
+}
+
+void SetScriptManager::updateAllPending() {
+  updateRecursive(pending, pending_start);
+}
+
+void SetScriptManager::updateRecursive(UpdateQueue& to_update, Age starting_age) {
+  if (to_update.queue.empty()) return;
   set.clearOrderCache(); // clear caches before evaluating a round of scripts
-  while (!to_update.empty()) {
-    updateToUpdate(to_update.front(), to_update, starting_age);
-    to_update.pop_front();
+  while (!to_update.queue.empty()) {
+    ToUpdate u = to_update.queue.top();
+    to_update.queue.pop();
+    to_update.dirty.erase(u.value);
+    updateToUpdate(u, to_update, starting_age);
   }
 }
 
-void SetScriptManager::updateToUpdate(const ToUpdate& u, deque<ToUpdate>& to_update, Age starting_age) {
+void SetScriptManager::updateToUpdate(const ToUpdate& u, UpdateQueue& to_update, Age starting_age) {
   Age age = u.value->last_script_update;
   if (starting_age <= age)  return; // this value was already updated
   Context& ctx = getContext(u.card);
@@ -330,6 +367,7 @@ void SetScriptManager::updateToUpdate(const ToUpdate& u, deque<ToUpdate>& to_upd
     ScriptValueEvent change(u.card.get(), u.value);
     set.actions.tellListeners(change, false);
     // u.value has changed, also update values with a dependency on u.value
+    // if it didn't change, then neither do the values that depend on it, so those are not touched
     alsoUpdate(to_update, u.value->fieldP->dependent_scripts, u.card);
   #ifdef LOG_UPDATES
     wxLogDebug(_("Changed: %s"), u.value->fieldP->name);
@@ -341,26 +379,27 @@ void SetScriptManager::updateToUpdate(const ToUpdate& u, deque<ToUpdate>& to_upd
   #endif
 }
 
-void SetScriptManager::alsoUpdate(deque<ToUpdate>& to_update, const vector<Dependency>& deps, const CardP& card) {
+void SetScriptManager::alsoUpdate(UpdateQueue& to_update, const vector<Dependency>& deps, const CardP& card) {
   FOR_EACH_CONST(d, deps) {
     switch (d.type) {
       case DEP_SET_FIELD: {
         ValueP value = set.data.at(d.index);
-        to_update.push_back(ToUpdate(value.get(), CardP()));
+        markDirty(to_update, value.get(), CardP(), rankOf(false, d.index));
         break;
       } case DEP_CARD_FIELD: {
         if (card) {
-          ValueP value = card->data.at(d.index);
-          to_update.push_back(ToUpdate(value.get(), card));
+          ValueP value = card->data().at(d.index);
+          markDirty(to_update, value.get(), card, rankOf(true, d.index));
           break;
         } else {
           // There is no card, so the update should affect all cards (fall through).
         }
       } case DEP_CARDS_FIELD: {
         // something invalidates a card value for all cards, so all cards need updating
+        int rank = rankOf(true, d.index);
         FOR_EACH(card, set.cards) {
-          ValueP value = card->data.at(d.index);
-          to_update.push_back(ToUpdate(value.get(), card));
+          ValueP value = card->data().at(d.index);
+          markDirty(to_update, value.get(), card, rank);
         }
         break;
       } case DEP_CARD_STYLE: {
@@ -399,3 +438,75 @@ void SetScriptManager::alsoUpdate(deque<ToUpdate>& to_update, const vector<Depen
     }
   }
 }
+
+void SetScriptManager::markDirty(UpdateQueue& to_update, Value* value, const CardP& card, int rank) {
+  if (!to_update.dirty.insert(value).second) return; // already dirty
+  to_update.queue.push(ToUpdate(value, card, rank, to_update.marked++));
+}
+
+// ----------------------------------------------------------------------------- : ScriptManager : dependency order
+
+int SetScriptManager::rankOf(bool card, size_t index) {
+  size_t set_fields = set.game->set_fields.size();
+  if (field_rank.size() != set_fields + set.game->card_fields.size()) {
+    initRanks();
+  }
+  return field_rank.at(card ? set_fields + index : index);
+}
+
+void SetScriptManager::dependentFields(const vector<Dependency>& deps, vector<size_t>& out, int depth) {
+  if (depth > 10) return; // copy dependencies should not be cyclic, but don't hang if they are
+  size_t set_fields = set.game->set_fields.size();
+  FOR_EACH_CONST(d, deps) {
+    switch (d.type) {
+      case DEP_SET_FIELD:
+        out.push_back(d.index);
+        break;
+      case DEP_CARD_FIELD: case DEP_CARDS_FIELD:
+        out.push_back(set_fields + d.index);
+        break;
+      case DEP_CARD_COPY_DEP:
+        dependentFields(set.game->card_fields[d.index]->dependent_scripts, out, depth + 1);
+        break;
+      case DEP_SET_COPY_DEP:
+        dependentFields(set.game->set_fields[d.index]->dependent_scripts, out, depth + 1);
+        break;
+      default:
+        break; // not a value
+    }
+  }
+}
+
+void SetScriptManager::initRanks() {
+  Game& game = *set.game;
+  size_t n = game.set_fields.size() + game.card_fields.size();
+  // edges of the dependency graph: from a field to the fields that depend on it
+  vector<vector<size_t>> edges(n);
+  for (size_t i = 0 ; i < game.set_fields.size() ; ++i) {
+    dependentFields(game.set_fields[i]->dependent_scripts, edges[i]);
+  }
+  for (size_t i = 0 ; i < game.card_fields.size() ; ++i) {
+    dependentFields(game.card_fields[i]->dependent_scripts, edges[game.set_fields.size() + i]);
+  }
+  // topological sort, the reverse of a depth first post order
+  // edges that would form a cycle are ignored, the Age check in updateToUpdate handles those
+  vector<int> state(n, 0);
+  vector<size_t> post;
+  post.reserve(n);
+  for (size_t i = 0 ; i < n ; ++i) {
+    if (state[i] == 0) visitRank(i, edges, state, post);
+  }
+  field_rank.resize(n);
+  for (size_t k = 0 ; k < n ; ++k) {
+    field_rank[post[k]] = (int)(n - 1 - k);
+  }
+}
+
+void SetScriptManager::visitRank(size_t node, const vector<vector<size_t>>& edges, vector<int>& state, vector<size_t>& post) {
+  state[node] = 1; // visiting
+  FOR_EACH_CONST(next, edges[node]) {
+    if (state[next] == 0) visitRank(next, edges, state, post);
+  }
+  state[node] = 2; // done
+  post.push_back(node);
+}
@@ -14,6 +14,7 @@
 #include <script/context.hpp>
 #include <script/dependency.hpp>
 #include <queue>
+#include <unordered_set>
 
 class Set;
 class Value;
@@ -62,8 +63,23 @@ public:
   void updateStyles(const CardP& card, bool only_content_dependent);
   
   /// Update expensive things that were previously delayed
+  /** Also finishes all pending background updates */
   void updateDelayed();
   
+  /// Should values that depend on a changed value be updated in the background?
+  /** If enabled, an action only updates the value it changes right away.
+   *  The values depending on it are queued, and updated in batches by updatePending.
+   *  A newer action supersedes the queued work: values it touches are updated only once,
+   *  using the newest data.
+   */
+  bool background_updates;
+  /// Update some of the values queued for a background update, in dependency order
+  /** Stops after max_time milliseconds, returns true if there is work left */
+  bool updatePending(long max_time);
+  /// Update all values queued for a background update
+  void updateAllPending();
+  
+  
   /// Update all fields of all cards
   /** Update all set info fields
    *  Doesn't update styles
@@ -84,19 +100,53 @@ private:
   // Update all values with a specific dependency
   void updateAllDependend(const vector<Dependency>& dependent_scripts, const CardP& card = CardP());
   
-  // Something that needs to be updated
+  // Something that needs to be updated, a (card,field) node in the dependency graph
   struct ToUpdate {
-    ToUpdate(Value* value, CardP card) : value(value), card(card) {}
+    ToUpdate(Value* value, CardP card, int rank, size_t order) : value(value), card(card), rank(rank), order(order) {}
     Value* value;  ///< value to update
     CardP  card;   ///< card the value is in, or CadP() if it is not a card field
+    int    rank;   ///< position of the field in the dependency order
+    size_t order;  ///< when the value was marked as dirty
+    /// Order for the priority queue: lowest rank first, then first marked first
+    inline bool operator < (const ToUpdate& that) const {
+      return rank > that.rank || (rank == that.rank && order > that.order);
+    }
+  };
+  /// The dirty values, that still need to be updated
+  struct UpdateQueue {
+    priority_queue<ToUpdate>   queue;
+    unordered_set<const Value*> dirty; ///< the values in the queue
+    size_t                     marked = 0;
   };
   /// Update all things in to_update, and things that depent on them, etc.
-  /** Only update things that are older than starting_age. */
-  void updateRecursive(deque<ToUpdate>& to_update, Age starting_age);
-  /// Update a value given by a ToUpdate object, and add things depending on it to to_update
-  void updateToUpdate(const ToUpdate& u, deque<ToUpdate>& to_update, Age starting_age);
-  /// Schedule all things in deps to be updated by adding them to to_update
-  void alsoUpdate(deque<ToUpdate>& to_update, const vector<Dependency>& deps, const CardP& card);
+  /** Values are updated in dependency order, so each value is updated at most once,
+   *  after all the values it depends on.
+   *  Only update things that are older than starting_age (this only matters for cyclic dependencies).
+   */
+  void updateRecursive(UpdateQueue& to_update, Age starting_age);
+  /// Update a value given by a ToUpdate object, and mark things depending on it as dirty
+  void updateToUpdate(const ToUpdate& u, UpdateQueue& to_update, Age starting_age);
+  /// Mark all things in deps as dirty by adding them to to_update
+  void alsoUpdate(UpdateQueue& to_update, const vector<Dependency>& deps, const CardP& card);
+  /// Mark a single value as dirty
+  void markDirty(UpdateQueue& to_update, Value* value, const CardP& card, int rank);
+  
+  /// Values waiting for a background update
+  UpdateQueue pending;
+  /// Start of the current round of background updates, the last time work was queued
+  Age pending_start;
+  
+  /// Position of each set field and card field in a topological order of the dependency graph
+  /** Set fields come first, followed by card fields */
+  vector<int> field_rank;
+  /// Rank of a set field (card == false) or card field (card == true)
+  int rankOf(bool card, size_t index);
+  /// Determine field_rank from the dependent_scripts of the fields
+  void initRanks();
+  /// Indices in field_rank of the values that depend on deps
+  void dependentFields(const vector<Dependency>& deps, vector<size_t>& out, int depth = 0);
+  /// Depth first search for initRanks
+  void visitRank(size_t node, const vector<vector<size_t>>& edges, vector<int>& state, vector<size_t>& post);
   
   /// Delayed update for (bitmask)...
   enum Delay
@@ -10,6 +10,7 @@
 #include <script/scriptable.hpp>
 #include <script/context.hpp>
 #include <script/parser.hpp>
+#include <script/script_cache.hpp>
 #include <script/script.hpp>
 #include <script/value.hpp>
 #include <gfx/color.hpp>
@@ -47,7 +48,11 @@ ScriptValueP OptionalScript::invoke(Context& ctx, bool open_scope) const {
 
 void OptionalScript::parse(Reader& reader, bool string_mode) {
   vector<ScriptParseError> errors;
-  script = ::parse(unparsed, reader.getPackage(), string_mode, errors);
+  if (ScriptCache* cache = loading_script_cache()) {
+    script = cache->parse(unparsed, reader.getPackage(), string_mode, errors);
+  } else {
+    script = ::parse(unparsed, reader.getPackage(), string_mode, errors);
+  }
   // show parse errors as warnings
   String include_warnings;
   for (size_t i = 0 ; i < errors.size() ; ++i) {
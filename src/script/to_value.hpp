@@ -350,6 +350,7 @@ public:
   ScriptValueP simplify();
 
   ScriptValueP eval(Context& ctx, bool openScope) const override;
+  bool isPure() const override;
 
   /// The wrapped function
   ScriptValueP                          fun;
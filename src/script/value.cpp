@@ -11,6 +11,8 @@
 #include <script/value.hpp>
 #include <script/to_value.hpp>
 #include <script/context.hpp>
+#include <script/memo.hpp>
+#include <script/register_vm.hpp>
 #include <gfx/generated_image.hpp>
 #include <util/error.hpp>
 #include <boost/pool/singleton_pool.hpp>
@@ -77,6 +79,9 @@ ScriptValueP ScriptValue::getIndex(int index) const {
 ScriptValueP ScriptValue::simplifyClosure(ScriptClosure&) const {
   return nullptr;
 }
+bool ScriptValue::isPure() const {
+  return false;
+}
 
 ScriptValueP ScriptValue::dependencyMember(const String& name, const Dependency&) const {
   return dependency_dummy;
@@ -391,6 +396,14 @@ ScriptValueP to_script(const String& v) {
   return make_intrusive<ScriptString>(v);
 }
 
+bool is_plain_string(const ScriptValue& value) {
+  return typeid(value) == typeid(ScriptString);
+}
+
+bool is_plain_number(const ScriptValue& value) {
+  return typeid(value) == typeid(ScriptInt) || typeid(value) == typeid(ScriptDouble) || typeid(value) == typeid(ScriptBool);
+}
+
 
 // ----------------------------------------------------------------------------- : Color
 
@@ -605,6 +618,14 @@ ScriptValueP ScriptClosure::dependencies(Context& ctx, const Dependency& dep) co
   applyBindings(ctx);
   return fun->dependencies(ctx, dep);
 }
+bool ScriptClosure::isPure() const {
+  // a closure of a pure function is pure, as long as the bound values don't hide any state
+  if (!fun->isPure()) return false;
+  FOR_EACH_CONST(b, bindings) {
+    if (!is_memo_value(b.second)) return false;
+  }
+  return true;
+}
 void ScriptClosure::applyBindings(Context& ctx) const {
   FOR_EACH_CONST(b, bindings) {
     if (ctx.getVariableScope(b.first) != 0) {
@@ -97,6 +97,9 @@ public:
    *  Alternatively, the closure may be modified in place.
    */
   virtual ScriptValueP simplifyClosure(ScriptClosure&) const;
+  /// Is this a function without side effects, whose result depends only on its arguments?
+  /** Calls to pure functions are memoized by the Context, see ScriptMemo */
+  virtual bool isPure() const;
 
   /// Return an iterator for the current collection, an iterator is a value that has next()
   virtual ScriptValueP makeIterator() const;
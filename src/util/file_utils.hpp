@@ -35,7 +35,9 @@ String add_extension(const String& filename, String const& extension);
 String clean_filename(const String& name);
 
 /// Change the filename fn if it already exists, in the way described by conflicts.
-/** Returns true if the filename should be used, false if failed. */
+/** Returns true if the filename should be used, false if failed.
+ *  Names in used count as existing files, so all names can be resolved before any file is written.
+ */
 bool resolve_filename_conflicts(wxFileName& fn, FilenameConflicts conflicts, set<String>& used);
 
 // ----------------------------------------------------------------------------- : File info
@@ -0,0 +1,388 @@
+//+----------------------------------------------------------------------------+
+//| Description:  Magic Set Editor - Program to make Magic (tm) cards          |
+//| Copyright:    (C) Twan van Laarhoven and the other MSE developers          |
+//| License:      GNU General Public License 2 or later (see file COPYING)     |
+//+----------------------------------------------------------------------------+
+
+// ----------------------------------------------------------------------------- : Includes
+
+#include <util/prec.hpp>
+#include <util/io/mapped_zip.hpp>
+#include <wx/zipstrm.h>
+#include <wx/zstream.h>
+#include <wx/mstream.h>
+#include <wx/file.h>
+#include <wx/filename.h>
+
+#ifdef __WXMSW__
+  #include <windows.h>
+  #include <io.h>
+#else
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <fcntl.h>
+  #include <unistd.h>
+#endif
+
+// ----------------------------------------------------------------------------- : Streams
+
+/// A stream over a stored entry, the data is not copied
+class MappedStoredInputStream : public wxMemoryInputStream {
+public:
+  MappedStoredInputStream(const shared_ptr<const MappedZipFile>& zip, const Byte* data, size_t size)
+    : wxMemoryInputStream(data, size)
+    , zip(zip)
+  {}
+private:
+  shared_ptr<const MappedZipFile> zip; ///< Keep the file mapped
+};
+
+/// Class to use as a superclass, so the compressed stream is constructed before the inflater
+class MappedData_aux {
+protected:
+  shared_ptr<const MappedZipFile> zip; ///< Keep the file mapped
+  wxMemoryInputStream compressed;
+  inline MappedData_aux(const shared_ptr<const MappedZipFile>& zip, const Byte* data, size_t size)
+    : zip(zip), compressed(data, size)
+  {}
+};
+
+/// A stream that inflates a deflated entry while it is read
+class MappedDeflateInputStream : private MappedData_aux, public wxZlibInputStream {
+public:
+  MappedDeflateInputStream(const shared_ptr<const MappedZipFile>& zip, const Byte* data, size_t compressed_size, size_t size)
+    : MappedData_aux(zip, data, compressed_size)
+    , wxZlibInputStream(compressed, wxZLIB_NO_HEADER)
+    , size(size)
+  {}
+  wxFileOffset GetLength() const override { return size; }
+private:
+  size_t size; ///< Size after inflating
+};
+
+// ----------------------------------------------------------------------------- : MappedZipFile
+
+MappedZipFile::MappedZipFile()
+  : data(nullptr), size(0)
+  #ifdef __WXMSW__
+  , mapping(nullptr)
+  #endif
+{}
+
+MappedZipFile::~MappedZipFile() {
+  if (!data) return;
+  #ifdef __WXMSW__
+    UnmapViewOfFile(data);
+    CloseHandle((HANDLE)mapping);
+  #else
+    munmap(const_cast<Byte*>(data), size);
+  #endif
+}
+
+shared_ptr<MappedZipFile> MappedZipFile::open(const String& filename) {
+  shared_ptr<MappedZipFile> zip(new MappedZipFile);
+  #ifdef __WXMSW__
+    // allow the file to be renamed and deleted while it is mapped, see Package::saveToZipfile
+    HANDLE file = CreateFileW(filename.wc_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return nullptr;
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0 || (unsigned long long)file_size.QuadPart > (size_t)-1) {
+      CloseHandle(file);
+      return nullptr;
+    }
+    HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file); // the mapping keeps the file open
+    if (!mapping) return nullptr;
+    const void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!view) {
+      CloseHandle(mapping);
+      return nullptr;
+    }
+    zip->mapping = mapping;
+    zip->data    = static_cast<const Byte*>(view);
+    zip->size    = (size_t)file_size.QuadPart;
+  #else
+    int fd = ::open(filename.fn_str(), O_RDONLY);
+    if (fd < 0) return nullptr;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0 || (unsigned long long)st.st_size > (size_t)-1) {
+      close(fd);
+      return nullptr;
+    }
+    void* view = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); // the mapping keeps the file open
+    if (view == MAP_FAILED) return nullptr;
+    zip->data = static_cast<const Byte*>(view);
+    zip->size = (size_t)st.st_size;
+  #endif
+  return zip;
+}
+
+static inline unsigned int read_u16(const Byte* p) {
+  return p[0] | (p[1] << 8);
+}
+static inline unsigned int read_u32(const Byte* p) {
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int)p[3] << 24);
+}
+
+MappedZipEntry MappedZipFile::locate(const wxZipEntry& entry) const {
+  MappedZipEntry result;
+  if (entry.GetFlags() & 1) return result; // encrypted
+  int method = entry.GetMethod();
+  if (method != wxZIP_METHOD_STORE && method != wxZIP_METHOD_DEFLATE) return result;
+  // the local header: signature, 22 bytes of fields, name length, extra field length, name, extra field
+  wxFileOffset header = entry.GetOffset();
+  if (header < 0 || (size_t)header > size || size - (size_t)header < 30) return result;
+  const Byte* p = data + header;
+  if (read_u32(p) != 0x04034b50) return result;
+  size_t offset = (size_t)header + 30 + read_u16(p + 26) + read_u16(p + 28);
+  wxFileOffset compressed_size = entry.GetCompressedSize(), file_size = entry.GetSize();
+  if (compressed_size < 0 || file_size < 0 || offset > size || (size_t)compressed_size > size - offset) return result;
+  if (method == wxZIP_METHOD_STORE && compressed_size != file_size) return result;
+  result.offset          = offset;
+  result.compressed_size = (size_t)compressed_size;
+  result.size            = (size_t)file_size;
+  result.method          = method;
+  return result;
+}
+
+unique_ptr<wxInputStream> MappedZipFile::openIn(const MappedZipEntry& entry) const {
+  assert(entry.ok());
+  shared_ptr<const MappedZipFile> self = shared_from_this();
+  if (entry.method == wxZIP_METHOD_STORE) {
+    return make_unique<MappedStoredInputStream>(self, data + entry.offset, entry.size);
+  } else {
+    return make_unique<MappedDeflateInputStream>(self, data + entry.offset, entry.compressed_size, entry.size);
+  }
+}
+
+// ----------------------------------------------------------------------------- : ZipAppender : utilities
+
+static inline void put_u16(vector<Byte>& out, unsigned int x) {
+  out.push_back(Byte(x));
+  out.push_back(Byte(x >> 8));
+}
+static inline void put_u32(vector<Byte>& out, unsigned int x) {
+  put_u16(out, x & 0xFFFF);
+  put_u16(out, x >> 16);
+}
+
+unsigned int zip_crc32(const Byte* data, size_t size, unsigned int crc) {
+  static const vector<unsigned int> table = [] {
+    vector<unsigned int> table(256);
+    for (unsigned int i = 0 ; i < 256 ; ++i) {
+      unsigned int c = i;
+      for (int k = 0 ; k < 8 ; ++k) c = c & 1 ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+      table[i] = c;
+    }
+    return table;
+  }();
+  crc ^= 0xFFFFFFFF;
+  for (size_t i = 0 ; i < size ; ++i) {
+    crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+  }
+  return crc ^ 0xFFFFFFFF;
+}
+
+static String journal_name(const String& filename) {
+  return filename + _(".journal");
+}
+
+static bool truncate_file(const String& filename, size_t size) {
+  wxFile file(filename, wxFile::read_write);
+  if (!file.IsOpened()) return false;
+  #ifdef __WXMSW__
+    return _chsize_s(file.fd(), size) == 0;
+  #else
+    return ftruncate(file.fd(), size) == 0;
+  #endif
+}
+
+// ----------------------------------------------------------------------------- : ZipAppender
+
+ZipAppender::ZipAppender(const String& filename)
+  : filename(filename), old_size(0), entries(0), position(0)
+{}
+
+ZipAppender::~ZipAppender() {}
+
+bool ZipAppender::init(const MappedZipFile& zip) {
+  const Byte* data = zip.getData();
+  size_t size = zip.getSize();
+  if (size < 22 || (size_t)wxFileName::GetSize(filename).GetValue() != size) return false;
+  // find the end of central directory record, it is followed only by the comment
+  size_t end = size - 22;
+  while (read_u32(data + end) != 0x06054b50 || end + 22 + read_u16(data + end + 20) != size) {
+    if (end == 0 || size - end > 22 + 0xFFFF) return false;
+    --end;
+  }
+  const Byte* p = data + end;
+  size_t cd_entries = read_u16(p + 10), cd_size = read_u32(p + 12), cd_offset = read_u32(p + 16);
+  // only a single disk, no zip64
+  if (read_u16(p + 4) != 0 || read_u16(p + 6) != 0 || read_u16(p + 8) != cd_entries) return false;
+  if (cd_entries == 0xFFFF || cd_size == 0xFFFFFFFF || cd_offset == 0xFFFFFFFF) return false;
+  if (end >= 20 && read_u32(p - 20) == 0x07064b50) return false;
+  if (cd_offset + cd_size != end) return false;
+  old_size = size;
+  old_directory.assign(data + cd_offset, data + end);
+  old_comment.assign(p + 22, data + size);
+  // index the records
+  size_t pos = 0;
+  for (size_t i = 0 ; i < cd_entries ; ++i) {
+    if (old_directory.size() - pos < 46) return false;
+    const Byte* r = old_directory.data() + pos;
+    if (read_u32(r) != 0x02014b50) return false;
+    size_t record_size = 46 + read_u16(r + 28) + read_u16(r + 30) + read_u16(r + 32);
+    if (old_directory.size() - pos < record_size) return false;
+    old_records[read_u32(r + 42)] = make_pair(pos, record_size);
+    pos += record_size;
+  }
+  return true;
+}
+
+bool ZipAppender::keep(wxFileOffset header_offset) {
+  auto it = old_records.find((UInt)header_offset);
+  if (header_offset < 0 || it == old_records.end()) return false;
+  const Byte* record = old_directory.data() + it->second.first;
+  directory.insert(directory.end(), record, record + it->second.second);
+  old_records.erase(it); // keep each file only once
+  ++entries;
+  return true;
+}
+
+void ZipAppender::write(const void* buffer, size_t size) {
+  if (file->Write(buffer, size) != size) {
+    throw PackageError(_ERROR_("unable to store file"));
+  }
+  position += size;
+}
+
+void ZipAppender::begin() {
+  // first record where the old archive ends
+  {
+    wxFile journal(journal_name(filename), wxFile::write);
+    if (!journal.IsOpened() || !journal.Write(String::Format(_("%llu"), (unsigned long long)old_size)) || !journal.Flush()) {
+      throw PackageError(_ERROR_("unable to open output file"));
+    }
+  }
+  auto out = make_unique<wxFile>(filename, wxFile::read_write);
+  if (!out->IsOpened() || out->Length() != (wxFileOffset)old_size || out->Seek(old_size) != (wxFileOffset)old_size) {
+    throw PackageError(_ERROR_("unable to open output file"));
+  }
+  file = move(out);
+  position = old_size;
+}
+
+void ZipAppender::add(const String& name, wxInputStream& in) {
+  // read the file
+  vector<Byte> data, buffer(65536);
+  while (in.Read(buffer.data(), buffer.size()).LastRead() > 0) {
+    data.insert(data.end(), buffer.begin(), buffer.begin() + in.LastRead());
+  }
+  // compress it, unless that doesn't help (for instance for png images)
+  wxMemoryOutputStream compressed_stream;
+  {
+    wxZlibOutputStream deflate(compressed_stream, wxZ_DEFAULT_COMPRESSION, wxZLIB_NO_HEADER);
+    deflate.Write(data.data(), data.size());
+    deflate.Close();
+  }
+  size_t compressed_size = (size_t)compressed_stream.GetLength();
+  bool store = compressed_size >= data.size();
+  if (store) compressed_size = data.size();
+  if (position + compressed_size + 0x10000 > 0xFFFFFFFF || entries >= 0xFFFF) {
+    throw PackageError(_ERROR_("unable to store file")); // would need zip64
+  }
+  // headers
+  wxScopedCharBuffer utf8_name = name.ToUTF8();
+  size_t name_size = utf8_name.length();
+  unsigned int flags = 0;
+  for (size_t i = 0 ; i < name_size ; ++i) {
+    if ((Byte)utf8_name.data()[i] >= 0x80) flags = 0x800; // name is utf-8
+  }
+  wxDateTime now = wxDateTime::Now();
+  unsigned int dos_time = (now.GetHour() << 11) | (now.GetMinute() << 5) | (now.GetSecond() / 2);
+  unsigned int dos_date = ((now.GetYear() - 1980) << 9) | ((now.GetMonth() + 1) << 5) | now.GetDay();
+  unsigned int crc = zip_crc32(data.data(), data.size());
+  vector<Byte> common;
+  put_u16(common, 20); // version needed to extract
+  put_u16(common, flags);
+  put_u16(common, store ? wxZIP_METHOD_STORE : wxZIP_METHOD_DEFLATE);
+  put_u16(common, dos_time);
+  put_u16(common, dos_date);
+  put_u32(common, crc);
+  put_u32(common, (UInt)compressed_size);
+  put_u32(common, (UInt)data.size());
+  put_u16(common, (UInt)name_size);
+  put_u16(common, 0); // extra field length
+  // central directory record
+  put_u32(directory, 0x02014b50);
+  put_u16(directory, 20); // version made by
+  directory.insert(directory.end(), common.begin(), common.end());
+  put_u16(directory, 0); // comment length
+  put_u16(directory, 0); // disk number
+  put_u16(directory, 0); // internal attributes
+  put_u32(directory, 0); // external attributes
+  put_u32(directory, (UInt)position);
+  directory.insert(directory.end(), utf8_name.data(), utf8_name.data() + name_size);
+  ++entries;
+  // local header and data
+  vector<Byte> header;
+  put_u32(header, 0x04034b50);
+  header.insert(header.end(), common.begin(), common.end());
+  header.insert(header.end(), utf8_name.data(), utf8_name.data() + name_size);
+  write(header.data(), header.size());
+  if (store) {
+    write(data.data(), data.size());
+  } else {
+    vector<Byte> compressed(compressed_size);
+    compressed_stream.CopyTo(compressed.data(), compressed_size);
+    write(compressed.data(), compressed_size);
+  }
+}
+
+void ZipAppender::commit() {
+  if (position + directory.size() + 22 + old_comment.size() > 0xFFFFFFFF) {
+    throw PackageError(_ERROR_("unable to store file")); // would need zip64
+  }
+  // central directory and end record
+  vector<Byte> end;
+  put_u32(end, 0x06054b50);
+  put_u16(end, 0); // disk number
+  put_u16(end, 0); // disk with the central directory
+  put_u16(end, entries);
+  put_u16(end, entries);
+  put_u32(end, (UInt)directory.size());
+  put_u32(end, (UInt)position);
+  put_u16(end, (UInt)old_comment.size());
+  end.insert(end.end(), old_comment.begin(), old_comment.end());
+  write(directory.data(), directory.size());
+  write(end.data(), end.size());
+  // the new archive is complete once it is on disk
+  if (!file->Flush() || !file->Close()) {
+    throw PackageError(_ERROR_("unable to store file"));
+  }
+  file.reset();
+  wxRemoveFile(journal_name(filename));
+}
+
+void ZipAppender::rollback() {
+  if (file) {
+    file.reset();
+    truncate_file(filename, old_size);
+  }
+  wxRemoveFile(journal_name(filename));
+}
+
+void ZipAppender::recover(const String& filename) {
+  String journal = journal_name(filename);
+  if (!wxFileExists(journal)) return;
+  wxFile in(journal);
+  String content;
+  unsigned long long old_size;
+  if (in.IsOpened() && in.ReadAll(&content) && content.ToULongLong(&old_size) && old_size > 0
+      && wxFileName::GetSize(filename).GetValue() >= old_size) {
+    truncate_file(filename, (size_t)old_size);
+  }
+  in.Close();
+  wxRemoveFile(journal);
+}
@@ -0,0 +1,119 @@
+//+----------------------------------------------------------------------------+
+//| Description:  Magic Set Editor - Program to make Magic (tm) cards          |
+//| Copyright:    (C) Twan van Laarhoven and the other MSE developers          |
+//| License:      GNU General Public License 2 or later (see file COPYING)     |
+//+----------------------------------------------------------------------------+
+
+#pragma once
+
+// ----------------------------------------------------------------------------- : Includes
+
+#include <util/prec.hpp>
+
+class wxZipEntry;
+class wxFile;
+
+// ----------------------------------------------------------------------------- : MappedZipFile
+
+/// Where the data of a file in a zip archive is, see MappedZipFile::locate
+struct MappedZipEntry {
+  MappedZipEntry() : offset(0), compressed_size(0), size(0), method(-1) {}
+
+  size_t offset;          ///< Start of the data in the archive
+  size_t compressed_size; ///< Size of the data in the archive
+  size_t size;            ///< Size of the file
+  int    method;          ///< Compression method, -1 if the entry can not be read from the mapped file
+
+  inline bool ok() const { return method >= 0; }
+};
+
+/// A zip archive that is mapped into memory
+/** The index of the archive (the central directory) is read by wxZipInputStream when the package is opened,
+ *  after that files are read directly from memory: stored files without copying them,
+ *  deflated files with a streaming inflater.
+ *  The mapping is never modified, so any number of threads can read from it at once.
+ */
+class MappedZipFile : public enable_shared_from_this<MappedZipFile> {
+public:
+  /// Map a file into memory, returns nullptr if that is not possible
+  static shared_ptr<MappedZipFile> open(const String& filename);
+  ~MappedZipFile();
+
+  /// Find the data of an entry in the mapped file
+  /** The result is not ok() if the entry is damaged, or uses a feature that is not supported (encryption, other compression methods)
+   */
+  MappedZipEntry locate(const wxZipEntry& entry) const;
+  /// Open a stream for reading an entry, the file stays mapped while the stream exists
+  unique_ptr<wxInputStream> openIn(const MappedZipEntry& entry) const;
+
+  inline const Byte* getData() const { return data; }
+  inline size_t      getSize() const { return size; }
+
+private:
+  MappedZipFile();
+  const Byte* data;
+  size_t      size;
+  #ifdef __WXMSW__
+    void*     mapping; ///< Handle of the file mapping
+  #endif
+};
+
+/// CRC-32 checksum of data, as stored in zip archives
+/** To compute the checksum of data in pieces, pass the checksum of the preceding data as crc */
+unsigned int zip_crc32(const Byte* data, size_t size, unsigned int crc = 0);
+
+// ----------------------------------------------------------------------------- : ZipAppender
+
+/// Saves a zip archive by appending files and a new central directory to it
+/** The files that are kept are not touched, their old entries in the central directory are reused.
+ *  The space of replaced files and of the old central directory stays in the file until it is rewritten.
+ *
+ *  While appending, the old size of the archive is stored in a journal file next to it.
+ *  If the program is interrupted, recover() cuts the archive back to that size when it is opened again,
+ *  so the archive is always either in the old or in the new state.
+ *
+ *  Usage:
+ *    ZipAppender zip(filename);
+ *    if (zip.init(mapped) && zip.keep(...) ...) {
+ *      // unmap the file
+ *      zip.begin(); zip.add(...); zip.commit(); // or rollback() after an error
+ *    }
+ */
+class ZipAppender {
+public:
+  ZipAppender(const String& filename);
+  ~ZipAppender();
+
+  /// Read the central directory of the mapped archive
+  /** Returns false if the archive can not be appended to (zip64, damaged, or changed since it was mapped) */
+  bool init(const MappedZipFile& zip);
+  /// Keep the file with the local header at the given offset, returns false if there is no such file
+  bool keep(wxFileOffset header_offset);
+  /// Size of the archive before appending
+  inline size_t oldSize() const { return old_size; }
+
+  /// Start appending, the file must no longer be mapped
+  void begin();
+  /// Append a file
+  void add(const String& name, wxInputStream& data);
+  /// Write the new central directory, after this the archive contains the kept and added files
+  void commit();
+  /// Undo all changes to the archive
+  void rollback();
+
+  /// Undo an incomplete save of the given archive, if there is one
+  static void recover(const String& filename);
+
+private:
+  String filename;
+  size_t old_size;
+  vector<Byte> old_directory; ///< Central directory of the archive
+  vector<Byte> old_comment;   ///< Comment of the archive
+  map<UInt, pair<size_t,size_t>> old_records; ///< Position and size of the records in old_directory, by local header offset
+  vector<Byte> directory;     ///< The new central directory
+  UInt entries;               ///< Number of entries in the new central directory
+  unique_ptr<wxFile> file;    ///< The archive, while appending
+  size_t position;            ///< Current end of the archive
+
+  void write(const void* buffer, size_t size);
+};
@@ -12,6 +12,7 @@
 #include <util/error.hpp>
 #include <script/to_value.hpp> // for reflection
 #include <script/profiler.hpp> // for PROFILER
+#include <script/script_cache.hpp>
 #include <wx/wfstream.h>
 #include <wx/zipstrm.h>
 #include <wx/dir.h>
@@ -22,7 +23,8 @@ IMPLEMENT_DYNAMIC_ARG(Package*, writing_package,   nullptr);
 IMPLEMENT_DYNAMIC_ARG(Package*, clipboard_package, nullptr);
 
 Package::Package()
-  : zipStream (nullptr)
+  : compaction_threshold(0)
+  , zipStream (nullptr)
 {}
 
 Package::~Package() {
@@ -85,6 +87,7 @@ void Package::reopen() {
   if (wxDirExists(filename)) {
     // make sure we have no zip open
     zipStream.reset();
+    mappedZip.reset();
   } else {
     // reopen only needed for zipfile
     openZipfile();
@@ -133,6 +136,7 @@ void Package::removeTempFiles(bool remove_unused) {
       it->second.tempName.clear();
       delete it->second.zipEntry; 
       it->second.zipEntry = 0;
+      it->second.zipData = MappedZipEntry();
       ++it;
     }
   }
@@ -192,6 +196,11 @@ unique_ptr<wxInputStream> Package::openIn(const String& file) {
     Packaged* p = dynamic_cast<Packaged*>(this);
     return package_manager.openFileFromPackage(p, file).first;
   }
+  auto alias = aliases.find(normalize_internal_filename(file));
+  if (alias != aliases.end()) {
+    // the contents are stored in another file, see deduplicateFiles
+    return openIn(alias->second);
+  }
   FileInfos::iterator it = files.find(normalize_internal_filename(file));
   if (it == files.end()) {
     // does it look like a relative filename?
@@ -203,6 +212,9 @@ unique_ptr<wxInputStream> Package::openIn(const String& file) {
   if (it != files.end() && it->second.wasWritten()) {
     // written to this file, open the temp file
     stream = make_unique<wxFileInputStream>(it->second.tempName);
+  } else if (mappedZip && it != files.end() && it->second.zipData.ok()) {
+    // a file in a zip archive, read from memory
+    stream = mappedZip->openIn(it->second.zipData);
   } else if (wxFileExists(filename+_("/")+file)) {
     // a file in directory package
     stream = make_unique<wxFileInputStream>(filename+_("/")+file);
@@ -227,6 +239,23 @@ unique_ptr<wxOutputStream> Package::openOut(const String& file) {
 String Package::nameOut(const String& file) {
   assert(wxThread::IsMain()); // Writing should only be done from the main thread
   String name = normalize_internal_filename(file);
+  // this file gets its own contents again
+  aliases.erase(name);
+  // files that are stored in this file keep the old contents
+  for (auto alias = aliases.begin() ; alias != aliases.end() ; ) {
+    if (alias->second != name) {
+      ++alias;
+      continue;
+    }
+    String alias_name = alias->first;
+    alias = aliases.erase(alias);
+    FileInfos::iterator it = files.find(alias_name);
+    if (it == files.end() || !it->second.wasWritten()) {
+      auto in_stream = openIn(name);
+      wxFileOutputStream out(nameOut(alias_name));
+      out.Write(*in_stream);
+    }
+  }
   FileInfos::iterator it = files.find(name);
   if (it == files.end()) {
     // new file
@@ -256,11 +285,13 @@ LocalFileName Package::newFileName(const String& prefix, const String& suffix) {
     name += suffix;
     name = normalize_internal_filename(name);
     // check if a file with that name exists
+    // aliases are still used by LocalFileNames, even if their file is gone
     FileInfos::iterator it = files.find(name);
-    if (it == files.end()) {
+    if (it == files.end() && aliases.find(name) == aliases.end()) {
       // name doesn't exist yet
       it = addFile(name);
       it->second.created = true;
+      it->second.local_name = true;
       return name;
     }
   }
@@ -268,15 +299,79 @@ LocalFileName Package::newFileName(const String& prefix, const String& suffix) {
 
 void Package::referenceFile(const String& file) {
   if (file.empty()) return;
-  FileInfos::iterator it = files.find(file);
+  std::lock_guard<std::mutex> lock(reference_mutex);
+  FileInfos::iterator it = files.find(storedName(file));
   if (it == files.end()) throw InternalError(_("referencing a nonexistant file"));
   it->second.keep = true;
 }
 
+String Package::storedName(const String& file) const {
+  auto it = aliases.find(file);
+  return it == aliases.end() ? file : it->second;
+}
+
+// ----------------------------------------------------------------------------- : Deduplication
+
+/// Size and CRC-32 of the contents of a file
+typedef pair<size_t, unsigned int> ContentKey;
+
+static void read_all(wxInputStream& in, vector<Byte>& data) {
+  data.clear();
+  Byte buffer[4096];
+  do {
+    in.Read(buffer, sizeof(buffer));
+    data.insert(data.end(), buffer, buffer + in.LastRead());
+  } while (in.LastRead() > 0);
+}
+
+void Package::deduplicateFiles() {
+  assert(wxThread::IsMain()); // Writing should only be done from the main thread
+  vector<String> new_files;
+  FOR_EACH(f, files) {
+    if (f.second.local_name && f.second.wasWritten() && aliases.find(f.first) == aliases.end()) {
+      new_files.push_back(f.first);
+    }
+  }
+  if (new_files.empty()) return;
+  // the contents of files in the zip archive are known without reading them
+  multimap<ContentKey, String> index;
+  FOR_EACH(f, files) {
+    if (f.second.zipEntry && !f.second.wasWritten() && aliases.find(f.first) == aliases.end()) {
+      index.insert(make_pair(ContentKey((size_t)f.second.zipEntry->GetSize(), (unsigned int)f.second.zipEntry->GetCrc()), f.first));
+    }
+  }
+  // compare the new files to the files in the archive, and to each other
+  vector<Byte> data, other_data;
+  FOR_EACH(name, new_files) {
+    wxFileInputStream in(files[name].tempName);
+    if (!in.IsOk()) continue;
+    read_all(in, data);
+    ContentKey key(data.size(), zip_crc32(data.data(), data.size()));
+    bool duplicate = false;
+    for (auto it = index.lower_bound(key) ; it != index.end() && it->first == key && !duplicate ; ++it) {
+      try {
+        auto other = openIn(it->second);
+        read_all(*other, other_data);
+      } catch (const Error&) {
+        continue; // can't read it, so don't use it
+      }
+      if (other_data == data) {
+        aliases[name] = it->second;
+        duplicate = true;
+      }
+    }
+    if (!duplicate) index.insert(make_pair(key, name));
+  }
+}
+
 // ----------------------------------------------------------------------------- : LocalFileNames and absolute file references
 
 String Package::absoluteName(const LocalFileName& file) {
   assert(wxThread::IsMain());
+  auto alias = aliases.find(normalize_internal_filename(file.fn));
+  if (alias != aliases.end()) {
+    return absoluteName(LocalFileName(alias->second));
+  }
   FileInfos::iterator it = files.find(normalize_internal_filename(file.fn));
   if (it == files.end()) {
     throw FileNotFoundError(file.fn, filename);
@@ -319,7 +414,7 @@ String LocalFileName::toStringForWriting() const {
     }
   } else if (!fn.empty() && writing_package()) {
     writing_package()->referenceFile(fn);
-    return fn;
+    return writing_package()->storedName(fn);
   } else {
     return fn;
   }
@@ -347,7 +442,7 @@ LocalFileName LocalFileName::fromReadString(String const& fn, String const& pref
 // ----------------------------------------------------------------------------- : Package : private
 
 Package::FileInfo::FileInfo()
-  : keep(false), created(false), zipEntry(nullptr)
+  : keep(false), created(false), local_name(false), zipEntry(nullptr)
 {}
 
 Package::FileInfo::~FileInfo() {
@@ -360,7 +455,9 @@ void Package::loadZipStream() {
     wxZipEntry* entry = zipStream->GetNextEntry();
     if (!entry) break;
     String name = normalize_internal_filename(entry->GetName(wxPATH_UNIX));
-    files[name].zipEntry = entry;
+    FileInfo& fi = files[name];
+    fi.zipEntry = entry;
+    if (mappedZip) fi.zipData = mappedZip->locate(*entry);
   }
   zipStream->CloseEntry();
 }
@@ -392,9 +489,13 @@ void Package::openSubdir(const String& name) {
 }
 
 void Package::openZipfile() {
+  // undo an interrupted incremental save
+  ZipAppender::recover(filename);
   // open stream
   zipStream = make_unique<ZipFileInputStream>(filename);
   if (!zipStream->IsOk())  throw PackageError(_ERROR_1_("package not found", filename));
+  // map the file into memory, if that fails files are read with a ZipFileInputStream
+  mappedZip = MappedZipFile::open(filename);
   // read zip entries
   loadZipStream();
 }
@@ -444,6 +545,10 @@ void Package::saveToDirectory(const String& saveAs, bool remove_unused, bool is_
 }
 
 void Package::saveToZipfile(const String& saveAs, bool remove_unused, bool is_copy) {
+  // append to the existing file?
+  if (!is_copy && saveAs == filename && compaction_threshold > 0 && mappedZip) {
+    if (saveToZipfileIncremental(remove_unused)) return;
+  }
   // create a temporary zip file name
   String tempFile = saveAs + _(".tmp");
   remove_file(tempFile);
@@ -474,6 +579,7 @@ void Package::saveToZipfile(const String& saveAs, bool remove_unused, bool is_co
     // close the old file
     if (!is_copy) {
       zipStream.reset();
+      mappedZip.reset();
     }
   } catch (Error const& e) {
     // when things go wrong delete the temp file
@@ -492,6 +598,50 @@ void Package::saveToZipfile(const String& saveAs, bool remove_unused, bool is_co
   openZipfile();
 }
 
+bool Package::saveToZipfileIncremental(bool remove_unused) {
+  ZipAppender zip(filename);
+  if (!zip.init(*mappedZip)) return false;
+  // keep the unchanged files, and see how much of the file would no longer be used
+  size_t used = 0, appended = 0;
+  FOR_EACH(f, files) {
+    if (!f.second.keep && remove_unused) {
+      // removed
+    } else if (f.second.wasWritten()) {
+      appended += (size_t)wxFileName::GetSize(f.second.tempName).GetValue();
+    } else {
+      if (!f.second.zipEntry || !f.second.zipData.ok() || !zip.keep(f.second.zipEntry->GetOffset())) return false;
+      used += f.second.zipData.offset + f.second.zipData.compressed_size - f.second.zipEntry->GetOffset();
+    }
+  }
+  if ((double)(zip.oldSize() - used) * 100 > (double)zip.oldSize() * compaction_threshold) return false; // compact instead
+  if ((double)zip.oldSize() + appended > 0xF0000000) return false; // the file would need zip64
+  // the file can not be written while it is open
+  zipStream.reset();
+  mappedZip.reset();
+  try {
+    // keep the old file as .bak, like a full save does
+    remove_file(filename + _(".bak"));
+    wxCopyFile(filename, filename + _(".bak"));
+    zip.begin();
+    FOR_EACH(f, files) {
+      if (f.second.wasWritten() && (f.second.keep || !remove_unused)) {
+        wxFileInputStream in(f.second.tempName);
+        if (!in.IsOk()) throw PackageError(_ERROR_("unable to store file"));
+        zip.add(f.first, in);
+      }
+    }
+    zip.commit();
+  } catch (Error const&) {
+    // keep using the old file
+    zip.rollback();
+    zipStream = make_unique<ZipFileInputStream>(filename);
+    mappedZip = MappedZipFile::open(filename);
+    throw;
+  }
+  // re-open zip file
+  openZipfile();
+  return true;
+}
 
 Package::FileInfos::iterator Package::addFile(const String& name) {
   return files.insert(make_pair(normalize_internal_filename(name), FileInfo())).first;
@@ -499,7 +649,7 @@ Package::FileInfos::iterator Package::addFile(const String& name) {
 
 DateTime Package::modificationTime(const pair<String, FileInfo>& fi) const {
   if (fi.second.wasWritten()) {
-    return wxFileName(fi.first).GetModificationTime();
+    return wxFileName(fi.second.tempName).GetModificationTime();
   } else if (fi.second.zipEntry) {
     return fi.second.zipEntry->GetDateTime();
   } else if (wxFileExists(filename+_("/")+fi.first)) {
@@ -508,6 +658,11 @@ DateTime Package::modificationTime(const pair<String, FileInfo>& fi) const {
     return DateTime((wxLongLong)0ul);
   }
 }
+DateTime Package::modificationTime(const String& file) const {
+  FileInfos::const_iterator it = files.find(storedName(normalize_internal_filename(file)));
+  if (it == files.end()) return DateTime((wxLongLong)0ul);
+  return modificationTime(*it);
+}
 
 
 // ----------------------------------------------------------------------------- : Packaged
@@ -587,31 +742,43 @@ void Packaged::open(const String& package, bool just_header) {
   }
 }
 
+void Packaged::openWithoutHeader(const String& package) {
+  Package::open(package);
+  fully_loaded = false;
+}
+
 void Packaged::loadFully() {
   if (fully_loaded) return;
   auto stream = openIn(typeName());
   Reader reader(*stream, this, absoluteFilename() + _("/") + typeName());
+  unique_ptr<ScriptCache> script_cache;
+  if (cacheScripts()) script_cache = make_unique<ScriptCache>(*this);
+  WITH_DYNAMIC_ARG(loading_script_cache, script_cache.get());
   try {
     reader.handle_greedy(*this);
     fully_loaded = true; // only after loading and validating succeeded, be careful with recursion!
+    if (script_cache) script_cache->flush();
   } catch (const ParseError& err) {
     throw FileParseError(err.what(), absoluteFilename() + _("/") + typeName()); // more detailed message
   }
 }
 
 void Packaged::save() {
+  deduplicateFiles();
   WITH_DYNAMIC_ARG(writing_package, this);
   writeFile(typeName(), *this, fileVersion());
   referenceFile(typeName());
   Package::save();
 }
 void Packaged::saveAs(const String& package, bool remove_unused, bool as_directory) {
+  deduplicateFiles();
   WITH_DYNAMIC_ARG(writing_package, this);
   writeFile(typeName(), *this, fileVersion());
   referenceFile(typeName());
   Package::saveAs(package, remove_unused, as_directory);
 }
 void Packaged::saveCopy(const String& package) {
+  deduplicateFiles();
   WITH_DYNAMIC_ARG(writing_package, this);
   writeFile(typeName(), *this, fileVersion());
   referenceFile(typeName());
@@ -656,3 +823,4 @@ Version IncludePackage::fileVersion() const { return file_version_script; }
 IMPLEMENT_REFLECTION(IncludePackage) {
   REFLECT_BASE(Packaged);
 }
+
@@ -13,6 +13,8 @@
 #include <util/error.hpp>
 #include <util/file_utils.hpp>
 #include <util/vcs.hpp>
+#include <util/io/mapped_zip.hpp>
+#include <mutex>
 
 class Package;
 class wxFileInputStream;
@@ -73,10 +75,8 @@ private:
  *  Zip files are accessed using wxZip(Input|Output)Stream.
  *  The zip input stream appears to only allow one file at a time, since the stream itself maintains
  *  state about what file we are reading.
- *  There are multiple solutions:
- *    1. (currently used) Open a new ZipInputStream for each file
- *    2. (may be faster) First read the file into a memory buffer,
- *      return a stream based on that buffer (StringInputStream).
+ *  Therefore zip files are also mapped into memory (MappedZipFile), files are read from there.
+ *  Only when that is not possible a new ZipInputStream is opened for each file.
  *
  *  TODO: maybe support sub packages (a package inside another package)?
  */
@@ -129,6 +129,14 @@ public:
   /// Saves the package under a different filename, but keep the old one open
   void saveCopy(const String& package);
 
+  /// Should zip files be saved incrementally?
+  /** When saving a zip file to the same filename, changed files are appended to it,
+   *  until more than threshold percent of the file would be taken up by old versions of files.
+   *  Then the file is rewritten (compacted). 0 (the default) always rewrites the file.
+   *  Either way the old file is kept as a .bak file.
+   */
+  inline void setCompactionThreshold(UInt threshold) { compaction_threshold = threshold; }
+
 
   // --------------------------------------------------- : Managing the inside of the package
 
@@ -160,8 +168,23 @@ public:
   /// Signal that a file is still used by this package.
   /// Must be called for files not opened using openOut/nameOut
   /// If they are to be kept in the package.
+  /// Can be called from any thread, see Writer::handleParallel.
   void referenceFile(const String& file);
 
+  /// Collapse new files with the same contents as another file in the package
+  /** Only files with a name from newFileName are collapsed, since those are only referred to through LocalFileNames.
+   *  Such a file becomes an alias of the other file: it can still be opened under its own name,
+   *  but it is written and referenced as the other file, see storedName.
+   *  So the duplicate is no longer referenced, and it is left out when saving with remove_unused.
+   *
+   *  Files are compared by size and CRC-32, which are known for files in a zip archive,
+   *  and then byte for byte.
+   */
+  void deduplicateFiles();
+  /// The name of the file where the contents of a file are stored
+  /** This is the file itself, unless it was collapsed by deduplicateFiles */
+  String storedName(const String& file) const;
+
   // --------------------------------------------------- : Managing the inside of the package : Reader/writer
 
   template <typename T>
@@ -197,8 +220,10 @@ protected:
     ~FileInfo();
     bool keep;               ///< Should this file be kept in the package? (as opposed to deleting it)
     bool created;            ///< Was this file just created (e.g. should the VCS add it?)
+    bool local_name;         ///< Was the name made by newFileName? Then the file can be deduplicated
     String tempName;         ///< Name of the temporary file where new contents of this file are placed
     wxZipEntry* zipEntry;    ///< Entry in the zip file for this file
+    MappedZipEntry zipData;  ///< Location of this file in the mapped zip file
     /// Is this file changed, and therefore written to a temporary file?
     inline bool wasWritten() const { return !tempName.empty(); }
   };
@@ -207,6 +232,8 @@ protected:
   String filename;
   /// Last modified time
   DateTime modified;
+  /// See setCompactionThreshold
+  UInt compaction_threshold;
 
 public:
   /// Information on files in the package
@@ -214,11 +241,18 @@ public:
   inline const FileInfos& getFileInfos() const { return files; }
   /// When was a file last modified?
   DateTime modificationTime(const pair<String, FileInfo>& fi) const;
+  DateTime modificationTime(const String& file) const;
 private:
   /// All files in the package
   FileInfos files;
+  /// Lock for marking files as referenced while writing in parallel
+  std::mutex reference_mutex;
+  /// Files with the same contents as another file, and the name of that file, see deduplicateFiles
+  map<String, String> aliases;
   /// Filestream/zipstream for reading zip files
   unique_ptr<wxZipInputStream> zipStream;
+  /// The zip file mapped into memory, for reading files
+  shared_ptr<MappedZipFile> mappedZip;
 
   void loadZipStream();
   void openDirectory(bool fast = false);
@@ -228,6 +262,7 @@ private:
   void removeTempFiles(bool remove_unused);
   void clearKeepFlag();
   void saveToZipfile(const String&,   bool remove_unused, bool is_copy);
+  bool saveToZipfileIncremental(bool remove_unused);
   void saveToDirectory(const String&, bool remove_unused, bool is_copy);
   FileInfos::iterator addFile(const String& file);
 
@@ -276,6 +311,9 @@ public:
   /** if just_header is true, then the package is not fully parsed.
    */
   void open(const String& package, bool just_header = false);
+  /// Open a package without reading any data, the header must be filled in by the caller
+  /** Used for headers from the PackageHeaderIndex */
+  void openWithoutHeader(const String& package);
   /// Ensure the package is fully loaded.
   void loadFully();
   void save();
@@ -297,6 +335,9 @@ protected:
   virtual void validate(Version file_app_version);
   /// What file version should be used for writing files?
   virtual Version fileVersion() const = 0;
+  /// Should compiled scripts be cached on disk when loading? (see ScriptCache)
+  /** Only worth it for large packages that rarely change */
+  virtual bool cacheScripts() const { return false; }
 
   DECLARE_REFLECTION_VIRTUAL();
   friend void after_reading(Packaged& p, Version file_app_version);
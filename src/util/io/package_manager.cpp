@@ -16,8 +16,11 @@
 #include <data/locale.hpp>
 #include <data/export_template.hpp>
 #include <data/installer.hpp>
+#include <data/settings.hpp>
 #include <wx/stdpaths.h>
 #include <wx/wfstream.h>
+#include <thread>
+#include <atomic>
 
 // ----------------------------------------------------------------------------- : PackageManager : in memory
 
@@ -39,6 +42,20 @@ void PackageManager::reset() {
   loaded_packages.clear();
 }
 
+/// Create a package object of the right type, based on the extension
+static PackagedP new_package(const String& filename, const String& name) {
+  wxFileName fn(filename);
+  if      (fn.GetExt() == _("mse-game"))            return make_intrusive<Game>();
+  else if (fn.GetExt() == _("mse-style"))           return make_intrusive<StyleSheet>();
+  else if (fn.GetExt() == _("mse-locale"))          return make_intrusive<Locale>();
+  else if (fn.GetExt() == _("mse-include"))         return make_intrusive<IncludePackage>();
+  else if (fn.GetExt() == _("mse-symbol-font"))     return make_intrusive<SymbolFont>();
+  else if (fn.GetExt() == _("mse-export-template")) return make_intrusive<ExportTemplate>();
+  else {
+    throw PackageError(_("Unrecognized package type: '") + fn.GetExt() + _("'\nwhile trying to open: ") + name);
+  }
+}
+
 PackagedP PackageManager::openAny(const String& name_, bool just_header) {
   String name = trim(name_);
   if (starts_with(name,_("/"))) name = name.substr(1);
@@ -60,16 +77,7 @@ PackagedP PackageManager::openAny(const String& name_, bool just_header) {
   PackagedP& p = loaded_packages[filename];
   if (!p) {
     // load with the right type, based on extension
-    wxFileName fn(filename);
-    if      (fn.GetExt() == _("mse-game"))            p = make_intrusive<Game>();
-    else if (fn.GetExt() == _("mse-style"))           p = make_intrusive<StyleSheet>();
-    else if (fn.GetExt() == _("mse-locale"))          p = make_intrusive<Locale>();
-    else if (fn.GetExt() == _("mse-include"))         p = make_intrusive<IncludePackage>();
-    else if (fn.GetExt() == _("mse-symbol-font"))     p = make_intrusive<SymbolFont>();
-    else if (fn.GetExt() == _("mse-export-template")) p = make_intrusive<ExportTemplate>();
-    else {
-      throw PackageError(_("Unrecognized package type: '") + fn.GetExt() + _("'\nwhile trying to open: ") + name);
-    }
+    p = new_package(filename, name);
     p->open(filename, just_header);
   } else if (!just_header) {
     p->loadFully();
@@ -78,23 +86,98 @@ PackagedP PackageManager::openAny(const String& name_, bool just_header) {
 }
 
 void PackageManager::findMatching(const String& pattern, vector<PackagedP>& out) {
-  // first find local packages
-  String file = local.findFirstMatching(pattern);
-  while (!file.empty()) {
+  // first find local packages, then global packages
+  vector<String> local_files, global_files;
+  for (String file = local.findFirstMatching(pattern) ; !file.empty() ; file = wxFindNextFile()) {
+    local_files.push_back(file);
+  }
+  for (String file = global.findFirstMatching(pattern) ; !file.empty() ; file = wxFindNextFile()) {
+    global_files.push_back(file);
+  }
+  vector<String> files = local_files;
+  files.insert(files.end(), global_files.begin(), global_files.end());
+  openHeaders(files);
+  // all headers are loaded now
+  FOR_EACH(file, local_files) {
     out.push_back(openAny(file, true));
-    file = wxFindNextFile();
   }
-  // then global packages not already in the list
-  file = global.findFirstMatching(pattern);
-  while (!file.empty()) {
+  // global packages not already in the list
+  FOR_EACH(file, global_files) {
     PackagedP p = openAny(file, true);
     if (find(out.begin(), out.end(), p) == out.end()) {
       out.push_back(p);
     }
-    file = wxFindNextFile();
   }
 }
 
+void PackageManager::openHeaders(const vector<String>& names) {
+  // packages that are not loaded yet
+  struct Job {
+    String         filename;
+    String         modified;
+    PackagedP      package;
+    PackageHeaderP header; ///< Header from the index
+    bool           ok = false;
+  };
+  vector<Job> jobs;
+  FOR_EACH_CONST(name, names) {
+    String filename = normalize_filename(name);
+    if (loaded_packages.find(filename) != loaded_packages.end()) continue;
+    Job job;
+    job.filename = filename;
+    try {
+      job.package = new_package(filename, name);
+    } catch (const Error&) {
+      continue; // openAny will report the error
+    }
+    job.modified = PackageHeaderIndex::modificationTime(filename);
+    job.header   = header_index.find(filename, job.modified);
+    jobs.push_back(job);
+  }
+  if (jobs.empty()) return;
+  // open the packages and read the headers of the packages not in the index
+  // reading a header doesn't touch any shared state, so this can be done in parallel
+  std::atomic<size_t> next_job(0);
+  auto work = [&] {
+    for (size_t i = next_job++ ; i < jobs.size() ; i = next_job++) {
+      Job& job = jobs[i];
+      try {
+        if (job.header) {
+          job.package->openWithoutHeader(job.filename);
+          job.header->copyTo(*job.package);
+        } else {
+          job.package->open(job.filename, true);
+        }
+        job.ok = true;
+      } catch (...) {
+        // openAny will report the error
+      }
+    }
+  };
+  size_t thread_count = min((size_t)max(1u, std::thread::hardware_concurrency()), jobs.size());
+  vector<std::thread> threads;
+  for (size_t i = 1 ; i < thread_count ; ++i) {
+    threads.emplace_back(work);
+  }
+  work();
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  // store the results
+  FOR_EACH(job, jobs) {
+    if (!job.ok) continue;
+    loaded_packages[job.filename] = job.package;
+    if (!job.header && !job.modified.empty()) {
+      PackageHeaderP header = make_intrusive<PackageHeader>();
+      header->filename = job.filename;
+      header->modified = job.modified;
+      header->copyFrom(*job.package);
+      header_index.add(header);
+    }
+  }
+  header_index.flush();
+}
+
 pair<unique_ptr<wxInputStream>,Packaged*> PackageManager::openFileFromPackage(Packaged* package, const String& name) {
   if (!name.empty() && name.GetChar(0) == _('/')) {
     // absolute name; break name
@@ -138,12 +221,156 @@ String PackageManager::openFilenameFromPackage(Packaged* package, const String&
   throw FileNotFoundError(name, _("No package name specified, use '/package/filename'"));
 }
 
+void PackageManager::addStamp(const Packaged& package, set<String>& seen, String& out) {
+  if (!seen.insert(package.name()).second) return;
+  wxDateTime modified = package.lastModified();
+  out += package.name() + _(" ") + package.version.toString()
+       + String::Format(_(" %lld\n"), modified.IsValid() ? (long long)modified.GetTicks() : 0LL);
+  FOR_EACH_CONST(dep, package.dependencies) {
+    try {
+      addStamp(*openAny(dep->package, true), seen, out);
+    } catch (const Error&) {
+      out += dep->package + _(" missing\n");
+    }
+  }
+}
+
+String PackageManager::stamp(const Packaged& package) {
+  set<String> seen;
+  String text;
+  addStamp(package, seen, text);
+  // FNV-1a hash
+  wxScopedCharBuffer utf8 = text.utf8_str();
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  for (size_t i = 0 ; i < utf8.length() ; ++i) {
+    hash = (hash ^ (unsigned char)utf8.data()[i]) * 0x100000001b3ULL;
+  }
+  return String::Format(_("%016llx"), (unsigned long long)hash);
+}
+
 String PackageManager::getDictionaryDir(bool l) const {
   String dir = (l ? local : global).getDirectory();
   if (dir.empty()) return wxEmptyString;
   else             return dir + _("/dictionaries/");
 }
 
+// ----------------------------------------------------------------------------- : PackageHeaderIndex
+
+IMPLEMENT_REFLECTION_NO_SCRIPT(PackageHeader) {
+  REFLECT_NO_SCRIPT(filename);
+  REFLECT_NO_SCRIPT(modified);
+  REFLECT_NO_SCRIPT(short_name);
+  REFLECT_NO_SCRIPT(full_name);
+  REFLECT_NO_SCRIPT_N("icon", icon_filename);
+  REFLECT_NO_SCRIPT(position_hint);
+  REFLECT_NO_SCRIPT(installer_group);
+  REFLECT_NO_SCRIPT(version);
+  REFLECT_NO_SCRIPT(compatible_version);
+  REFLECT_NO_SCRIPT_N("depends_ons", dependencies); // hack for singular_form
+}
+
+void PackageHeader::copyFrom(const Packaged& package) {
+  short_name         = package.short_name;
+  full_name          = package.full_name;
+  icon_filename      = package.icon_filename;
+  installer_group    = package.installer_group;
+  position_hint      = package.position_hint;
+  version            = package.version;
+  compatible_version = package.compatible_version;
+  dependencies       = package.dependencies;
+}
+
+void PackageHeader::copyTo(Packaged& package) const {
+  package.short_name         = short_name;
+  package.full_name          = full_name;
+  package.icon_filename      = icon_filename;
+  package.installer_group    = installer_group;
+  package.position_hint      = position_hint;
+  package.version            = version;
+  package.compatible_version = compatible_version;
+  package.dependencies       = dependencies;
+}
+
+IMPLEMENT_REFLECTION_NO_SCRIPT(PackageHeaderIndex) {
+  REFLECT_NO_SCRIPT(packages);
+}
+
+PackageHeaderIndex::PackageHeaderIndex()
+  : loaded(false), changed(false)
+{}
+
+String PackageHeaderIndex::indexFile() {
+  String dir = user_settings_dir() + _("cache");
+  if (!wxDirExists(dir)) wxMkdir(dir);
+  return dir + _("/package-headers");
+}
+
+String PackageHeaderIndex::modificationTime(const String& filename) {
+  // for a directory package, the header is in a file named after the package type: "x.mse-game/game"
+  String header_file = filename;
+  if (wxDirExists(filename)) {
+    size_t ext = filename.find_last_of(_('.'));
+    if (ext == String::npos || !is_substr(filename, ext, _(".mse-"))) return String();
+    header_file = filename + _("/") + filename.substr(ext + 5);
+  }
+  wxDateTime modified;
+  if (!wxFileName(header_file).GetTimes(nullptr, &modified, nullptr)) return String();
+  return modified.GetValue().ToString();
+}
+
+void PackageHeaderIndex::load() {
+  if (loaded) return;
+  loaded = true;
+  String filename = indexFile();
+  if (!wxFileExists(filename)) return;
+  wxFileInputStream file_stream(filename);
+  if (!file_stream.Ok()) return; // failure is not an error, the headers will be read from the packages
+  try {
+    Reader reader(file_stream, nullptr, filename);
+    reader.handle_greedy(*this);
+  } catch (const Error&) {
+    packages.clear();
+  }
+  // forget packages that were removed, so the index doesn't keep growing
+  size_t count = packages.size();
+  packages.erase(remove_if(packages.begin(), packages.end(), [](const PackageHeaderP& header) {
+    return !wxFileExists(header->filename) && !wxDirExists(header->filename);
+  }), packages.end());
+  changed = packages.size() != count;
+  FOR_EACH(header, packages) {
+    by_filename[header->filename] = header;
+  }
+}
+
+PackageHeaderP PackageHeaderIndex::find(const String& filename, const String& modified) {
+  load();
+  if (modified.empty()) return PackageHeaderP();
+  auto it = by_filename.find(filename);
+  if (it == by_filename.end() || it->second->modified != modified) return PackageHeaderP();
+  return it->second;
+}
+
+void PackageHeaderIndex::add(const PackageHeaderP& header) {
+  load();
+  PackageHeaderP& old = by_filename[header->filename];
+  if (old) {
+    replace(packages.begin(), packages.end(), old, header);
+  } else {
+    packages.push_back(header);
+  }
+  old = header;
+  changed = true;
+}
+
+void PackageHeaderIndex::flush() {
+  if (!changed) return;
+  changed = false;
+  wxFileOutputStream stream(indexFile());
+  if (!stream.Ok()) return;
+  Writer writer(stream, app_version);
+  writer.handle(*this);
+}
+
 // ----------------------------------------------------------------------------- : PackageManager : on disk
 
 bool PackageManager::checkDependency(const PackageDependency& dep, bool report_errors) {
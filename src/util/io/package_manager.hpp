@@ -15,6 +15,7 @@
 DECLARE_POINTER_TYPE(Packaged);
 DECLARE_POINTER_TYPE(PackageVersion);
 DECLARE_POINTER_TYPE(InstallablePackage);
+DECLARE_POINTER_TYPE(PackageHeader);
 class PackageDependency;
 
 // ----------------------------------------------------------------------------- : PackageVersion
@@ -100,6 +101,61 @@ private:
   DECLARE_REFLECTION();
 };
 
+// ----------------------------------------------------------------------------- : PackageHeaderIndex
+
+/// The header of a package (the part common to all Packageds), as stored in the PackageHeaderIndex
+class PackageHeader : public IntrusivePtrBase<PackageHeader> {
+public:
+  PackageHeader() : position_hint(0) {}
+
+  String  filename;           ///< Normalized filename of the package
+  String  modified;           ///< Modification time of the file the header was read from
+  String  short_name;
+  String  full_name;
+  String  icon_filename;
+  String  installer_group;
+  int     position_hint;
+  Version version;
+  Version compatible_version;
+  vector<PackageDependencyP> dependencies;
+
+  /// Copy the header of a package
+  void copyFrom(const Packaged& package);
+  /// Set the header of a package
+  void copyTo(Packaged& package) const;
+
+  DECLARE_REFLECTION();
+};
+
+/// Headers of packages that were read before, so unchanged packages don't have to be parsed again to list them
+/** Stored in the user settings directory, headers are identified by the filename and modification time of the package.
+ *  Headers of packages that no longer exist are dropped when the index is loaded.
+ */
+class PackageHeaderIndex {
+public:
+  PackageHeaderIndex();
+
+  /// Find the header of a package, returns nullptr if the package changed or was not seen before
+  PackageHeaderP find(const String& filename, const String& modified);
+  /// Add or replace a header
+  void add(const PackageHeaderP& header);
+  /// Write the index to disk, if it has changed
+  void flush();
+
+  /// The modification time of the file that the header of a package is read from
+  static String modificationTime(const String& filename);
+
+private:
+  bool loaded, changed;
+  vector<PackageHeaderP> packages;
+  map<String,PackageHeaderP> by_filename;
+
+  void load();
+  static String indexFile();
+
+  DECLARE_REFLECTION();
+};
+
 // ----------------------------------------------------------------------------- : PackageManager
 
 /// Package manager, loads data files from the default data directory.
@@ -137,7 +193,9 @@ public:
   PackagedP openAny(const String& name, bool just_header = false);
   
   /// Find all packages that match a filename pattern, store them in out
-  /** Only reads the package headers */
+  /** Only reads the package headers.
+   *  Headers of packages that are not loaded yet are read in parallel, or taken from the header index.
+   */
   void findMatching(const String& pattern, vector<PackagedP>& out);
   
   /// Open a file from a package, with a name encoded as "/package/file"
@@ -155,6 +213,12 @@ public:
    */
   String openFilenameFromPackage(Packaged* package, const String& name);
   
+  /// A string that changes when the package or one of the packages it depends on (recursively) changes
+  /** A hash of the names, versions and modification times of the packages, so it can be stored in files.
+   *  Dependencies that are not loaded yet are opened, but only their headers are read.
+   */
+  String stamp(const Packaged& package);
+  
   // --------------------------------------------------- : Packages on disk
   
   /// Check if the given dependency is currently installed
@@ -179,6 +243,13 @@ public:
 private:
   map<String, PackagedP> loaded_packages;
   PackageDirectory local, global;
+  PackageHeaderIndex header_index;
+
+  /// Open the headers of the given packages that are not loaded yet, using multiple threads
+  /** Packages that fail to open are skipped, openAny will report the error */
+  void openHeaders(const vector<String>& filenames);
+  /// Add the stamp of a package and its dependencies that are not in seen yet
+  void addStamp(const Packaged& package, set<String>& seen, String& out);
 };
 
 /// The global PackageManager instance
@@ -12,6 +12,10 @@
 #include <util/error.hpp>
 #include <util/io/package_manager.hpp>
 #include <boost/logic/tribool.hpp>
+#include <wx/mstream.h>
+#include <wx/sstream.h>
+#include <chrono>
+#include <functional>
 #undef small
 using boost::tribool;
 
@@ -21,14 +25,45 @@ Reader::Reader(wxInputStream& input, Packaged* package, const String& filename,
   : indent(0), expected_indent(0), state(OUTSIDE)
   , ignore_invalid(ignore_invalid)
   , filename(filename), package(package), line_number(0), previous_line_number(0)
-  , input(input)
+  , eof(false)
 {
   assert(input.IsOk());
-  eat_utf8_bom(input);
+  wxMemoryInputStream* memory = dynamic_cast<wxMemoryInputStream*>(&input);
+  if (memory && memory->GetInputStreamBuffer()) {
+    // the data is already in memory (such as a stored file in a mapped zip package), don't copy it
+    wxStreamBuffer* stream_buffer = memory->GetInputStreamBuffer();
+    pos = (const char*)stream_buffer->GetBufferPos();
+    end = (const char*)stream_buffer->GetBufferEnd();
+    memory->SeekI(0, wxFromEnd);
+  } else {
+    readAll(input);
+  }
+  line_begin = line_end = value_begin = pos;
+  // utf-8 byte order mark
+  if (end - pos >= 3 && (Byte)pos[0] == 0xEF && (Byte)pos[1] == 0xBB && (Byte)pos[2] == 0xBF) {
+    pos += 3;
+  }
   moveNext();
   handleAppVersion();
 }
 
+void Reader::readAll(wxInputStream& input) {
+  wxFileOffset length = input.GetLength();
+  wxFileOffset start  = input.TellI();
+  size_t size = 0;
+  buffer.resize(length > 0 && start >= 0 && length > start ? (size_t)(length - start) + 1 : 64 * 1024);
+  while (true) {
+    if (size == buffer.size()) buffer.resize(size * 2);
+    input.Read(buffer.data() + size, buffer.size() - size);
+    size_t read = input.LastRead();
+    if (read == 0) break;
+    size += read;
+  }
+  buffer.resize(size);
+  pos = buffer.data();
+  end = pos + size;
+}
+
 void Reader::handleIgnore(int end_version, const Char* a) {
   if (file_app_version < end_version) {
     if (enterBlock(a)) exitBlock();
@@ -98,11 +133,11 @@ void Reader::moveNext() {
   key.clear();
   indent = -1; // if no line is read it never has the expected indentation
   // repeat until we have a good line
-  while (key.empty() && !input.Eof()) {
+  while (key.empty() && !eof) {
     readLine();
   }
   // did we reach the end of the file?
-  if (key.empty() && input.Eof()) {
+  if (key.empty() && eof) {
     line_number += 1;
     indent = -1;
   }
@@ -185,49 +220,105 @@ String read_utf8_line(wxInputStream& input, bool until_eof) {
   return wxString::FromUTF8(buffer.get(), buffer.size());
 }
 
+/// Is a byte of utf-8 text white space? Other white space is handled after converting to a String
+static inline bool is_space_byte(char c) {
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\v' || c == '\f';
+}
+
+/// Convert a range of utf-8 text from the input to a String
+static String from_utf8(const char* begin, const char* end, int line_number) {
+  if (begin == end) return String();
+  String s = wxString::FromUTF8(begin, end - begin);
+  if (s.empty()) {
+    // FromUTF8 fails by returning an empty string
+    throw ParseError(_("Invalid UTF-8 sequence") + String(_(" on line ")) << line_number);
+  }
+  return s;
+}
+
 void Reader::readLine(bool in_string) {
   line_number += 1;
-  // We have to do our own line reading, because wxTextInputStream is insane
-  try {
-    line = read_utf8_line(input);
-  } catch (const ParseError& e) {
-    throw ParseError(e.what() + String(_(" on line ")) << line_number);
+  if (pos == end) {
+    line_begin = line_end = value_begin = end;
+    eof = true;
+    indent = 0;
+    key.clear();
+    return;
   }
-  // read indentation
-  indent = 0;
-  while ((UInt)indent < line.size() && line.GetChar(indent) == _('\t')) {
-    indent += 1;
+  // find the end of the line, lines end in \n, \r\n or \r
+  line_begin = pos;
+  const char* newline = (const char*)memchr(pos, '\n', end - pos);
+  const char* cr      = (const char*)memchr(pos, '\r', (newline ? newline : end) - pos);
+  line_end = cr ? cr : newline ? newline : end;
+  value_begin = line_end;
+  pos = line_end;
+  if (pos == end) {
+    eof = true;
+  } else if (*pos++ == '\r') {
+    if (pos == end) eof = true;
+    else if (*pos == '\n') ++pos;
   }
+  // read indentation
+  const char* key_begin = line_begin;
+  while (key_begin < line_end && *key_begin == '\t') ++key_begin;
+  indent = (int)(key_begin - line_begin);
   // read key / value
-  if (line.find_first_not_of(_(" \t")) == String::npos || line.GetChar(indent) == _('#')) {
+  const char* text = key_begin;
+  while (text < line_end && (*text == ' ' || *text == '\t')) ++text;
+  if (text == line_end || *key_begin == '#') {
     // empty line or comment
     key.clear();
     return;
   }
-  size_t pos = line.find_first_of(_(':'), indent);
-  key = line.substr(indent, pos - indent);
-  if (!ignore_invalid && !in_string && starts_with(key, _(" "))) {
-    warning(_("key: '") + key + _("' starts with a space; only use TABs for indentation!"), 0, false);
+  const char* colon = (const char*)memchr(key_begin, ':', line_end - key_begin);
+  const char* key_end = colon ? colon : line_end;
+  if (!ignore_invalid && !in_string && *key_begin == ' ') {
+    warning(_("key: '") + from_utf8(key_begin, key_end, line_number) + _("' starts with a space; only use TABs for indentation!"), 0, false);
     // try to fix up: 8 spaces is a tab
-    while (starts_with(key, _("        "))) {
-      key = key.substr(8);
+    while (key_end - key_begin >= 8 && memcmp(key_begin, "        ", 8) == 0) {
+      key_begin += 8;
       indent += 1;
     }
   }
-  key = canonical_name_form(trim(key));
-  if (pos == String::npos) {
+  // canonical_name_form(trim(key)), without allocating a new string for ASCII keys
+  while (key_begin < key_end && is_space_byte(*key_begin))  ++key_begin;
+  while (key_end > key_begin && is_space_byte(key_end[-1])) --key_end;
+  key.clear();
+  for (const char* c = key_begin ; c < key_end ; ++c) {
+    if (*c & 0x80) {
+      key = canonical_name_form(trim(from_utf8(key_begin, key_end, line_number)));
+      break;
+    }
+    key += *c == ' ' ? '_' : *c;
+  }
+  if (!colon) {
     if (!ignore_invalid && !in_string) {
       warning(_("Missing ':' "), 0, false);
     }
-    value.clear();
   } else {
-    value = trim_left(substr(line, pos+1));
+    value_begin = colon + 1;
+    while (value_begin < line_end && is_space_byte(*value_begin)) ++value_begin;
   }
-  if (key.empty() && pos!=String::npos) {
+  if (key.empty() && colon) {
     key = _(" "); // we don't want an empty key if there was a colon
   }
 }
 
+String Reader::currentValue() const {
+  String value = from_utf8(value_begin, line_end, line_number);
+  if (!value.empty() && isSpace(value.GetChar(0))) return trim_left(value);
+  return value;
+}
+
+/// Is a range of utf-8 text empty after trimming?
+static bool is_blank(const char* begin, const char* end, int line_number) {
+  for (const char* c = begin ; c < end ; ++c) {
+    if (*c & 0x80) return trim(from_utf8(begin, end, line_number)).empty();
+    if (!is_space_byte(*c)) return false;
+  }
+  return true;
+}
+
 void Reader::unknownKey() {
   // ignore?
   if (ignore_invalid) {
@@ -245,6 +336,31 @@ void Reader::unknownKey() {
   // else: could be a nameless value, which doesn't call exitBlock to move past its own key
 }
 
+string Reader::getBlockText() {
+  if (state == ENTERED) moveNext(); // on the key of the block, move inside it
+  string text;
+  previous_line_number = line_number;
+  // blank lines and comments can have less indentation, they may be part of a multiline value
+  while (indent >= expected_indent || (key.empty() && !eof)) {
+    const char* start = line_begin;
+    for (int i = 0 ; i < expected_indent && start < line_end && *start == '\t' ; ++i) ++start;
+    text.append(start, line_end);
+    text += '\n';
+    if (eof) {
+      key.clear(); // this was the last line
+      break;
+    }
+    readLine(true);
+  }
+  // did we reach the end of the file? (see moveNext)
+  if (key.empty() && eof) {
+    line_number += 1;
+    indent = -1;
+  }
+  state = HANDLED;
+  return text;
+}
+
 // ----------------------------------------------------------------------------- : Handling basic types
 
 void Reader::unhandle() {
@@ -257,30 +373,31 @@ const String& Reader::getValue() {
   if (state == UNHANDLED) {
     state = HANDLED;
     return previous_value;
-  } else if (value.empty()) {
-    // a multiline string
-    previous_value.clear();
+  } else if (value_begin == line_end) {
+    // a multiline string, collect the utf-8 text first, and convert it all at once
+    string text;
     int pending_newlines = 0;
     // read all lines that are indented enough
     readLine(true);
     previous_line_number = line_number;
-    while (indent >= expected_indent && !input.Eof()) {
-      previous_value.resize(previous_value.size() + pending_newlines, _('\n'));
+    while (indent >= expected_indent && !eof) {
+      text.append(pending_newlines, '\n');
       pending_newlines = 0;
-      previous_value += line.substr(expected_indent); // strip expected indent
+      text.append(line_begin + expected_indent, line_end); // strip expected indent
       do {
         readLine(true);
         pending_newlines++;
         // skip empty lines that are not indented enough
-      } while(trim(line).empty() && indent < expected_indent && !input.Eof());
+      } while(is_blank(line_begin, line_end, line_number) && indent < expected_indent && !eof);
     }
+    previous_value = from_utf8(text.data(), text.data() + text.size(), previous_line_number);
     // moveNext(), but without the initial readLine()
     state = HANDLED;
-    while (key.empty() && !input.Eof()) {
+    while (key.empty() && !eof) {
       readLine();
     }
     // did we reach the end of the file?
-    if (key.empty() && input.Eof()) {
+    if (key.empty() && eof) {
       line_number += 1;
       indent = -1;
     }
@@ -291,7 +408,7 @@ const String& Reader::getValue() {
     }
     return previous_value;
   } else {
-    previous_value = value;
+    previous_value = currentValue();
     moveNext();
     return previous_value;
   }
@@ -376,3 +493,67 @@ void EnumReader::errorIfNotDone() {
     throw ParseError(notDoneErrorMessage());
   }
 }
+
+// ----------------------------------------------------------------------------- : Benchmark
+
+/// What the benchmark reads from a set file: the cards, with any fields
+struct BenchmarkSet {
+  String title;
+  vector<unordered_map<String,String>> cards;
+};
+template <> void Reader::handle(BenchmarkSet& set) {
+  handle(_("title"), set.title);
+  handle(_("cards"), set.cards);
+}
+
+/// The text of a set file with the given number of cards
+static string benchmark_set_text(int card_count) {
+  string text = "mse_version: 2.1.2\ntitle: Benchmark set\n";
+  for (int i = 0 ; i < card_count ; ++i) {
+    string n = std::to_string(i);
+    text += "card:\n";
+    text += "\tname: Card number " + n + "\n";
+    text += "\tcasting_cost: " + std::to_string(i % 7) + "WU\n";
+    text += "\tsuper_type: <word-list-type>Creature</word-list-type>\n";
+    text += "\tsub_type: <word-list-race>Human</word-list-race> <word-list-class>Soldier</word-list-class>\n";
+    text += "\trule_text:\n";
+    text += "\t\t<kw-a><nospellcheck>Flying</nospellcheck></kw-a>, <kw-a><nospellcheck>first strike</nospellcheck></kw-a>\n";
+    text += "\t\tWhen Card number " + n + " enters the battlefield, draw " + std::to_string(i % 3 + 1) + " cards.\n";
+    text += "\tflavor_text: <i>\xE2\x80\x9C" "Caf\xC3\xA9 num\xC3\xA9ro " + n + ".\xE2\x80\x9D</i>\n";
+    text += "\tpower: " + std::to_string(i % 5) + "\n";
+    text += "\ttoughness: " + std::to_string(i % 4 + 1) + "\n";
+    text += "\tnotes: \n";
+  }
+  return text;
+}
+
+String reader_benchmark() {
+  const int card_count = 5000;
+  const int repeat = 10;
+  string text = benchmark_set_text(card_count);
+  String text_string = String::FromUTF8(text.data(), text.size());
+  // the inputs: directly from memory, and from a stream that has to be copied
+  typedef std::function<unique_ptr<wxInputStream> ()> Input;
+  vector<pair<String,Input>> inputs = {
+    {_("memory"), [&] { return make_unique<wxMemoryInputStream>(text.data(), text.size()); }},
+    {_("stream"), [&] { return make_unique<wxStringInputStream>(text_string); }},
+  };
+  String result = String::Format(_("%d cards, %.1f MB\n"), card_count, text.size() / 1e6);
+  result += String::Format(_("%-18s%10s%10s\n"), _("input"), _("ms"), _("MB/s"));
+  FOR_EACH(input, inputs) {
+    double best = 1e9;
+    for (int i = 0 ; i < repeat ; ++i) {
+      unique_ptr<wxInputStream> stream = input.second();
+      auto start = std::chrono::steady_clock::now();
+      BenchmarkSet set;
+      Reader reader(*stream, nullptr, _("benchmark"));
+      reader.handle_greedy(set);
+      best = min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+      if (set.cards.size() != (size_t)card_count || set.cards.back().size() != 9) {
+        throw InternalError(_("Reader benchmark: the set was not read correctly"));
+      }
+    }
+    result += String::Format(_("%-18s%10.1f%10.0f\n"), input.first, best * 1000, text.size() / max(best, 1e-9) / 1e6);
+  }
+  return result;
+}
@@ -27,6 +27,10 @@ pair<unique_ptr<wxInputStream>, Packaged*> openFileFromPackage(Packaged* package
  *
  *  The handle functions ensure that afterwards the reader is at the line after the
  *  object that was just read.
+ *
+ *  The input is read into memory in one go (streams that are already in memory are used directly),
+ *  lines are split in that buffer without copying them.
+ *  Values are only converted to a String when they are asked for with getValue().
  */
 class Reader {
 public:
@@ -43,7 +47,7 @@ public:
   static constexpr bool isWriting = false;
   static constexpr bool isScripting = false;
   /// Is the thing currently being read 'complex', i.e. does it have children
-  inline bool isCompound() const { return indent != expected_indent - 1 || value.empty(); }
+  inline bool isCompound() const { return indent != expected_indent - 1 || value_begin == line_end; }
   /// Ignore old keys
   void handleIgnore(int, const Char*);
   /// Get the version of the format we are reading
@@ -111,6 +115,10 @@ public:
   /// Indicate that the last value from getValue() was not handled, allowing it to be handled again
   void unhandle();
   
+  /// Skip the rest of the current block, and return its text
+  /** The text is utf-8, without the indentation of the block, so it can be read later with another Reader. */
+  string getBlockText();
+  
   /// The package being read from
   inline Packaged* getPackage() const { return package; }
   
@@ -118,10 +126,12 @@ private:
   // --------------------------------------------------- : Data
   /// App version this file was made with
   Version file_app_version;
-  /// The line we read
-  String line;
-  /// The key and value of the last line we read
-  String key, value;
+  /// The key of the last line we read
+  String key;
+  /// The last line we read, and the start of its value, in the input
+  const char* line_begin;
+  const char* line_end;
+  const char* value_begin;
   /// Value of the *previous* line, only valid in state==HANDLED
   String previous_value;
   /// Indentation of the last line we read
@@ -146,8 +156,13 @@ private:
   int line_number;
   /// Line number of the previous_line
   int previous_line_number;
-  /// Input stream we are reading from
-  wxBufferedInputStream input;
+  /// Contents of the input stream, if it had to be copied
+  vector<char> buffer;
+  /// Start of the next line, and end of the input
+  const char* pos;
+  const char* end;
+  /// Did we reach the end of the input?
+  bool eof;
   /// Accumulated warning messages
   String warnings;
   
@@ -160,6 +175,8 @@ private:
   /// Leave the block we are in
   void exitBlock();
   
+  /// Read the whole input stream into the buffer
+  void readAll(wxInputStream& input);
   /// Move to the next non empty line
   void moveNext();
   /// Reads the next line from the input, and stores it in line/key/value/indent
@@ -167,14 +184,17 @@ private:
   
   /// Return the value on the current line
   const String& getValue();
+  /// The value on the current line, without moving to the next line
+  String currentValue() const;
   
   /// No line was read, because nothing mathes the current key
   /** Maybe the key is "include file" */
   template <typename T>
   void unknownKey(T& v) {
     if (key == _("include_file")) {
-      auto [stream, include_package] = openFileFromPackage(package, value);
-      Reader sub_reader(*stream, include_package, value, ignore_invalid);
+      String include_name = currentValue();
+      auto [stream, include_package] = openFileFromPackage(package, include_name);
+      Reader sub_reader(*stream, include_package, include_name, ignore_invalid);
       if (sub_reader.file_app_version == 0) {
         // in an included file, use the app version of the parent if there is none
         sub_reader.file_app_version = file_app_version;
@@ -313,3 +333,8 @@ private:
   String notDoneErrorMessage() const;
 };
 
+// ----------------------------------------------------------------------------- : Benchmark
+
+/// Time reading a large synthetic set file, returns a table of the results
+String reader_benchmark();
+
@@ -13,6 +13,10 @@
 #include <util/version.hpp>
 #include <util/io/package.hpp>
 #include <boost/logic/tribool.hpp>
+#include <wx/mstream.h>
+#include <thread>
+#include <atomic>
+#include <chrono>
 using boost::tribool;
 
 // ----------------------------------------------------------------------------- : Writer
@@ -26,6 +30,11 @@ Writer::Writer(OutputStream& output, Version file_app_version)
   handle(_("mse_version"), file_app_version);
 }
 
+Writer::Writer(OutputStream& output, int indentation)
+  : indentation(indentation)
+  , output(output)
+  , stream(output, wxEOL_UNIX, wxMBConvUTF8())
+{}
 
 
 void Writer::enterBlock(const Char* name) {
@@ -64,6 +73,55 @@ void Writer::writeIndentation() {
   }
 }
 
+// ----------------------------------------------------------------------------- : Writing in parallel
+
+/// Number of items that are written to the same buffer
+const size_t PARALLEL_CHUNK_SIZE = 64;
+
+void Writer::writeParallel(size_t count, const function<void (Writer&, size_t)>& write_item, const InContext& in_context) {
+  size_t chunk_count = (count + PARALLEL_CHUNK_SIZE - 1) / PARALLEL_CHUNK_SIZE;
+  size_t thread_count = min((size_t)max(1u, std::thread::hardware_concurrency()), chunk_count);
+  if (thread_count <= 1 || !pending_opened.empty()) {
+    // not worth it, or a block has been opened that the items have to be written in
+    for (size_t i = 0 ; i < count ; ++i) write_item(*this, i);
+    return;
+  }
+  // each chunk is written to its own buffer, by whichever thread gets to it first
+  struct Chunk {
+    wxMemoryOutputStream buffer;
+    std::exception_ptr error;
+  };
+  vector<Chunk> chunks(chunk_count);
+  std::atomic<size_t> next_chunk(0);
+  auto work = [&] {
+    in_context([&] {
+      for (size_t c = next_chunk++ ; c < chunk_count ; c = next_chunk++) {
+        try {
+          Writer writer(chunks[c].buffer, indentation);
+          size_t end = min(count, (c + 1) * PARALLEL_CHUNK_SIZE);
+          for (size_t i = c * PARALLEL_CHUNK_SIZE ; i < end ; ++i) write_item(writer, i);
+        } catch (...) {
+          chunks[c].error = std::current_exception();
+        }
+      }
+    });
+  };
+  vector<std::thread> threads;
+  for (size_t i = 1 ; i < thread_count ; ++i) {
+    threads.emplace_back(work);
+  }
+  work();
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  // concatenate the chunks, the first error is the one that would be thrown when writing them in order
+  FOR_EACH(chunk, chunks) {
+    if (chunk.error) std::rethrow_exception(chunk.error);
+    wxStreamBuffer* buffer = chunk.buffer.GetOutputStreamBuffer();
+    output.Write(buffer->GetBufferStart(), buffer->GetIntPosition());
+  }
+}
+
 // ----------------------------------------------------------------------------- : Handling basic types
 
 void Writer::handle(const String& value) {
@@ -102,6 +160,28 @@ void Writer::handle(const String& value) {
   stream.PutChar(_('\n'));
 }
 
+void Writer::handleBlockText(const String& text) {
+  if (text.empty()) return;
+  if (!pending_opened.empty()) {
+    writePending();
+    stream.WriteString(_(":\n"));
+  }
+  indentation += 1;
+  size_t start = 0, size = text.size();
+  while (start < size) {
+    size_t end = text.find_first_of(_('\n'), start);
+    if (end == String::npos) end = size;
+    // blank lines don't need indentation
+    if (end > start) {
+      writeIndentation();
+      writeUTF8(stream, text.substr(start, end - start));
+    }
+    stream.PutChar(_('\n'));
+    start = end + 1;
+  }
+  indentation -= 1;
+}
+
 template <> void Writer::handle(const int& value) {
   handle(String() << value);
 }
@@ -134,3 +214,51 @@ template <> void Writer::handle(const Vector2D& vec) {
 template <> void Writer::handle(const LocalFileName& value) {
   handle(value.toStringForWriting());
 }
+
+// ----------------------------------------------------------------------------- : Benchmark
+
+String writer_benchmark() {
+  const int card_count = 5000;
+  const int repeat = 10;
+  vector<map<String,String>> cards(card_count);
+  for (int i = 0 ; i < card_count ; ++i) {
+    map<String,String>& card = cards[i];
+    card[_("name")]         = String::Format(_("Card number %d"), i);
+    card[_("casting_cost")] = String::Format(_("%dWU"), i % 7);
+    card[_("super_type")]   = _("<word-list-type>Creature</word-list-type>");
+    card[_("rule_text")]    = String::Format(_("<kw-a><nospellcheck>Flying</nospellcheck></kw-a>\nWhen Card number %d enters the battlefield, draw %d cards."), i, i % 3 + 1);
+    card[_("flavor_text")]  = String::Format(_("<i>\u201CCaf\u00E9 num\u00E9ro %d.\u201D</i>"), i);
+    card[_("power")]        = String::Format(_("%d"), i % 5);
+    card[_("toughness")]    = String::Format(_("%d"), i % 4 + 1);
+  }
+  // write the set serially and in parallel
+  typedef std::function<void (Writer&)> WriteCards;
+  vector<pair<String,WriteCards>> ways = {
+    {_("serial"),   [&](Writer& writer) { writer.handle(_("cards"), cards); }},
+    {_("parallel"), [&](Writer& writer) { writer.handleParallel(_("cards"), cards, [](const function<void ()>& write) { write(); }); }},
+  };
+  String result = String::Format(_("%d cards, %u threads\n"), card_count, std::thread::hardware_concurrency());
+  result += String::Format(_("%-18s%10s%10s\n"), _("output"), _("ms"), _("MB/s"));
+  vector<char> first_output;
+  FOR_EACH(way, ways) {
+    double best = 1e9;
+    vector<char> output;
+    for (int i = 0 ; i < repeat ; ++i) {
+      wxMemoryOutputStream stream;
+      auto start = std::chrono::steady_clock::now();
+      Writer writer(stream, app_version);
+      writer.handle(_("title"), String(_("Benchmark set")));
+      way.second(writer);
+      best = min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+      output.resize((size_t)stream.GetLength());
+      stream.CopyTo(output.data(), output.size());
+    }
+    if (first_output.empty()) {
+      first_output = output;
+    } else if (output != first_output) {
+      throw InternalError(_("Writer benchmark: the output of ") + way.first + _(" writing is different"));
+    }
+    result += String::Format(_("%-18s%10.1f%10.0f\n"), way.first, best * 1000, output.size() / max(best, 1e-9) / 1e6);
+  }
+  return result;
+}
@@ -10,6 +10,7 @@
 
 #include <util/prec.hpp>
 #include <wx/txtstrm.h>
+#include <functional>
 
 template <typename T> class Defaultable;
 template <typename T> class Scriptable;
@@ -47,6 +48,22 @@ public:
   template <typename T>
   void handle(const Char* name, const vector<T>& vector);
   
+  /// Runs a function with the dynamic arguments that are needed for writing, see handleParallel
+  typedef function<void (const function<void ()>&)> InContext;
+  /// Write a vector to the output stream, formatting the elements in parallel
+  /** The output is the same as that of handle(name, vector).
+   *  Ranges of elements are written to memory by separate threads, each with its own Writer,
+   *  these are then written to the output stream in order.
+   *  Dynamic arguments are per thread, in_context must set them up for writing an element.
+   *  Writing the elements must not change any shared state.
+   */
+  template <typename T>
+  void handleParallel(const Char* name, const vector<T>& vector, const InContext& in_context);
+  
+  /// Write text in the format of Reader::getBlockText as the contents of the current block
+  /** The lines of the text are indented to the level of the block */
+  void handleBlockText(const String& text);
+  
   /// Write a string to the output stream
   void handle(const String& str);
   void handle(const Char* str) { handle(String(str)); }
@@ -71,6 +88,9 @@ public:
   void handle(const StyleSheetP&);
   
 private:
+  /// Construct a writer for a part of the output, at the given indentation, see handleParallel
+  Writer(OutputStream& output, int indentation);
+  
   // --------------------------------------------------- : Data
   /// Indentation of the current block
   int indentation;
@@ -93,6 +113,9 @@ private:
   void writePending();
   /// Output some taps to represent the indentation level
   void writeIndentation();
+  
+  /// Write count items in parallel, see handleParallel
+  void writeParallel(size_t count, const function<void (Writer&, size_t)>& write_item, const InContext& in_context);
 };
 
 // ----------------------------------------------------------------------------- : Container types
@@ -106,6 +129,15 @@ void Writer::handle(const Char* name, const vector<T>& vec) {
   }
 }
 
+template <typename T>
+void Writer::handleParallel(const Char* name, const vector<T>& vec, const InContext& in_context) {
+  String vectorKey = singular_form(name);
+  const Char* vectorKeyC = IF_UNICODE(vectorKey.wc_str(), vectorKey.c_str());
+  writeParallel(vec.size(), [&](Writer& writer, size_t i) {
+    writer.handle(vectorKeyC, vec[i]);
+  }, in_context);
+}
+
 template <typename T>
 void Writer::handle(const intrusive_ptr<T>& pointer) {
   if (pointer) handle(*pointer);
@@ -171,3 +203,8 @@ private:
   Writer& writer;  ///< The writer to write output to
 };
 
+// ----------------------------------------------------------------------------- : Benchmark
+
+/// Time writing a large synthetic set file, with and without handleParallel, returns a table of the results
+/** Throws an error if the outputs differ */
+String writer_benchmark();
@@ -79,6 +79,11 @@
     inline bool matches(Results& results, const String::const_iterator& begin, const String::const_iterator& end) const {
       return regex_search(begin, end, results, regex);
     }
+    /// Match only at the start of [begin,end)
+    /** If prev_avail, then the character before begin is used for word boundaries */
+    inline bool matches_at(Results& results, const String::const_iterator& begin, const String::const_iterator& end, bool prev_avail = false) const {
+      return regex_search(begin, end, results, regex, prev_avail ? boost::match_continuous | boost::match_prev_avail : boost::match_continuous);
+    }
     String replace_all(const String& input, const String& format) const;
     
     inline bool empty() const {
@@ -158,6 +163,9 @@
       results.begin = begin;
       return regex.Matches(begin, 0, end - begin);
     }
+    inline bool matches_at(Results& results, const Char* begin, const Char* end, bool = false) const {
+      return matches(results, begin, end) && results.position() == 0;
+    }
     inline void replace_all(String* input, const String& format) {
       regex.Replace(input, format);
     }
@@ -9,6 +9,7 @@
 #include <util/prec.hpp>
 #include <util/rotation.hpp>
 #include <gfx/gfx.hpp>
+#include <gfx/font_metrics.hpp>
 #include <data/font.hpp>
 
 // ----------------------------------------------------------------------------- : Rotation
@@ -365,6 +366,24 @@ double RotatedDC::GetCharHeight() const {
   }
 }
 
+double RotatedDC::GetCharWidths(const String& text, size_t start, size_t end, double* widths_out) const {
+  vector<int> widths(end - start);
+  font_metrics_cache.measure(dc, text, start, end, widths.data());
+  int h, charHeight;
+  font_metrics_cache.height(dc, &h, &charHeight);
+  #ifdef __WXGTK__
+    // See above HACK
+    if (charHeight != h)
+      h += h - charHeight;
+  #endif
+  double scale_x = quality == QUALITY_LOW ? zoomX : zoomX * text_scaling;
+  double scale_y = quality == QUALITY_LOW ? zoomY : zoomY * text_scaling;
+  for (size_t i = 0 ; i < widths.size() ; ++i) {
+    widths_out[i] = widths[i] / scale_x;
+  }
+  return h / scale_y;
+}
+
 void RotatedDC::SetClippingRegion(const RealRect& rect) {
   dc.SetDeviceClippingRegion(trRectToRegion(rect));
 }
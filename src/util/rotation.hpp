@@ -200,6 +200,10 @@ public:
   
   RealSize GetTextExtent(const String& text) const;
   double GetCharHeight() const;
+  /// Get the widths of the characters text[start...end) and return the height of the text
+  /** The widths include the kerning with the previous character, they add up to the width of the whole text.
+   *  Measured using the font_metrics_cache, the text should not contain newlines. */
+  double GetCharWidths(const String& text, size_t start, size_t end, double* widths_out) const;
   
   void SetClippingRegion(const RealRect& rect);
   void DestroyClippingRegion();
@@ -13,7 +13,69 @@ add_test(
 # Scripting language tests
 add_test(
   NAME script-functions
-  COMMAND magicseteditor ${test_dir}/script/script-functions.mse-script
+  COMMAND ${PROJECT_NAME} ${test_dir}/script/script-functions.mse-script
+)
+add_test(
+  NAME script-functions-register-engine
+  COMMAND ${PROJECT_NAME} ${test_dir}/script/script-functions.mse-script
+)
+# without the optimizer, otherwise the arithmetic is constant folded before the register engine sees it
+set_tests_properties(script-functions-register-engine PROPERTIES ENVIRONMENT "MSE_SCRIPT_ENGINE=register;MSE_OPTIMIZE_SCRIPTS=0")
+add_test(
+  NAME script-functions-unoptimized
+  COMMAND ${PROJECT_NAME} ${test_dir}/script/script-functions.mse-script
+)
+set_tests_properties(script-functions-unoptimized PROPERTIES ENVIRONMENT "MSE_OPTIMIZE_SCRIPTS=0")
+
+# Unit tests, linked with the same code as the program
+file(GLOB unit_test_sources ${test_dir}/unit/*.cpp)
+add_executable(${PROJECT_NAME}-unit-tests ${unit_test_sources})
+target_link_libraries(${PROJECT_NAME}-unit-tests ${PROJECT_NAME}-core)
+target_precompile_headers(${PROJECT_NAME}-unit-tests REUSE_FROM ${PROJECT_NAME}-core)
+
+# Keyword expansion tests
+add_test(
+  NAME keywords
+  COMMAND ${PROJECT_NAME}-unit-tests keywords
+)
+
+# Saving packages
+add_test(
+  NAME packages
+  COMMAND ${PROJECT_NAME}-unit-tests packages
+)
+
+# Image processing tests
+add_test(
+  NAME image-kernels
+  COMMAND ${PROJECT_NAME}-unit-tests image-kernels
+)
+add_test(
+  NAME image-kernels-sse2
+  COMMAND ${PROJECT_NAME}-unit-tests image-kernels
+)
+set_tests_properties(image-kernels-sse2 PROPERTIES ENVIRONMENT "MSE_SIMD=sse2")
+
+# Speed of the image kernels, not part of the tests
+add_custom_target(benchmark-image-kernels
+  COMMAND ${PROJECT_NAME} --benchmark-image-kernels
+  DEPENDS ${PROJECT_NAME}
+  COMMENT "Benchmarking image kernels"
+)
+add_custom_target(benchmark-reader
+  COMMAND ${PROJECT_NAME} --benchmark-reader
+  DEPENDS ${PROJECT_NAME}
+  COMMENT "Benchmarking reading a large set file"
+)
+add_custom_target(benchmark-writer
+  COMMAND ${PROJECT_NAME} --benchmark-writer
+  DEPENDS ${PROJECT_NAME}
+  COMMENT "Benchmarking writing a large set file"
+)
+add_custom_target(benchmark-text-layout
+  COMMAND ${PROJECT_NAME} --benchmark-text-layout
+  DEPENDS ${PROJECT_NAME}
+  COMMENT "Benchmarking measuring long rules text"
 )
 
 # Rendering tests
@@ -0,0 +1,124 @@
+//+----------------------------------------------------------------------------+
+//| Description:  Magic Set Editor - Program to make Magic (tm) cards          |
+//| Copyright:    (C) Twan van Laarhoven and the other MSE developers          |
+//| License:      GNU General Public License 2 or later (see file COPYING)     |
+//+----------------------------------------------------------------------------+
+
+// ----------------------------------------------------------------------------- : Includes
+
+#include <util/prec.hpp>
+#include "unit_tests.hpp"
+#include <gfx/image_kernels.hpp>
+#include <random>
+
+// ----------------------------------------------------------------------------- : Image kernels
+
+namespace {
+  /// Random test data, with extra weight on the extreme values
+  class TestData {
+  public:
+    TestData() : rng(12345) {}
+    Byte byte() {
+      UInt r = rng() % 8;
+      return r == 0 ? 0 : r == 1 ? 255 : Byte(rng());
+    }
+    vector<Byte> bytes(size_t n) {
+      vector<Byte> v(n);
+      FOR_EACH(b, v) b = byte();
+      return v;
+    }
+    vector<int> mults(size_t n) {
+      vector<int> v(n);
+      FOR_EACH(m, v) {
+        UInt r = rng() % 8;
+        m = r == 0 ? 0 : r == 1 ? 65536 : int(rng() % 65537);
+      }
+      return v;
+    }
+    /// Weights like the ones used by resample_pass: at most 1<<14, summing to 1<<14
+    vector<UInt> weights(size_t count) {
+      vector<UInt> v(count);
+      UInt left = 1 << 14;
+      for (size_t k = 0 ; k + 1 < count ; ++k) {
+        v[k] = rng() % (left + 1);
+        left -= v[k];
+      }
+      if (count > 0) v[count - 1] = left;
+      return v;
+    }
+    std::mt19937 rng;
+  };
+}
+
+String test_image_kernels() {
+  String errors;
+  TestData data;
+  // all pairs of bytes, and random data of sizes that exercise the loop tails
+  vector<vector<Byte>> as, bs;
+  as.push_back(vector<Byte>(65536));
+  bs.push_back(vector<Byte>(65536));
+  for (size_t i = 0 ; i < 65536 ; ++i) {
+    as[0][i] = Byte(i);
+    bs[0][i] = Byte(i >> 8);
+  }
+  const size_t sizes[] = {0, 1, 7, 8, 9, 15, 16, 17, 31, 32, 33, 100, 1000, 4099};
+  FOR_EACH_CONST(n, sizes) {
+    as.push_back(data.bytes(n));
+    bs.push_back(data.bytes(n));
+  }
+  const ImageKernels& ref = *image_kernels(SIMD_SCALAR);
+  for (int level = SIMD_SCALAR + 1 ; level <= SIMD_AVX2 ; ++level) {
+    const ImageKernels* kernels = image_kernels((SimdLevel)level);
+    if (!kernels) continue;
+    const ImageKernels& k = *kernels;
+    auto check = [&](const String& kernel, const vector<Byte>& expected, const vector<Byte>& actual) {
+      if (expected != actual) {
+        errors += simd_level_name(k.level) + _(" ") + kernel + String::Format(_(" differs from scalar for %d bytes\n"), (int)expected.size());
+      }
+    };
+    for (size_t t = 0 ; t < as.size() ; ++t) {
+      const vector<Byte>& a = as[t];
+      const vector<Byte>& b = bs[t];
+      size_t n = a.size();
+      vector<Byte> mask = data.bytes(n);
+      vector<int>  mult = data.mults(n);
+      vector<Byte> expected, actual;
+      // blending
+      expected = a; ref.mask_blend(expected.data(), b.data(), mask.data(), n);
+      actual   = a; k  .mask_blend(actual.data(),   b.data(), mask.data(), n);
+      check(_("mask_blend"), expected, actual);
+      expected = a; ref.fixed_blend(expected.data(), b.data(), mult.data(), n);
+      actual   = a; k  .fixed_blend(actual.data(),   b.data(), mult.data(), n);
+      check(_("fixed_blend"), expected, actual);
+      // alpha
+      expected = a; ref.multiply(expected.data(), b.data(), n);
+      actual   = a; k  .multiply(actual.data(),   b.data(), n);
+      check(_("multiply"), expected, actual);
+      Byte f = data.byte();
+      expected = a; ref.multiply_const(expected.data(), f, n);
+      actual   = a; k  .multiply_const(actual.data(),   f, n);
+      check(_("multiply_const"), expected, actual);
+      // resampling
+      for (size_t count = 1 ; count <= 5 ; ++count) {
+        vector<vector<Byte>> row_data;
+        vector<const Byte*>  rows;
+        for (size_t r = 0 ; r < count ; ++r) row_data.push_back(data.bytes(n));
+        FOR_EACH_CONST(r, row_data) rows.push_back(r.data());
+        vector<UInt> weights = data.weights(count);
+        expected.assign(n, 0); ref.weighted_sum(expected.data(), rows.data(), weights.data(), count, 14, n);
+        actual  .assign(n, 0); k  .weighted_sum(actual.data(),   rows.data(), weights.data(), count, 14, n);
+        check(_("weighted_sum"), expected, actual);
+      }
+      // combining
+      for (int c = COMBINE_ADD ; c <= COMBINE_SYMMETRIC_OVERLAY ; ++c) {
+        ImageCombine combine = (ImageCombine)c;
+        expected = a; combine_bytes_scalar(combine, expected.data(), b.data(), n);
+        actual   = a;
+        if (!k.combine(combine, actual.data(), b.data(), n)) continue;
+        check(_("combine ") + String::Format(_("%d"), c), expected, actual);
+      }
+    }
+  }
+  printf("Image kernels: %s\n", (const char*)simd_level_name(image_kernels().level).utf8_str());
+  return errors;
+}
@@ -0,0 +1,128 @@
+//+----------------------------------------------------------------------------+
+//| Description:  Magic Set Editor - Program to make Magic (tm) cards          |
+//| Copyright:    (C) Twan van Laarhoven and the other MSE developers          |
+//| License:      GNU General Public License 2 or later (see file COPYING)     |
+//+----------------------------------------------------------------------------+
+
+// ----------------------------------------------------------------------------- : Includes
+
+#include <util/prec.hpp>
+#include "unit_tests.hpp"
+#include <data/keyword.hpp>
+#include <data/field/text.hpp>
+#include <util/tagged_string.hpp>
+
+// ----------------------------------------------------------------------------- : Keywords
+
+/// A small keyword database and the options to expand with it
+struct KeywordTestData {
+  KeywordTestData() {
+    KeywordParamP number = make_intrusive<KeywordParam>();
+    number->name     = _("number");
+    number->match    = _("[0-9]+");
+    number->optional = false;
+    param_types.push_back(number);
+    add(_("Flying"),       _("flying"));
+    add(_("Haste"),        _("haste"));
+    add(_("First strike"), _("first strike"));
+    add(_("Strike"),       _("strike"));
+    add(_("Bushido"),      _("bushido <atom-param>number</atom-param>"));
+    add(_("Damage"),       _("<atom-param>number</atom-param> damage"));
+    KeywordDatabase::prepare_parameters(param_types, keywords);
+    db.add(keywords);
+    combine = parse(_("keyword + \"(\" + reminder + \")\""));
+  }
+  
+  Context ctx;
+  vector<KeywordParamP> param_types;
+  vector<KeywordP> keywords;
+  KeywordDatabase db;
+  ScriptValueP combine;
+  
+  void add(const String& name, const String& match) {
+    KeywordP kw = make_intrusive<Keyword>();
+    kw->keyword = name;
+    kw->match   = match;
+    kw->reminder.set(name);
+    keywords.push_back(kw);
+  }
+  
+  /// Expand without the automaton, by trying the regex of every keyword everywhere
+  String reference(const String& text) {
+    return expand_keywords_without_database(text, keywords, KeywordExpandOptions{nullptr, nullptr, combine, ctx, nullptr, nullptr});
+  }
+};
+
+String test_keywords() {
+  String errors;
+  KeywordTestData data;
+  // text, and the expected result without tags
+  const pair<String,String> cases[] = {
+    // keywords that start with text, and with a parameter
+    {_("Flying"),                         _("Flying(Flying)")},
+    {_("Bushido 2, haste"),               _("Bushido 2(Bushido), haste(Haste)")},
+    {_("Deals 3 damage."),                _("Deals 3 damage(Damage).")},
+    {_("3 damage and 10 damage"),         _("3 damage(Damage) and 10 damage(Damage)")},
+    // matches split by tags
+    {_("<b>Fly</b>ing"),                  _("Flying(Flying)")},
+    {_("Bushido <i>4</i>"),               _("Bushido 4(Bushido)")},
+    {_("First <sym>strike</sym>, flying"),_("First strike(First strike), flying(Flying)")},
+    // word boundaries after a previous match or candidate
+    {_("Flyinghaste, haste"),             _("Flyinghaste, haste(Haste)")},
+    {_("Bushido 1Bushido 2"),             _("Bushido 1Bushido 2")},
+    {_("Flying, flying"),                 _("Flying(Flying), flying(Flying)")},
+    // overlapping candidates
+    {_("First strike"),                   _("First strike(First strike)")},
+    {_("Strike, first strike"),           _("Strike(Strike), first strike(First strike)")},
+    {_("Flying strike"),                  _("Flying(Flying) strike(Strike)")},
+  };
+  FOR_EACH_CONST(c, cases) {
+    String result = data.db.expand(c.first, KeywordExpandOptions{nullptr, nullptr, data.combine, data.ctx, nullptr, nullptr});
+    if (untag(result) != c.second) {
+      errors += _("expand_keywords(\"") + c.first + _("\") gives \"") + result + _("\", expected \"") + c.second + _("\"\n");
+    }
+    String reference = data.reference(c.first);
+    if (result != reference) {
+      errors += _("expand_keywords(\"") + c.first + _("\") gives \"") + result + _("\", without the automaton \"") + reference + _("\"\n");
+    }
+  }
+  // editing a value reuses the paragraphs of the previous expansion, that should give the same result as a fresh expansion
+  const pair<String,String> edits[] = {
+    // paragraphs inside <kw-> and <atom> tags
+    {_("<kw-1>Flying\nhaste</kw-1>\nflying"),             _("<kw-1>Flying\nhaste</kw-1>\nflying, haste")},
+    {_("<kw-0>Flying\nhaste</kw-0>\nflying"),             _("<kw-0>Flying\nhaste, strike</kw-0>\nflying")},
+    {_("<atom-x>flying\nhaste</atom-x>\nflying"),         _("<atom-x>flying\nhaste</atom-x>\nhaste, flying")},
+    {_("flying\n<atom-x>haste\nstrike</atom-x>"),         _("haste\n<atom-x>haste\nstrike</atom-x>")},
+    // <line> separators
+    {_("Flying<line>\n</line>Haste<line>\n</line>Bushido 2"), _("Flying<line>\n</line>Haste, strike<line>\n</line>Bushido 2")},
+    {_("Flying<line>\n</line>Haste"),                     _("Flying<line>\n</line><line>\n</line>Haste")},
+    // keywords at the edges of paragraphs
+    {_("Flying\nhaste"),                                  _("Flying\nhaste\n")},
+    {_("Flying\nhaste"),                                  _("Flying\n3 damage\nhaste")},
+    {_("First strike\nhaste"),                            _("First\nstrike\nhaste")},
+    {_("Bushido 2\nhaste"),                               _("Bushido 2\nhaste 3 damage")},
+  };
+  ValueP value = make_intrusive<TextValue>(make_intrusive<TextField>());
+  ValueP other = make_intrusive<TextValue>(make_intrusive<TextField>());
+  FOR_EACH_CONST(e, edits) {
+    KeywordUsageStatistics edited_stats, fresh_stats;
+    String edited;
+    {
+      WITH_DYNAMIC_ARG(value_being_edited, value.get());
+      data.db.expand(e.first, KeywordExpandOptions{nullptr, nullptr, data.combine, data.ctx, &edited_stats, value.get()});
+      edited = data.db.expand(e.second, KeywordExpandOptions{nullptr, nullptr, data.combine, data.ctx, &edited_stats, value.get()});
+    }
+    String fresh = data.db.expand(e.second, KeywordExpandOptions{nullptr, nullptr, data.combine, data.ctx, &fresh_stats, other.get()});
+    if (edited != fresh) {
+      errors += _("editing \"") + e.first + _("\" into \"") + e.second + _("\" gives \"") + edited + _("\", a fresh expansion \"") + fresh + _("\"\n");
+    }
+    bool same_stats = edited_stats.size() == fresh_stats.size();
+    for (size_t i = 0 ; same_stats && i < edited_stats.size() ; ++i) {
+      same_stats = edited_stats[i].second == fresh_stats[i].second;
+    }
+    if (!same_stats) {
+      errors += _("editing \"") + e.first + _("\" into \"") + e.second + _("\" gives different keyword usage than a fresh expansion\n");
+    }
+  }
+  return errors;
+}
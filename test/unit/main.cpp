@@ -0,0 +1,46 @@
+//+----------------------------------------------------------------------------+
+//| Description:  Magic Set Editor - Program to make Magic (tm) cards          |
+//| Copyright:    (C) Twan van Laarhoven and the other MSE developers          |
+//| License:      GNU General Public License 2 or later (see file COPYING)     |
+//+----------------------------------------------------------------------------+
+
+// ----------------------------------------------------------------------------- : Includes
+
+#include <util/prec.hpp>
+#include "unit_tests.hpp"
+#include <script/script.hpp>
+#include <wx/init.h>
+
+// ----------------------------------------------------------------------------- : Main function
+
+/// The tests, by the name used on the command line
+static const pair<const char*, String (*)()> tests[] = {
+  {"image-kernels", test_image_kernels},
+  {"keywords",      test_keywords},
+  {"packages",      test_packages},
+};
+
+/// Run the test named on the command line
+/** Problems are written to stderr, the exit code is EXIT_FAILURE if there are any */
+int main(int argc, char** argv) {
+  wxInitializer initializer(argc, argv);
+  if (!initializer.IsOk()) {
+    fputs("Unable to initialize wxWidgets\n", stderr);
+    return EXIT_FAILURE;
+  }
+  wxInitAllImageHandlers();
+  init_script_variables();
+  if (argc != 2) {
+    fputs("Usage: unit-tests TEST\n", stderr);
+    return EXIT_FAILURE;
+  }
+  FOR_EACH_CONST(test, tests) {
+    if (strcmp(test.first, argv[1]) != 0) continue;
+    String errors = test.second();
+    if (errors.empty()) return EXIT_SUCCESS;
+    fputs(errors.utf8_str(), stderr);
+    return EXIT_FAILURE;
+  }
+  fprintf(stderr, "Unknown test: %s\n", argv[1]);
+  return EXIT_FAILURE;
+}
@@ -0,0 +1,216 @@
+//+----------------------------------------------------------------------------+
+//| Description:  Magic Set Editor - Program to make Magic (tm) cards          |
+//| Copyright:    (C) Twan van Laarhoven and the other MSE developers          |
+//| License:      GNU General Public License 2 or later (see file COPYING)     |
+//+----------------------------------------------------------------------------+
+
+// ----------------------------------------------------------------------------- : Includes
+
+#include <util/prec.hpp>
+#include "unit_tests.hpp"
+#include <util/io/package.hpp>
+#include <wx/filename.h>
+#include <wx/wfstream.h>
+#include <wx/mstream.h>
+
+// ----------------------------------------------------------------------------- : Helpers
+
+static void read_all(wxInputStream& in, vector<Byte>& data) {
+  data.clear();
+  Byte buffer[4096];
+  do {
+    in.Read(buffer, sizeof(buffer));
+    data.insert(data.end(), buffer, buffer + in.LastRead());
+  } while (in.LastRead() > 0);
+}
+
+static String test_package_name() {
+  String filename = wxFileName::CreateTempFileName(_("mse"));
+  remove_file(filename); // the package is made by saving
+  return filename;
+}
+
+static void write_test_file(Package& package, const LocalFileName& file, const string& contents) {
+  auto out = package.openOut(file);
+  out->Write(contents.data(), contents.size());
+}
+
+static string read_test_file(Package& package, const String& file) {
+  auto in = package.openIn(file);
+  vector<Byte> data;
+  read_all(*in, data);
+  return string(data.begin(), data.end());
+}
+
+static vector<Byte> read_test_archive(const String& filename) {
+  vector<Byte> data;
+  wxFileInputStream in(filename);
+  if (in.IsOk()) read_all(in, data);
+  return data;
+}
+
+/// Save a package like Packaged::save, returns the names of the files as they would be written in the main file
+static vector<String> save_test_package(Package& package, const String& filename, const vector<LocalFileName>& used) {
+  package.deduplicateFiles();
+  vector<String> names;
+  {
+    WITH_DYNAMIC_ARG(writing_package, &package);
+    FOR_EACH_CONST(f, used) names.push_back(f.toStringForWriting());
+  }
+  if (package.needSaveAs()) {
+    package.saveAs(filename);
+  } else {
+    package.save();
+  }
+  return names;
+}
+
+/// Check the contents of files in a package, reports errors as the given test
+static void check_test_package(Package& package, const vector<String>& names, const vector<string>& expected, const String& test, String& errors) {
+  for (size_t i = 0 ; i < names.size() ; ++i) {
+    try {
+      string contents = read_test_file(package, names[i]);
+      if (contents != expected[i]) {
+        errors += test + _(": '") + names[i] + _("' contains '") + String(contents.c_str(), wxConvUTF8) + _("', expected '") + String(expected[i].c_str(), wxConvUTF8) + _("'\n");
+      }
+    } catch (const Error& e) {
+      errors += test + _(": '") + names[i] + _("' can't be opened: ") + e.what() + _("\n");
+    }
+  }
+}
+
+/// Open a saved package again, and check the contents of files in it
+static void check_reopened_test_package(const String& filename, const vector<String>& names, const vector<string>& expected, const String& test, String& errors) {
+  try {
+    Package package;
+    package.open(filename);
+    check_test_package(package, names, expected, test + _(" (reopened)"), errors);
+  } catch (const Error& e) {
+    errors += test + _(": the package can't be opened: ") + e.what() + _("\n");
+  }
+}
+
+// ----------------------------------------------------------------------------- : Packages
+
+String test_packages() {
+  String errors;
+  // new files with the same contents are stored once, and both names can still be opened
+  {
+    String filename = test_package_name();
+    {
+      Package package;
+      LocalFileName a = package.newFileName(_("image"), _(""));
+      LocalFileName b = package.newFileName(_("image"), _(""));
+      LocalFileName c = package.newFileName(_("image"), _(""));
+      write_test_file(package, a, "same");
+      write_test_file(package, b, "same");
+      write_test_file(package, c, "other");
+      vector<String> names = save_test_package(package, filename, {a, b, c});
+      if (names[0] != names[1]) errors += _("duplicates: the files are not stored once\n");
+      if (names[0] == names[2]) errors += _("duplicates: a different file is stored as a duplicate\n");
+      check_test_package(package, {a.toStringForKey(), b.toStringForKey(), c.toStringForKey()}, {"same", "same", "other"}, _("duplicates"), errors);
+      check_reopened_test_package(filename, names, {"same", "same", "other"}, _("duplicates"), errors);
+    }
+    remove_file(filename);
+  }
+  // overwriting a file that another file is an alias of, the alias keeps the old contents
+  {
+    String filename = test_package_name();
+    {
+      Package package;
+      LocalFileName a = package.newFileName(_("image"), _(""));
+      LocalFileName b = package.newFileName(_("image"), _(""));
+      write_test_file(package, a, "old");
+      write_test_file(package, b, "old");
+      save_test_package(package, filename, {a, b});
+      write_test_file(package, a, "new");
+      check_test_package(package, {a.toStringForKey(), b.toStringForKey()}, {"new", "old"}, _("overwrite alias"), errors);
+      vector<String> names = save_test_package(package, filename, {a, b});
+      if (names[0] == names[1]) errors += _("overwrite alias: the files are still stored once\n");
+      check_test_package(package, {a.toStringForKey(), b.toStringForKey()}, {"new", "old"}, _("overwrite alias"), errors);
+      check_reopened_test_package(filename, names, {"new", "old"}, _("overwrite alias"), errors);
+    }
+    remove_file(filename);
+    remove_file(filename + _(".bak"));
+  }
+  // an incremental save after a full save appends to the archive
+  {
+    String filename = test_package_name();
+    {
+      Package package;
+      package.setCompactionThreshold(100);
+      LocalFileName a = package.newFileName(_("image"), _(""));
+      LocalFileName b = package.newFileName(_("image"), _(""));
+      LocalFileName c = package.newFileName(_("image"), _(""));
+      write_test_file(package, a, "one");
+      write_test_file(package, b, "two");
+      save_test_package(package, filename, {a, b});
+      vector<Byte> before = read_test_archive(filename);
+      // change a file, add a file, and remove a file
+      write_test_file(package, a, "three");
+      write_test_file(package, c, "four");
+      vector<String> names = save_test_package(package, filename, {a, c});
+      vector<Byte> after = read_test_archive(filename);
+      if (after.size() <= before.size() || !equal(before.begin(), before.end(), after.begin())) {
+        errors += _("incremental save: the archive was rewritten instead of appended to\n");
+      }
+      if (read_test_archive(filename + _(".bak")) != before) {
+        errors += _("incremental save: the old archive was not kept as .bak\n");
+      }
+      check_test_package(package, names, {"three", "four"}, _("incremental save"), errors);
+      check_reopened_test_package(filename, names, {"three", "four"}, _("incremental save"), errors);
+      try {
+        Package reopened;
+        reopened.open(filename);
+        if (reopened.getFileInfos().count(b.toStringForKey())) {
+          errors += _("incremental save: a file that is no longer used is still in the archive\n");
+        }
+      } catch (const Error&) {} // already reported
+    }
+    remove_file(filename);
+    remove_file(filename + _(".bak"));
+  }
+  // an incremental save that was interrupted is undone when the package is opened again
+  {
+    String filename = test_package_name();
+    vector<String> names;
+    {
+      Package package;
+      LocalFileName a = package.newFileName(_("image"), _(""));
+      LocalFileName b = package.newFileName(_("image"), _(""));
+      write_test_file(package, a, "one");
+      write_test_file(package, b, "two");
+      names = save_test_package(package, filename, {a, b});
+    }
+    vector<Byte> before = read_test_archive(filename);
+    {
+      // start appending, but never commit, this leaves a journal behind
+      ZipAppender zip(filename);
+      bool can_append;
+      {
+        shared_ptr<MappedZipFile> mapped = MappedZipFile::open(filename);
+        can_append = mapped && zip.init(*mapped);
+      }
+      if (can_append) {
+        zip.begin();
+        wxMemoryInputStream data("three", 5);
+        zip.add(_("three"), data);
+      } else {
+        errors += _("recover: the archive can't be appended to\n");
+      }
+    }
+    if (!wxFileExists(filename + _(".journal"))) {
+      errors += _("recover: no journal was left behind\n");
+    }
+    check_reopened_test_package(filename, names, {"one", "two"}, _("recover"), errors);
+    if (read_test_archive(filename) != before) {
+      errors += _("recover: the archive was not restored\n");
+    }
+    if (wxFileExists(filename + _(".journal"))) {
+      errors += _("recover: the journal was not removed\n");
+    }
+    remove_file(filename);
+    remove_file(filename + _(".journal"));
+  }
+  return errors;
+}
@@ -0,0 +1,30 @@
+//+----------------------------------------------------------------------------+
+//| Description:  Magic Set Editor - Program to make Magic (tm) cards          |
+//| Copyright:    (C) Twan van Laarhoven and the other MSE developers          |
+//| License:      GNU General Public License 2 or later (see file COPYING)     |
+//+----------------------------------------------------------------------------+
+
+#pragma once
+
+/** @file test/unit/unit_tests.hpp
+ *
+ *  Tests of parts of the program that can't be tested with a script, run by ctest.
+ *  Each test returns a description of the problems, or an empty string if there are none.
+ */
+
+// ----------------------------------------------------------------------------- : Includes
+
+#include <util/prec.hpp>
+
+// ----------------------------------------------------------------------------- : Tests
+
+/// Compare all image kernels of all supported instruction sets to the scalar ones on random data
+String test_image_kernels();
+
+/// Expand keywords in texts that exercise the matching, and compare with the expected results
+/** Also compares with expanding without a KeywordDatabase,
+ *  and the expansion of an edited value, which reuses paragraphs, with a fresh expansion. */
+String test_keywords();
+
+/// Save and reopen packages with duplicate files, aliases, incremental saves and interrupted saves
+String test_packages();